@@ -1,10 +1,23 @@
 #include "Actor.h"
 #include "Component.h"
+#include "Core.h"
 
-Actor::Actor(Core& core, const std::string& id) : mCore(core), mID(id) {}
+#include <algorithm>
+
+Actor::Actor(Core& core, const std::string& id)
+  : mCore(core),
+	mID(id),
+	mEntities(core.GetEntities()),
+	mEntity(mEntities.CreateEntity())
+{
+}
 
 Actor::~Actor()
 {
+	// コンポーネントを先に破棄してから、姿勢を格納していたエンティティを削除する
+	mComponentsByType.clear();
+	mComponents.clear();
+	mEntities.DestroyEntity(mEntity);
 }
 
 std::shared_ptr<Actor> Actor::Create(
@@ -14,49 +27,68 @@ std::shared_ptr<Actor> Actor::Create(
 	return std::shared_ptr<Actor>(new Actor(core, id));
 }
 
-void Actor::Update(float deltaTime)
+void Actor::UpdateComponents(float deltaTime, int updateOrder, bool parallel)
 {
-	if (mState == ActorState::EActive)
+	if (mState != ActorState::EActive) { return; }
+
+	// コンポーネントは更新順序の順に並んでいる
+	for (const auto& comp : mComponents)
 	{
-		ComputeWorldTransform();
+		if (comp->GetUpdateOrder() < updateOrder) { continue; }
+		if (comp->GetUpdateOrder() > updateOrder) { break; }
 
-		// コンポーネントの更新
-		for (auto comp : mComponents)
+		if (comp->GetEnabled() && comp->CanUpdateInParallel() == parallel)
 		{
-			if (comp->GetEnabled())
-			{
-				comp->Update(deltaTime);
-			}
+			comp->Update(deltaTime);
 		}
-
-		ComputeWorldTransform();
 	}
 }
 
+void Actor::RegisterUpdatePhase(const Component& component)
+{
+	mCore.RegisterUpdatePhase(component.GetUpdateOrder(), component.CanUpdateInParallel());
+}
+
 void Actor::ComputeWorldTransform()
 {
-	if (mShouldRecomputeWorldTransform)
+	if (mEntities.ComputeWorldTransform(mEntity))
 	{
-		mShouldRecomputeWorldTransform = false;
-		// glm::mat4 T = glm::translate(glm::mat4(1.0f), mPosition);
-		// glm::mat4 TR = T * glm::toMat4(mRotation);
-		// mWorldTransform = glm::scale(TR, mScale);
+		for (const auto& comp : mComponents)
+		{
+			comp->OnUpdateWorldTransform();
+		}
+	}
+}
 
-		glm::mat4 T = glm::translate(glm::mat4(1.0f), mPosition);
-		glm::mat4 R = glm::toMat4(mRotation);
-		glm::mat4 S = glm::scale(glm::mat4(1.0f), mScale);
-		mWorldTransform = T * R * S;
+void Actor::SetActive(bool active)
+{
+	mState = active ? ActorState::EActive : ActorState::EPaused;
+	if (active == mIsActive) { return; }
+	mIsActive = active;
 
-		for (auto comp : mComponents)
+	if (!active)
+	{
+		// 無効にする前の状態を覚えておき、有効に戻したときに元通りにする
+		mDisabledComponents.clear();
+		for (const auto& comp : mComponents)
 		{
-			comp->OnUpdateWorldTransform();
+			if (!comp->GetEnabled()) { mDisabledComponents.push_back(comp.get()); }
+			comp->SetEnabled(false);
 		}
+		return;
+	}
+
+	for (const auto& comp : mComponents)
+	{
+		bool wasDisabled = std::find(mDisabledComponents.begin(), mDisabledComponents.end(), comp.get()) != mDisabledComponents.end();
+		comp->SetEnabled(!wasDisabled);
 	}
+	mDisabledComponents.clear();
 }
 
 void Actor::ProcessInput(const InputState& state)
 {
-	for (auto comp : mComponents)
+	for (const auto& comp : mComponents)
 	{
 		if (comp->GetEnabled())
 		{
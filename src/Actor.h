@@ -5,7 +5,9 @@
 #include <vector>
 #include <glm/glm.hpp>
 #include <glm/gtx/quaternion.hpp>
+#include "EntityRegistry.h"
 
+// 姿勢は Core の EntityRegistry に格納され、Actor はエンティティのハンドルを通して読み書きする
 class Actor final : public std::enable_shared_from_this<Actor>
 {
 public:
@@ -22,7 +24,19 @@ public:
 		class Core& core,
 		const std::string& id);
 
-	void Update(float deltaTime);
+	// アクターの更新は、コンポーネントの更新順序ごとのフェーズに分けて Core から呼ばれる
+	// 同じフェーズの中では、異なるアクターの更新が並列に行われることがある
+	// ワールド変換は全てのフェーズの前後に EntityRegistry でまとめて計算される
+
+	/**
+	 * @brief 更新順序が updateOrder のコンポーネントを更新する
+	 *
+	 * @param deltaTime 経過時間
+	 * @param updateOrder 更新するコンポーネントの更新順序
+	 * @param parallel true なら並列に更新できるコンポーネントを、false ならそうでないコンポーネントを更新する
+	 */
+	void UpdateComponents(float deltaTime, int updateOrder, bool parallel);
+	// ワールド変換が古くなっていれば計算し直し、コンポーネントに通知する
 	void ComputeWorldTransform();
 	void ProcessInput(const struct InputState& state);
 	void Destroy();
@@ -30,9 +44,15 @@ public:
 	template <typename T>
 	std::shared_ptr<T> AddComponent(int updateOrder = 100);
 
+	// 型 T のコンポーネントを取得する(型ごとの表を引くので O(1))
 	template <typename T>
 	std::weak_ptr<T> GetComponent();
 
+	// 型 T のコンポーネントを参照カウントを操作せずに取得する(持っていなければ nullptr)
+	// 戻り値はアクターが生きている間だけ有効
+	template <typename T>
+	T* FindComponent() const;
+
 	// Getter/Setter
 
 	class Core& GetCore() const { return mCore; }
@@ -43,62 +63,68 @@ public:
 	std::string GetTag() const { return mTag; }
 	void SetTag(std::string tag) { mTag = tag; }
 
-	glm::vec3 GetPosition() const { return mPosition; }
-	void SetPosition(const glm::vec3& pos)
-	{
-		mShouldRecomputeWorldTransform = true;
-		mPosition = pos;
-	}
+	Entity GetEntity() const { return mEntity; }
 
-	glm::vec3 GetScale() const { return mScale; }
-	void SetScale(const glm::vec3& scale)
-	{
-		mShouldRecomputeWorldTransform = true;
-		mScale = scale;
-	}
+	glm::vec3 GetPosition() const { return mEntities.GetPosition(mEntity); }
+	void SetPosition(const glm::vec3& pos) { mEntities.SetPosition(mEntity, pos); }
 
-	glm::quat GetRotation() const { return mRotation; }
-	void SetRotation(const glm::quat& q)
-	{
-		mShouldRecomputeWorldTransform = true;
-		mRotation = q;
-	}
+	glm::vec3 GetScale() const { return mEntities.GetScale(mEntity); }
+	void SetScale(const glm::vec3& scale) { mEntities.SetScale(mEntity, scale); }
+
+	glm::quat GetRotation() const { return mEntities.GetRotation(mEntity); }
+	void SetRotation(const glm::quat& q) { mEntities.SetRotation(mEntity, q); }
 
 	ActorState GetState() const { return mState; }
 	void SetState(ActorState state) { mState = state; }
 
 	bool IsDead() const { return mIsDead; }
 
-	const glm::mat4 GetWorldTransform() const { return mWorldTransform; }
+	/**
+	 * @brief アクターを有効または無効にする
+	 * 無効にすると更新が止まり、全てのコンポーネントが無効になる(描画されず、剛体はシミュレーションから外れる)。
+	 * 有効に戻すと、無効にする前から無効だったコンポーネントは無効のままにして、それ以外を有効に戻す。
+	 * アクターを破棄せずに再利用する(ActorPool)ときに使う。
+	 *
+	 * @param active true なら有効にする
+	 */
+	void SetActive(bool active);
+
+	const glm::mat4& GetWorldTransform() const { return mEntities.GetWorldTransform(mEntity); }
 
 	// アクターの前方ベクトルを取得する
 	// Z軸の正の方向を奥方向とみなすので、OpenGLとかからメッシュデータをエクスポートするときは
 	// Z-forward にすること。
-	glm::vec3 GetForward() const { return mRotation * glm::vec3(0.0f, 0.0f, 1.0f); }
+	glm::vec3 GetForward() const { return GetRotation() * glm::vec3(0.0f, 0.0f, 1.0f); }
 	// アクターの右ベクトルを取得する
-	glm::vec3 GetRight() const { return mRotation * glm::vec3(1.0f, 0.0f, 0.0f); }
+	glm::vec3 GetRight() const { return GetRotation() * glm::vec3(1.0f, 0.0f, 0.0f); }
 	// アクターの上ベクトルを取得する
 	// Y軸の正の方向を上方向とみなすので、OpenGLとかからメッシュデータをエクスポートするときは
 	// Y-up にすること。
-	glm::vec3 GetUp() const { return mRotation * glm::vec3(0.0f, 1.0f, 0.0f); }
+	glm::vec3 GetUp() const { return GetRotation() * glm::vec3(0.0f, 1.0f, 0.0f); }
 
 private:
 	Actor(class Core& core, const std::string& id);
+	// 追加したコンポーネントの更新順序を Core の更新フェーズに登録する
+	void RegisterUpdatePhase(const class Component& component);
 
 	class Core& mCore;
 	std::string mID;
 	std::string mTag;
 
-	glm::vec3 mPosition{0.0f, 0.0f, 0.0f};
-	glm::vec3 mScale{1.0f, 1.0f, 1.0f};
-	glm::quat mRotation = glm::identity<glm::quat>();
-	glm::mat4 mWorldTransform;
+	// 姿勢を格納するエンティティ
+	EntityRegistry& mEntities;
+	Entity mEntity;
 
 	ActorState mState = ActorState::EActive;
 	bool mIsDead = false;
+	// SetActive で有効にしているかどうか
+	bool mIsActive = true;
+	// SetActive(false) の時点で既に無効だったコンポーネント(有効に戻すときに無効のままにする)
+	std::vector<const class Component*> mDisabledComponents;
 
 	std::vector<std::shared_ptr<class Component>> mComponents;
-	bool mShouldRecomputeWorldTransform = true;
+	// 型の通し番号(ComponentTypeId) -> その型の最初に追加されたコンポーネント
+	std::vector<std::shared_ptr<class Component>> mComponentsByType;
 };
 
 #include "ActorPrivate.h"
\ No newline at end of file
@@ -0,0 +1,58 @@
+#include "ActorPool.h"
+#include "Actor.h"
+
+ActorPool::ActorPool(Core& core, Factory factory)
+  : mCore(core),
+	mFactory(std::move(factory))
+{
+}
+
+void ActorPool::WarmUp(int count)
+{
+	mAvailable.reserve(mAvailable.size() + count);
+	for (int i = 0; i < count; i++)
+	{
+		auto actor = mFactory(mCore);
+		if (!actor) { break; }
+
+		actor->SetActive(false);
+		mAvailable.emplace_back(std::move(actor));
+	}
+}
+
+std::shared_ptr<Actor> ActorPool::Acquire(const glm::vec3& position, const glm::quat& rotation)
+{
+	std::shared_ptr<Actor> actor;
+
+	// 破棄(Actor::Destroy)されたアクターは Core から外れているので使わない
+	while (!mAvailable.empty() && !actor)
+	{
+		actor = std::move(mAvailable.back());
+		mAvailable.pop_back();
+		if (actor->IsDead()) { actor.reset(); }
+	}
+
+	if (!actor)
+	{
+		actor = mFactory(mCore);
+		if (!actor) { return nullptr; }
+
+		actor->SetActive(false);
+	}
+
+	// 剛体は有効にしたときの姿勢で登録し直されるので、姿勢を先に設定する
+	actor->SetPosition(position);
+	actor->SetRotation(rotation);
+	actor->ComputeWorldTransform();
+	actor->SetActive(true);
+
+	return actor;
+}
+
+void ActorPool::Release(const std::shared_ptr<Actor>& actor)
+{
+	if (!actor || actor->IsDead()) { return; }
+
+	actor->SetActive(false);
+	mAvailable.push_back(actor);
+}
\ No newline at end of file
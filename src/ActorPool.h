@@ -0,0 +1,60 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtx/quaternion.hpp>
+
+/**
+ * @brief 組み立て済みのアクター(メッシュ、剛体などのコンポーネントを含む)を再利用するプール
+ * 返却されたアクターは破棄せずに無効にして(Actor::SetActive)取っておき、次の Acquire で有効に戻して渡す。
+ * アクターの作成、メッシュの登録、剛体の形状の作成をやり直さないので、大量に生成と破棄を繰り返しても
+ * アクターとコンポーネントのメモリの確保が起こらない。
+ * ただし物理の側はその場で休ませるのではなく、無効にするときに PhysicsWorld から剛体を削除し
+ * (RemoveRigidbody、接触の掃除を含む)、有効に戻すときに改めて追加する(AddRigidbody)。
+ * 剛体のスロットは再利用されるが、ID は取り出すたびに変わる。
+ *
+ */
+class ActorPool
+{
+public:
+	// アクターを組み立てる関数(Core::CreateActor で作成し、コンポーネントを追加して返す。作成できなければ nullptr)
+	using Factory = std::function<std::shared_ptr<class Actor>(class Core& core)>;
+
+	ActorPool(class Core& core, Factory factory);
+
+	/**
+	 * @brief あらかじめアクターを組み立てて、無効にした状態で取っておく
+	 * シーンの読み込み時に呼んでおくと、生成のたびに組み立てずに済む。
+	 *
+	 * @param count 組み立てておくアクターの数
+	 */
+	void WarmUp(int count);
+
+	/**
+	 * @brief アクターを取り出して有効にする
+	 * 待機中のアクターがなければ新しく組み立てる。
+	 *
+	 * @param position 位置
+	 * @param rotation 回転
+	 * @return std::shared_ptr<class Actor> 有効になったアクター(組み立てられなかったら nullptr)
+	 */
+	std::shared_ptr<class Actor> Acquire(const glm::vec3& position, const glm::quat& rotation = glm::identity<glm::quat>());
+
+	/**
+	 * @brief アクターを無効にしてプールに戻す
+	 *
+	 * @param actor Acquire で取り出したアクター
+	 */
+	void Release(const std::shared_ptr<class Actor>& actor);
+
+	// 待機中のアクターの数
+	int GetNumAvailable() const { return (int)mAvailable.size(); }
+
+private:
+	class Core& mCore;
+	Factory mFactory;
+	// 待機中(無効)のアクター
+	std::vector<std::shared_ptr<class Actor>> mAvailable;
+};
\ No newline at end of file
@@ -19,20 +19,30 @@ std::shared_ptr<T> Actor::AddComponent(int updateOrder)
 	}
 
 	mComponents.insert(iter, comp);
+	RegisterUpdatePhase(*comp);
+
+	// 型ごとの表に登録する(同じ型が複数ある場合は最初のものを返す)
+	std::uint32_t typeId = ComponentTypeId::Get<T>();
+	if (typeId >= mComponentsByType.size()) { mComponentsByType.resize(typeId + 1); }
+	if (!mComponentsByType[typeId]) { mComponentsByType[typeId] = comp; }
+
 	return comp;
 }
 
 template <typename T>
 std::weak_ptr<T> Actor::GetComponent()
 {
-	for (auto comp : mComponents)
-	{
-		auto rawComp = comp.get();
-		if (typeid(*rawComp) == typeid(T))
-		{
-			return std::dynamic_pointer_cast<T>(comp);
-		}
-	}
+	std::uint32_t typeId = ComponentTypeId::Get<T>();
+	if (typeId >= mComponentsByType.size()) { return std::weak_ptr<T>(); }
+
+	// 表には AddComponent<T> で追加したものだけが入っているので、型の確認は要らない
+	return std::static_pointer_cast<T>(mComponentsByType[typeId]);
+}
 
-	return std::weak_ptr<T>();
+template <typename T>
+T* Actor::FindComponent() const
+{
+	std::uint32_t typeId = ComponentTypeId::Get<T>();
+	if (typeId >= mComponentsByType.size()) { return nullptr; }
+	return static_cast<T*>(mComponentsByType[typeId].get());
 }
\ No newline at end of file
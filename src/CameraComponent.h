@@ -9,6 +9,7 @@ public:
 		std::weak_ptr<class Actor> owner,
 		int updateOrder);
 
+	// Renderer のビュー行列を変更するので、並列には更新しない
 	void Update(float deltaTime) override;
 
 private:
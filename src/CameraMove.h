@@ -11,6 +11,8 @@ public:
 
 	void ProcessInput(const struct InputState& state) override;
 	void Update(float deltaTime) override;
+	// 持ち主のアクターの姿勢だけを変更する
+	bool CanUpdateInParallel() const override { return true; }
 
 private:
 	CameraMove(std::weak_ptr<class Actor> owner, int updateOrder);
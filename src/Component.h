@@ -9,12 +9,20 @@ public:
 
 	virtual void ProcessInput(const struct InputState& state);
 	virtual void Update(float deltaTime);
+	// Actor::ComputeWorldTransform でワールド変換が計算し直されたときに呼ばれる
+	// (EntityRegistry でまとめて計算された場合は呼ばれない)
 	virtual void OnUpdateWorldTransform();
 
 	std::weak_ptr<class Actor> GetOwner() const { return mOwner; }
 	int GetUpdateOrder() const { return mUpdateOrder; }
 	bool GetEnabled() const { return mIsEnabled; }
-	void SetEnabled(bool enabled) { mIsEnabled = enabled; }
+	// 無効にしたときに外部のシステムから登録を外すコンポーネントは、オーバーライドして処理を追加する
+	virtual void SetEnabled(bool enabled) { mIsEnabled = enabled; }
+
+	// 他のアクターのコンポーネントと並列に Update してよいかどうか(既定では並列にしない)
+	// Update が自分のアクターとコンポーネントの状態しか変更しない場合だけ、オーバーライドして true を返す
+	// アクターの作成や Renderer、PhysicsWorld への登録と変更は、並列の Update の中では行えない
+	virtual bool CanUpdateInParallel() const { return false; }
 
 protected:
 	Component(std::weak_ptr<class Actor> owner,
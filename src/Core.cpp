@@ -4,26 +4,39 @@
 #include "Actor.h"
 #include "SceneLoader.h"
 #include "PhysicsWorld.h"
+#include "JobSystem.h"
+#include "EntityRegistry.h"
 
 #include <algorithm>
+#include <cassert>
 #include <glm/glm.hpp>
 
-Core::Core() {}
+Core::Core()
+  : mMainThread(std::this_thread::get_id())
+{
+}
 
 // Core.h にて 前方参照で Renderer を unique_ptr で持つために
 // デストラクタを非インライン化する。
 Core::~Core() = default;
 
-bool Core::Initialize()
+bool Core::Initialize(bool headless)
 {
-	if (SDL_Init(SDL_INIT_VIDEO) != 0)
+	mIsHeadless = headless;
+
+	// ヘッドレスではビデオのサブシステムを初期化しない(ディスプレイのない環境でも動くように)
+	if (SDL_Init(mIsHeadless ? SDL_INIT_TIMER : SDL_INIT_VIDEO) != 0)
 	{
 		SDL_Log("Unable to initialize SDL : %s", SDL_GetError());
 		return false;
 	}
 
+	// 各システムがスレッドを作らずに処理を並列化できるように、共有のジョブシステムを作る
+	mJobSystem = std::make_unique<JobSystem>();
+	mEntities = std::make_unique<EntityRegistry>();
+
 	mInputSystem = std::make_unique<InputSystem>(*this);
-	if (!mInputSystem->Initialize())
+	if (!mInputSystem->Initialize(mIsHeadless))
 	{
 		SDL_Log("Failed to initialize Input System");
 		mInputSystem.reset();
@@ -31,7 +44,7 @@ bool Core::Initialize()
 	}
 
 	mRenderer = std::make_unique<Renderer>(*this);
-	if (!mRenderer->Initialize(1024.0f, 768.0f))
+	if (!mRenderer->Initialize(1024.0f, 768.0f, mIsHeadless))
 	{
 		SDL_Log("Failed to initialize renderer.");
 		mRenderer.reset();
@@ -39,10 +52,28 @@ bool Core::Initialize()
 	}
 
 	mPhysicsWorld = std::make_unique<PhysicsWorld>();
+	mPhysicsWorld->SetJobSystem(mJobSystem.get());
+	// キューブを大量に撃ち出したときなどに、フレームが落ちる代わりに接触を少し柔らかくする
+	// ヘッドレスでは処理速度を測るので、品質は下げない
+	if (!mIsHeadless)
+	{
+		PhysicsBudgetSettings budget;
+		budget.enabled = true;
+		mPhysicsWorld->SetBudgetSettings(budget);
+	}
 
 	mTicksCount = SDL_GetTicks();
 
 	SceneLoader::LoadScene(*this);
+	AddPendingActors();
+
+	// シーンの構築が終わってから、シミュレーションを専用のスレッドで始める
+	// 以降、剛体の追加や属性の変更はステップの境目で反映され、描画とシミュレーションは並行して進む
+	// ヘッドレスでは実時間に合わせずにステップを進めたいので、スレッドを使わずに Update の中でステップを行う
+	if (!mIsHeadless)
+	{
+		mPhysicsWorld->StartThread();
+	}
 
 	return true;
 }
@@ -57,8 +88,49 @@ void Core::RunLoop()
 	}
 }
 
+void Core::RunHeadless(int numFrames, const InputScript& script)
+{
+	if (!mIsHeadless)
+	{
+		SDL_Log("RunHeadless requires Core::Initialize(true).");
+		return;
+	}
+
+	mInputScript = script;
+
+	const double frequency = (double)SDL_GetPerformanceFrequency();
+	const Uint64 startCounter = SDL_GetPerformanceCounter();
+	const Uint64 startSteps = mNumPhysicsSteps;
+
+	for (mHeadlessFrame = 0; mHeadlessFrame < numFrames && mIsRunning; mHeadlessFrame++)
+	{
+		ProcessInput();
+		Update();
+	}
+
+	double seconds = (SDL_GetPerformanceCounter() - startCounter) / frequency;
+	Uint64 numSteps = mNumPhysicsSteps - startSteps;
+	if (seconds <= 0.0) { seconds = 1.0 / frequency; }
+	int frames = mHeadlessFrame;
+
+	SDL_Log("Headless: %d frames, %llu steps, %zu actors, %d rigid bodies in %.3f s (%.1f frames/s, %.1f steps/s)",
+			frames,
+			(unsigned long long)numSteps,
+			mActors.size(),
+			mPhysicsWorld->GetNumRigidbodies(),
+			seconds,
+			frames / seconds,
+			numSteps / seconds);
+}
+
 void Core::Shutdown()
 {
+	// アクターの破棄(剛体の削除)より先にシミュレーションのスレッドを止める
+	if (mPhysicsWorld)
+	{
+		mPhysicsWorld->StopThread();
+	}
+
 	if (mRenderer)
 	{
 		mRenderer->Shutdown();
@@ -74,26 +146,75 @@ void Core::Shutdown()
 
 std::shared_ptr<Actor> Core::CreateActor(const std::string& id)
 {
+	assert(IsInSerialSection() && "Core::CreateActor must be called from the main thread outside of parallel updates");
+
+	// 直列の区間では姿勢の配列に触れている他のスレッドはないので、ここでエンティティの容量を拡張する
+	if (mEntities->IsFull() && !mEntities->Reserve(mEntities->GetCapacity() * 2))
+	{
+		SDL_Log("Failed to create actor %s: too many entities.", id.c_str());
+		return nullptr;
+	}
+
 	auto actor = Actor::Create(*this, id);
 
-	if (mUpdatingActors)
+	// 更新中のアクターのリストを変更しないように、いったん作成待ちのリストに入れる
+	mPendingActors.emplace_back(actor);
+
+	return actor;
+}
+
+void Core::RegisterUpdatePhase(int updateOrder, bool parallel)
+{
+	assert(IsInSerialSection() && "Core::RegisterUpdatePhase must be called from the main thread outside of parallel updates");
+
+	if (mIsUpdatingActors)
 	{
-		mPendingActors.emplace_back(actor);
+		mPendingUpdatePhases.push_back(UpdatePhase{updateOrder, !parallel});
+		return;
 	}
-	else
+
+	auto iter = std::lower_bound(
+		mUpdatePhases.begin(),
+		mUpdatePhases.end(),
+		updateOrder,
+		[](const UpdatePhase& phase, int order) {
+			return phase.updateOrder < order;
+		});
+
+	if (iter == mUpdatePhases.end() || iter->updateOrder != updateOrder)
 	{
-		mActors.emplace_back(actor);
+		iter = mUpdatePhases.insert(iter, UpdatePhase{updateOrder, false});
 	}
+	iter->hasSerialComponents |= !parallel;
+}
 
-	return actor;
+bool Core::IsInSerialSection() const
+{
+	return std::this_thread::get_id() == mMainThread && !JobSystem::IsInJob();
+}
+
+void Core::AddPendingActors()
+{
+	for (auto& pending : mPendingActors)
+	{
+		pending->ComputeWorldTransform();
+		mActors.emplace_back(std::move(pending));
+	}
+	mPendingActors.clear();
 }
 
 void Core::ProcessInput()
 {
 	mInputSystem->PrepareForUpdate();
 
+	// ヘッドレスではウィンドウのイベントがないので、スクリプトで入力を与える
+	if (mIsHeadless && mInputScript)
+	{
+		mInputScript(mHeadlessFrame, *mInputSystem);
+	}
+
 	SDL_Event event;
-	while (SDL_PollEvent(&event))
+	while (!mIsHeadless && SDL_PollEvent(&event))
 	{
 		switch (event.type)
 		{
@@ -115,48 +236,81 @@ void Core::ProcessInput()
 		mIsRunning = false;
 	}
 
-	mUpdatingActors = true;
-	for (auto actor : mActors)
+	for (const auto& actor : mActors)
 	{
 		actor->ProcessInput(state);
 	}
-	mUpdatingActors = false;
 }
 
 void Core::Update()
 {
-	// 前回のフレームから16ms経過するまで待機
-	// つまり、目標のフレームレートは約60FPS
-	while (!SDL_TICKS_PASSED(SDL_GetTicks(), mTicksCount + 16))
-		;
+	float deltaTime;
+	if (mIsHeadless)
+	{
+		// ヘッドレスでは待機せず、1フレームでちょうど1ステップ進むように経過時間を固定する
+		deltaTime = mPhysicsWorld->GetTimeStep();
+	}
+	else {
+		// 前回のフレームから mFrameTicks 経過するまで待機
+		// 垂直同期が有効なら SwapWindow で待機済みなので、ここではほとんど待たない
+		// CPUを占有しないように、ビジーループではなくスリープする
+		Uint32 elapsed = SDL_GetTicks() - mTicksCount;
+		if (elapsed < mFrameTicks)
+		{
+			SDL_Delay(mFrameTicks - elapsed);
+		}
 
-	float deltaTime = (SDL_GetTicks() - mTicksCount) / 1000.0f;
-	if (deltaTime > 0.05f) { deltaTime = 0.05f; }
-	mTicksCount = SDL_GetTicks();
+		deltaTime = (SDL_GetTicks() - mTicksCount) / 1000.0f;
+		if (deltaTime > 0.05f) { deltaTime = 0.05f; }
+		mTicksCount = SDL_GetTicks();
+	}
+
+	// 剛体シミュレーションの最新のスナップショットを取得
+	// シミュレーションは専用のスレッドで固定タイムステップで進む(ヘッドレスではここでステップを行う)
+	mNumPhysicsSteps += mPhysicsWorld->Update(deltaTime);
+	// 直前の2ステップの間を補間した剛体の姿勢を、アクターのワールド変換にまとめて書き出す
+	mPhysicsWorld->SyncActorTransforms(*mEntities);
+
+	// アクターの更新
+	// コンポーネントの更新順序ごとのフェーズに分け、フェーズの中ではアクターを並列に更新する
+	// 並列に更新できないコンポーネントは、そのフェーズの並列の更新の後に順番に更新する
+	// (フェーズは更新中に増えることがあるが、増えたフェーズは更新の後で加えて次のフレームから使う)
+	// shared_ptr をコピーせずに参照して、参照カウントの更新を避ける
+	const std::shared_ptr<Actor>* actors = mActors.data();
+	int numActors = (int)mActors.size();
 
-	mUpdatingActors = true;
-	for (auto actor : mActors)
+	// 入力処理などで変更された姿勢のワールド変換を、姿勢の配列を走査してまとめて計算する
+	mEntities->UpdateWorldTransforms(mJobSystem.get());
+
+	mIsUpdatingActors = true;
+	for (const UpdatePhase& phase : mUpdatePhases)
 	{
-		actor->Update(deltaTime);
+		mJobSystem->ParallelFor(0, numActors, mActorsPerJob, [actors, deltaTime, &phase](int first, int last) {
+			for (int i = first; i < last; i++) { actors[i]->UpdateComponents(deltaTime, phase.updateOrder, true); }
+		});
+
+		if (phase.hasSerialComponents)
+		{
+			for (int i = 0; i < numActors; i++) { actors[i]->UpdateComponents(deltaTime, phase.updateOrder, false); }
+		}
 	}
-	mUpdatingActors = false;
+	mIsUpdatingActors = false;
 
-	for (auto pending : mPendingActors)
+	for (const UpdatePhase& phase : mPendingUpdatePhases)
 	{
-		pending->ComputeWorldTransform();
-		mActors.emplace_back(pending);
+		RegisterUpdatePhase(phase.updateOrder, !phase.hasSerialComponents);
 	}
-	mPendingActors.clear();
+	mPendingUpdatePhases.clear();
+
+	mEntities->UpdateWorldTransforms(mJobSystem.get());
 
-	// 剛体シミュレーションを実行
-	// TODO: 並列処理化する
-	mPhysicsWorld->Simulate();
+	AddPendingActors();
 
 	// 死亡したアクターをリストから除去
 	auto tail = std::remove_if(
 		mActors.begin(),
 		mActors.end(),
-		[](std::shared_ptr<Actor> actor) {
+		[](const std::shared_ptr<Actor>& actor) {
 			return actor->IsDead();
 		});
 
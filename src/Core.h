@@ -1,38 +1,122 @@
 #pragma once
 
 #include <SDL.h>
+#include <functional>
 #include <string>
 #include <vector>
 #include <memory>
+#include <thread>
 
 class Core
 {
 public:
+	// ヘッドレスでの実行中に、フレームごとに入力を与える関数(frame は 0 から数えたフレーム番号)
+	using InputScript = std::function<void(int frame, class InputSystem& input)>;
+
 	Core();
 	~Core();
-	bool Initialize();
+
+	/**
+	 * @brief 各システムを初期化してシーンを読み込む
+	 *
+	 * @param headless true ならウィンドウと GL を使わずに初期化する
+	 * (描画は行わず、入力は RunHeadless に渡したスクリプトで与える。シミュレーションは専用のスレッドを使わない)
+	 * @return bool 初期化できたかどうか
+	 */
+	bool Initialize(bool headless = false);
 	void RunLoop();
+
+	/**
+	 * @brief ヘッドレスで、待機せずに固定の経過時間でフレームを進める
+	 * 1フレームで剛体シミュレーションを1ステップ行い、終わったら1秒あたりのフレーム数とステップ数を出力する。
+	 *
+	 * @param numFrames 進めるフレーム数
+	 * @param script フレームごとに入力を与える関数(空なら何も入力しない)
+	 */
+	void RunHeadless(int numFrames, const InputScript& script = InputScript());
 	void Shutdown();
+	bool IsHeadless() const { return mIsHeadless; }
 	std::string GetWindowName() const { return mWindowName; }
 	class Renderer& GetRenderer() const { return *mRenderer; }
 	class PhysicsWorld& GetPhysicsWorld() const { return *mPhysicsWorld; }
+	class JobSystem& GetJobSystem() const { return *mJobSystem; }
+	class EntityRegistry& GetEntities() const { return *mEntities; }
 
+	/**
+	 * @brief アクターを作成する
+	 * 作成したアクターは、次の更新の終わりにアクターのリストに追加される。
+	 * エンティティの作成や、コンポーネントの Renderer、PhysicsWorld への登録をその場で行うので、
+	 * メインスレッドの直列の区間(入力処理、直列に更新するコンポーネント、シーンの読み込み)からだけ呼ぶ。
+	 * 並列に更新するコンポーネントの Update から呼ぶと assert で止まる。
+	 * エンティティの容量に達していたら、ここで EntityRegistry を拡張する。
+	 *
+	 * @param id アクターのID
+	 * @return std::shared_ptr<class Actor> 作成したアクター(エンティティの数が上限に達していたら nullptr)
+	 */
 	std::shared_ptr<class Actor> CreateActor(const std::string& id);
 
+	/**
+	 * @brief コンポーネントの更新順序を更新フェーズとして登録する
+	 * アクターの更新は、登録された更新順序の昇順のフェーズに分けて行われる。
+	 * CreateActor と同じく、メインスレッドの直列の区間からだけ呼ぶ。
+	 * アクターの更新中に登録したフェーズは、次のフレームから使われる。
+	 *
+	 * @param updateOrder コンポーネントの更新順序
+	 * @param parallel コンポーネントが並列に更新できるかどうか
+	 */
+	void RegisterUpdatePhase(int updateOrder, bool parallel);
+
+	// メインスレッドで、ジョブの外(アクターの並列の更新の外)にいるかどうか
+	// アクターの作成や、Renderer と PhysicsWorld への登録はこの区間でだけ行える
+	bool IsInSerialSection() const;
+
 private:
 	void ProcessInput();
 	void Update();
 	void GenerateOutput();
+	// 作成待ちのアクターをアクターのリストに追加する
+	void AddPendingActors();
 
 	bool mIsRunning = true;
+	// Core を作ったスレッド(メインスレッド)
+	std::thread::id mMainThread;
+	// ウィンドウと GL を使わずに動かしているかどうか
+	bool mIsHeadless = false;
+	// ヘッドレスでの入力のスクリプトと、現在のフレーム番号
+	InputScript mInputScript;
+	int mHeadlessFrame = 0;
+	// これまでに行った剛体シミュレーションのステップ数
+	Uint64 mNumPhysicsSteps = 0;
 	Uint32 mTicksCount = 0;
+	// 1フレームの目標時間(ミリ秒)
+	// 垂直同期が使えない場合はこの時間になるまでスリープする
+	Uint32 mFrameTicks = 16;
 	std::string mWindowName = "Physics Simulation";
-	bool mUpdatingActors = false;
+	// 1つのジョブで更新するアクターの数
+	static const inline int mActorsPerJob{64};
 
+	// 他のシステムより先に作り、後に破棄する
+	std::unique_ptr<class JobSystem> mJobSystem;
+	// アクターの姿勢とコンポーネントのデータ(アクターより後に破棄する)
+	std::unique_ptr<class EntityRegistry> mEntities;
 	std::unique_ptr<class Renderer> mRenderer;
 	std::unique_ptr<class InputSystem> mInputSystem;
 	std::unique_ptr<class PhysicsWorld> mPhysicsWorld;
 
+	// アクターの更新フェーズ(更新順序の昇順)
+	struct UpdatePhase
+	{
+		int updateOrder;
+		// 並列に更新できないコンポーネントがあるかどうか
+		bool hasSerialComponents;
+	};
+	std::vector<UpdatePhase> mUpdatePhases;
+	// アクターの更新中に登録されたフェーズ(更新の後で mUpdatePhases に加える)
+	// 更新中は mUpdatePhases に挿入しないので、フェーズを参照したまま走査できる
+	std::vector<UpdatePhase> mPendingUpdatePhases;
+	bool mIsUpdatingActors = false;
+
 	std::vector<std::shared_ptr<class Actor>> mActors;
+	// 作成待ちのアクター(更新中に直列に更新するコンポーネントから追加される)
 	std::vector<std::shared_ptr<class Actor>> mPendingActors;
 };
\ No newline at end of file
@@ -25,6 +25,7 @@ void CubeGenerator::ProcessInput(const InputState& state)
 			mOwner.lock()->GetCore(),
 			"Cube" + std::to_string(mCount),
 			PresetActor::PresetType::Cube);
+		if (!cube) { return; }
 
 		cube->SetPosition(mGenPosition);
 		++mCount;
@@ -4,6 +4,7 @@
 #include "RigidBody.h"
 #include "MeshComponent.h"
 #include "Actor.h"
+#include "ActorPool.h"
 
 #include <SDL_scancode.h>
 
@@ -18,6 +19,41 @@ CubeShooter::CubeShooter(std::weak_ptr<Actor> owner,
 						 int updateOrder)
   : Component(owner, updateOrder)
 {
+	// 撃ち出すキューブ(メッシュと剛体を含む)は組み立てたものを使い回す
+	mPool = std::make_unique<ActorPool>(
+		owner.lock()->GetCore(),
+		[](Core& core) {
+			auto cube = PresetActor::CreatePreset(core, "cube", PresetActor::PresetType::Cube);
+			if (!cube) { return cube; }
+
+			cube->SetScale(glm::vec3(0.5f));
+
+			MeshComponent::Material& mat = cube->FindComponent<MeshComponent>()->GetMaterial();
+			mat.mAmbient = glm::vec3(0.9f, 0.1f, 0.9f);
+			mat.mDiffuse = glm::vec3(0.9f, 0.1f, 0.9f);
+			mat.mSpecular = glm::vec3(0.9f, 0.9f, 0.9f);
+			mat.mSmoothness = 100.0f;
+
+			cube->AddComponent<RigidBody>();
+			return cube;
+		});
+}
+
+void CubeShooter::WarmUp(int count)
+{
+	mPool->WarmUp(count);
+}
+
+void CubeShooter::SetMaxShots(size_t maxShots)
+{
+	mMaxShots = maxShots;
+
+	// 既に上限を超えていれば、古いものからプールに戻す
+	while (mMaxShots > 0 && mShots.size() > mMaxShots)
+	{
+		mPool->Release(mShots.front());
+		mShots.pop_front();
+	}
 }
 
 void CubeShooter::ProcessInput(const struct InputState& state)
@@ -25,19 +61,18 @@ void CubeShooter::ProcessInput(const struct InputState& state)
 	if (state.keyboard.GetKeyDown(SDL_SCANCODE_SPACE))
 	{
 		auto owner = mOwner.lock();
-		auto cube = PresetActor::CreatePreset(
-			owner->GetCore(), "cube", PresetActor::PresetType::Cube);
-		cube->SetPosition(owner->GetPosition());
-		cube->SetScale(glm::vec3(0.5f));
-
-		auto meshComponent = cube->GetComponent<MeshComponent>();
-		MeshComponent::Material& mat = meshComponent.lock()->GetMaterial();
-		mat.mAmbient = glm::vec3(0.9f, 0.1f, 0.9f);
-		mat.mDiffuse = glm::vec3(0.9f, 0.1f, 0.9f);
-		mat.mSpecular = glm::vec3(0.9f, 0.9f, 0.9f);
-		mat.mSmoothness = 100.0f;
-
-		auto rb = cube->AddComponent<RigidBody>();
-		rb->ApplyImpulse(owner->GetForward() * 20.0f);
+
+		// 上限に達していたら、一番古いキューブをプールに戻す
+		if (mMaxShots > 0 && mShots.size() >= mMaxShots)
+		{
+			mPool->Release(mShots.front());
+			mShots.pop_front();
+		}
+
+		auto cube = mPool->Acquire(owner->GetPosition());
+		if (!cube) { return; }
+
+		cube->FindComponent<RigidBody>()->ApplyImpulse(owner->GetForward() * 20.0f);
+		mShots.push_back(cube);
 	}
 }
\ No newline at end of file
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Component.h"
+#include <deque>
 
 class CubeShooter : public Component
 {
@@ -11,7 +12,28 @@ public:
 
 	void ProcessInput(const struct InputState& state) override;
 
+	// 撃ち出すキューブをあらかじめ count 個組み立てておく
+	void WarmUp(int count);
+
+	/**
+	 * @brief 同時に存在する撃ち出したキューブの数の上限を設定する
+	 * 上限に達した状態で撃つと、一番古いキューブが消えて(プールに戻されて)新しいキューブとして撃ち出される。
+	 * 使い回しでも剛体は PhysicsWorld から一度削除されて追加し直される(ActorPool を参照)。
+	 * 0 なら上限を設けず、撃ったキューブは消えずに残り続ける(既定)。
+	 *
+	 * @param maxShots 同時に存在するキューブの数の上限
+	 */
+	void SetMaxShots(size_t maxShots);
+	size_t GetMaxShots() const { return mMaxShots; }
+
 private:
 	CubeShooter(std::weak_ptr<class Actor> owner,
 				int updateOrder);
+
+	// 同時に存在するキューブの数の上限(0 なら上限なし)
+	size_t mMaxShots = 0;
+
+	std::unique_ptr<class ActorPool> mPool;
+	// 撃ち出したキューブ(古い順)
+	std::deque<std::shared_ptr<class Actor>> mShots;
 };
\ No newline at end of file
@@ -0,0 +1,172 @@
+#include "EntityRegistry.h"
+#include "JobSystem.h"
+
+#include <SDL.h>
+#include <algorithm>
+#include <cassert>
+
+namespace
+{
+// 位置、回転、スケールからワールド変換を作る
+// T・R・S の行列の積を使わずに、回転行列の列にスケールを掛けて直接組み立てる
+inline glm::mat4 ComposeWorldTransform(const glm::vec3& pos, const glm::quat& q, const glm::vec3& scale)
+{
+	glm::mat3 rotation = glm::toMat3(q);
+	return glm::mat4(
+		glm::vec4(rotation[0] * scale.x, 0.0f),
+		glm::vec4(rotation[1] * scale.y, 0.0f),
+		glm::vec4(rotation[2] * scale.z, 0.0f),
+		glm::vec4(pos, 1.0f));
+}
+};	// namespace
+
+EntityRegistry::EntityRegistry(int capacity)
+{
+	Reserve(std::max(capacity, 1));
+}
+
+EntityRegistry::~EntityRegistry() = default;
+
+bool EntityRegistry::Reserve(std::size_t capacity)
+{
+	assert(!JobSystem::IsInJob() && "EntityRegistry::Reserve moves the pose arrays and must not be called from a job");
+
+	if (capacity <= mCapacity) { return true; }
+	if (capacity > mMaxEntities)
+	{
+		SDL_Log("EntityRegistry: cannot reserve %zu entities (limit %zu).", capacity, mMaxEntities);
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	// 作成では push_back しかしないので、容量の分だけ確保しておけば作成中に配列は移動しない
+	// スロットの数はエンティティの数の最大値を超えないので、スロットの配列も同じ容量でよい
+	mPositions.reserve(capacity);
+	mRotations.reserve(capacity);
+	mScales.reserve(capacity);
+	mWorldTransforms.reserve(capacity);
+	mDirty.reserve(capacity);
+	mDenseToSlot.reserve(capacity);
+	mSlotToDense.reserve(capacity);
+	mGenerations.reserve(capacity);
+	mFreeSlots.reserve(capacity);
+	mCapacity = capacity;
+	return true;
+}
+
+Entity EntityRegistry::CreateEntity()
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	// 並列の更新中に作成されることがあるので、配列を拡張せずに失敗する
+	if (mPositions.size() >= mCapacity)
+	{
+		SDL_Log("EntityRegistry: cannot create more than %zu entities.", mCapacity);
+		return INVALID_ENTITY;
+	}
+
+	// 削除されたエンティティのスロットがあれば再利用する
+	std::uint32_t slot;
+	if (!mFreeSlots.empty())
+	{
+		slot = mFreeSlots.back();
+		mFreeSlots.pop_back();
+	}
+	else {
+		slot = mGenerations.size();
+		mGenerations.push_back(0);
+		mSlotToDense.push_back(0);
+	}
+
+	mSlotToDense[slot] = mPositions.size();
+	mDenseToSlot.push_back(slot);
+	mPositions.push_back(glm::vec3(0.0f));
+	mRotations.push_back(glm::identity<glm::quat>());
+	mScales.push_back(glm::vec3(1.0f));
+	mWorldTransforms.push_back(glm::mat4(1.0f));
+	mDirty.push_back(0);
+
+	return MakeEntity(slot);
+}
+
+void EntityRegistry::DestroyEntity(Entity entity)
+{
+	if (!IsValid(entity)) { return; }
+
+	std::uint32_t slot = SlotOf(entity);
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	// 末尾のエンティティを空いた位置に移して詰める
+	std::uint32_t dense = mSlotToDense[slot];
+	std::uint32_t last = mPositions.size() - 1;
+	mPositions[dense] = mPositions[last];
+	mRotations[dense] = mRotations[last];
+	mScales[dense] = mScales[last];
+	mWorldTransforms[dense] = mWorldTransforms[last];
+	mDirty[dense] = mDirty[last];
+	mDenseToSlot[dense] = mDenseToSlot[last];
+	mSlotToDense[mDenseToSlot[dense]] = dense;
+
+	mPositions.pop_back();
+	mRotations.pop_back();
+	mScales.pop_back();
+	mWorldTransforms.pop_back();
+	mDirty.pop_back();
+	mDenseToSlot.pop_back();
+
+	// 世代番号を進めて、削除したエンティティのハンドルを無効にする
+	mGenerations[slot] = (mGenerations[slot] + 1) & mGenerationMask;
+	mFreeSlots.push_back(slot);
+}
+
+bool EntityRegistry::IsValid(Entity entity) const
+{
+	if (entity == INVALID_ENTITY) { return false; }
+
+	std::uint32_t slot = SlotOf(entity);
+	return slot < mGenerations.size() && MakeEntity(slot) == entity;
+}
+
+void EntityRegistry::SetPose(Entity entity, const glm::vec3& pos, const glm::quat& q)
+{
+	std::uint32_t dense = DenseOf(entity);
+	mPositions[dense] = pos;
+	mRotations[dense] = q;
+	mWorldTransforms[dense] = ComposeWorldTransform(pos, q, mScales[dense]);
+	mDirty[dense] = 0;
+}
+
+bool EntityRegistry::ComputeWorldTransform(Entity entity)
+{
+	std::uint32_t dense = DenseOf(entity);
+	if (!mDirty[dense]) { return false; }
+
+	UpdateWorldTransforms(dense, dense + 1);
+	return true;
+}
+
+void EntityRegistry::UpdateWorldTransforms(JobSystem* jobSystem)
+{
+	std::uint32_t numEntities = mPositions.size();
+	if (jobSystem)
+	{
+		jobSystem->ParallelFor(0, (int)numEntities, mEntitiesPerJob, [this](int first, int last) {
+			UpdateWorldTransforms((std::uint32_t)first, (std::uint32_t)last);
+		});
+	}
+	else {
+		UpdateWorldTransforms(0, numEntities);
+	}
+}
+
+void EntityRegistry::UpdateWorldTransforms(std::uint32_t first, std::uint32_t last)
+{
+	for (std::uint32_t i = first; i < last; i++)
+	{
+		if (!mDirty[i]) { continue; }
+
+		mWorldTransforms[i] = ComposeWorldTransform(mPositions[i], mRotations[i], mScales[i]);
+		mDirty[i] = 0;
+	}
+}
\ No newline at end of file
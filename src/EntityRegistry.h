@@ -0,0 +1,178 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtx/quaternion.hpp>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// エンティティのハンドル(スロット番号と、スロットが再利用されるたびに増える世代番号からなる)
+using Entity = std::uint32_t;
+const Entity INVALID_ENTITY = 0xFFFFFFFFu;
+
+/**
+ * @brief コンポーネントの型ごとの通し番号を返す
+ * 型ごとに1回だけ採番されるので、型をキーにした配列のインデックスとして O(1) で使える。
+ *
+ */
+class ComponentTypeId
+{
+public:
+	template <typename T>
+	static std::uint32_t Get()
+	{
+		static const std::uint32_t id = sNextId.fetch_add(1, std::memory_order_relaxed);
+		return id;
+	}
+
+private:
+	static inline std::atomic<std::uint32_t> sNextId{0};
+};
+
+/**
+ * @brief エンティティと、その姿勢のデータを格納する
+ * 姿勢(位置、回転、スケール、ワールド変換)は全てのエンティティが持ち、要素ごとの密な配列(SoA)に格納する。
+ * メッシュや剛体などのコンポーネントのデータは、今のところ Actor のコンポーネントが持つ。
+ * Actor はエンティティのハンドルを持つ薄いラッパーで、姿勢の読み書きはここに転送される。
+ *
+ * 姿勢の読み書きは、エンティティごとなら複数のスレッドから並列に行える。
+ * エンティティの作成はどのスレッドから呼んでもよい。作成では配列を拡張しない(容量に達したら失敗する)ので、
+ * 他のスレッドが姿勢を読み書きしている最中でも配列は移動しない。
+ * 容量の拡張(Reserve)とエンティティの削除は、他のスレッドが
+ * レジストリに触れていない直列の区間で1つのスレッドから行う。
+ *
+ */
+class EntityRegistry
+{
+public:
+	/**
+	 * @param capacity あらかじめ確保しておくエンティティの数(Reserve で拡張するまで、これを超えて作成できない)
+	 */
+	explicit EntityRegistry(int capacity = 256);
+	~EntityRegistry();
+
+	EntityRegistry(const EntityRegistry&) = delete;
+	EntityRegistry& operator=(const EntityRegistry&) = delete;
+
+	/**
+	 * @brief エンティティを作成する(姿勢は原点、回転なし、スケール1で初期化される)
+	 * 容量に達していたら配列を拡張せずに失敗する。
+	 *
+	 * @return Entity エンティティのハンドル(容量に達していたら INVALID_ENTITY)
+	 */
+	Entity CreateEntity();
+
+	/**
+	 * @brief 作成できるエンティティの数を capacity まで拡張する
+	 * 配列が移動するので、ジョブの中や、他のスレッドが姿勢を読み書きしている最中に呼んではいけない。
+	 *
+	 * @param capacity 作成できるエンティティの数
+	 * @return bool 拡張できたかどうか(ハンドルで表せる数を超える場合は拡張しない)
+	 */
+	bool Reserve(std::size_t capacity);
+
+	/**
+	 * @brief エンティティを削除する
+	 *
+	 * @param entity エンティティのハンドル
+	 */
+	void DestroyEntity(Entity entity);
+
+	bool IsValid(Entity entity) const;
+	std::size_t GetNumEntities() const { return mPositions.size(); }
+	std::size_t GetCapacity() const { return mCapacity; }
+	bool IsFull() const { return GetNumEntities() >= mCapacity; }
+
+	///////////////////////////////////////////////////////////////////////////////
+	//
+	// 姿勢
+
+	const glm::vec3& GetPosition(Entity entity) const { return mPositions[DenseOf(entity)]; }
+	const glm::quat& GetRotation(Entity entity) const { return mRotations[DenseOf(entity)]; }
+	const glm::vec3& GetScale(Entity entity) const { return mScales[DenseOf(entity)]; }
+	const glm::mat4& GetWorldTransform(Entity entity) const { return mWorldTransforms[DenseOf(entity)]; }
+
+	void SetPosition(Entity entity, const glm::vec3& pos)
+	{
+		std::uint32_t dense = DenseOf(entity);
+		mPositions[dense] = pos;
+		mDirty[dense] = 1;
+	}
+	void SetRotation(Entity entity, const glm::quat& q)
+	{
+		std::uint32_t dense = DenseOf(entity);
+		mRotations[dense] = q;
+		mDirty[dense] = 1;
+	}
+	void SetScale(Entity entity, const glm::vec3& scale)
+	{
+		std::uint32_t dense = DenseOf(entity);
+		mScales[dense] = scale;
+		mDirty[dense] = 1;
+	}
+
+	/**
+	 * @brief 位置と回転を設定し、現在のスケールと合わせたワールド変換をその場で計算する
+	 *
+	 * @param entity エンティティのハンドル
+	 * @param pos 位置
+	 * @param q 回転
+	 */
+	void SetPose(Entity entity, const glm::vec3& pos, const glm::quat& q);
+
+	/**
+	 * @brief ワールド変換が古くなっていれば計算し直す
+	 *
+	 * @param entity エンティティのハンドル
+	 * @return bool 計算し直したかどうか
+	 */
+	bool ComputeWorldTransform(Entity entity);
+
+	/**
+	 * @brief 古くなった全てのワールド変換をまとめて計算し直す
+	 * 姿勢の密な配列を先頭から走査し、ジョブシステムがあれば範囲に分けて並列に処理する。
+	 *
+	 * @param jobSystem ジョブシステム(nullptr なら呼び出したスレッドで処理する)
+	 */
+	void UpdateWorldTransforms(class JobSystem* jobSystem);
+
+private:
+	static std::uint32_t SlotOf(Entity entity) { return entity & mSlotMask; }
+	std::uint32_t DenseOf(Entity entity) const { return mSlotToDense[SlotOf(entity)]; }
+	Entity MakeEntity(std::uint32_t slot) const { return (mGenerations[slot] << mSlotBits) | slot; }
+
+	// 密な配列の [first, last) のワールド変換を計算し直す
+	void UpdateWorldTransforms(std::uint32_t first, std::uint32_t last);
+
+	// エンティティのハンドルのうちスロット番号に使うビット数(残りのビットは世代番号)
+	static const inline int mSlotBits{20};
+	static const inline std::uint32_t mSlotMask{(1u << mSlotBits) - 1};
+	static const inline std::uint32_t mGenerationMask{(1u << (31 - mSlotBits)) - 1};
+	// ハンドルで表せるエンティティの数の上限
+	static const inline std::size_t mMaxEntities{std::size_t(1) << mSlotBits};
+	// 並列処理で1つのジョブが受け持つエンティティの数
+	static const inline int mEntitiesPerJob{4096};
+
+	// 作成できるエンティティの数(姿勢の配列はこの数だけ確保してある)
+	std::size_t mCapacity = 0;
+
+	// 姿勢(SoA。エンティティの数だけ密に並ぶ)
+	std::vector<glm::vec3> mPositions;
+	std::vector<glm::quat> mRotations;
+	std::vector<glm::vec3> mScales;
+	std::vector<glm::mat4> mWorldTransforms;
+	// ワールド変換を計算し直す必要があるかどうか(並列に書き込めるように1要素1バイトにする)
+	std::vector<std::uint8_t> mDirty;
+	// 密な配列のインデックス -> スロット番号
+	std::vector<std::uint32_t> mDenseToSlot;
+
+	// スロット番号 -> 密な配列のインデックス
+	std::vector<std::uint32_t> mSlotToDense;
+	// スロットの世代番号
+	std::vector<std::uint32_t> mGenerations;
+	// 削除されたエンティティのスロット番号
+	std::vector<std::uint32_t> mFreeSlots;
+	// エンティティの作成を排他する
+	std::mutex mMutex;
+};
\ No newline at end of file
@@ -51,10 +51,14 @@ InputSystem::InputSystem(Core& core)
 {
 }
 
-bool InputSystem::Initialize()
+bool InputSystem::Initialize(bool scripted)
 {
+	mIsScripted = scripted;
+
 	// キーボード
-	mState.keyboard.mCurrState = SDL_GetKeyboardState(NULL);
+	// スクリプトで入力を与える場合は、SDL のキーボードの状態の代わりに自前の配列を読ませる
+	memset(mScriptedKeys, 0, SDL_NUM_SCANCODES);
+	mState.keyboard.mCurrState = mIsScripted ? mScriptedKeys : SDL_GetKeyboardState(NULL);
 	// 前フレームの状態格納用の配列の初期化
 	memset(mState.keyboard.mPrevState, 0, SDL_NUM_SCANCODES);
 
@@ -62,6 +66,9 @@ bool InputSystem::Initialize()
 	// 押下状態を表す変数を初期化しておく
 	mState.mouse.mCurrButtons = 0;
 	mState.mouse.mPrevButtons = 0;
+	mState.mouse.mMousePos = glm::vec2(0.0f);
+	mState.mouse.mScrollWheel = glm::vec2(0.0f);
+	mState.mouse.mIsRelative = false;
 
 	return true;
 }
@@ -80,6 +87,8 @@ void InputSystem::PrepareForUpdate()
 
 void InputSystem::Update()
 {
+	if (mIsScripted) { return; }
+
 	// マウス入力処理
 	int x = 0;
 	int y = 0;
@@ -120,7 +129,16 @@ void InputSystem::ProcessEvent(union SDL_Event& event)
 
 void InputSystem::SetRelativeMouseMode(bool value)
 {
-	SDL_bool set = value ? SDL_TRUE : SDL_FALSE;
-	SDL_SetRelativeMouseMode(set);
+	if (!mIsScripted)
+	{
+		SDL_bool set = value ? SDL_TRUE : SDL_FALSE;
+		SDL_SetRelativeMouseMode(set);
+	}
 	mState.mouse.mIsRelative = value;
+}
+
+void InputSystem::SetKeyValue(SDL_Scancode keyCode, bool value)
+{
+	if (!mIsScripted) { return; }
+	mScriptedKeys[keyCode] = value ? 1 : 0;
 }
\ No newline at end of file
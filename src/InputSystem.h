@@ -69,7 +69,14 @@ class InputSystem
 {
 public:
 	InputSystem(class Core& core);
-	bool Initialize();
+	/**
+	 * @brief 入力システムを初期化する
+	 *
+	 * @param scripted true なら SDL から入力を読まず、SetKeyValue で設定したキーの状態を使う
+	 * (ウィンドウのないヘッドレスでの実行用。マウスは動かず、ボタンも押されない)
+	 * @return bool 初期化できたかどうか
+	 */
+	bool Initialize(bool scripted = false);
 	void Shutdown();
 
 	// イベントのポーリング前に呼ばれる
@@ -81,7 +88,22 @@ public:
 
 	void SetRelativeMouseMode(bool value);
 
+	/**
+	 * @brief スクリプトでキーの状態を設定する(Initialize で scripted を指定した場合だけ使える)
+	 * 次の PrepareForUpdate から Update までの間に呼ぶと、そのフレームの入力になる。
+	 *
+	 * @param keyCode キー
+	 * @param value 押されているかどうか
+	 */
+	void SetKeyValue(SDL_Scancode keyCode, bool value);
+	bool IsScripted() const { return mIsScripted; }
+
 private:
 	InputState mState;
 	class Core& mCore;
+
+	// スクリプトで入力を与えるかどうか
+	bool mIsScripted = false;
+	// スクリプトで設定したキーの状態(mState.keyboard.mCurrState が指す)
+	Uint8 mScriptedKeys[SDL_NUM_SCANCODES];
 };
\ No newline at end of file
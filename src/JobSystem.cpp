@@ -0,0 +1,213 @@
+#include "JobSystem.h"
+
+#include <algorithm>
+
+namespace
+{
+// ジョブシステムごとの番号(0は使わない)
+std::atomic<unsigned> sNextInstanceId{1};
+
+// このスレッドのキューを割り当てたジョブシステムの番号と、キューのインデックス
+thread_local unsigned tQueueOwner = 0;
+thread_local int tQueueIndex = 0;
+
+// このスレッドで実行中のジョブの入れ子の深さ
+thread_local int tJobDepth = 0;
+};	// namespace
+
+JobSystem::JobSystem(int numWorkers)
+  : mInstanceId(sNextInstanceId.fetch_add(1, std::memory_order_relaxed))
+{
+	if (numWorkers <= 0)
+	{
+		numWorkers = std::max((int)std::thread::hardware_concurrency() - 1, 1);
+	}
+
+	mQueues.resize(mMaxExternalThreads + numWorkers);
+	for (auto& queue : mQueues)
+	{
+		queue = std::make_unique<Queue>();
+	}
+
+	mWorkers.reserve(numWorkers);
+	for (int i = 0; i < numWorkers; i++)
+	{
+		mWorkers.emplace_back(&JobSystem::WorkerMain, this, mMaxExternalThreads + i);
+	}
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(mWakeMutex);
+		mIsRunning.store(false, std::memory_order_release);
+	}
+	mWakeCondition.notify_all();
+
+	for (auto& worker : mWorkers)
+	{
+		worker.join();
+	}
+}
+
+void JobSystem::Schedule(std::function<void()> function, JobCounter* counter, JobCounter* dependency)
+{
+	if (counter) { counter->mValue.fetch_add(1, std::memory_order_relaxed); }
+
+	Job job{std::move(function), counter};
+
+	if (dependency)
+	{
+		// 依存するカウンタが0になっていなければ、0になったときに登録されるようにする
+		// カウンタはロックを取ったまま減らされるので、ここで0でなければ必ず後で登録される
+		std::lock_guard<std::mutex> lock(dependency->mMutex);
+		if (!dependency->IsDone())
+		{
+			dependency->mContinuations.push_back(std::move(job));
+			return;
+		}
+	}
+
+	Push(std::move(job));
+}
+
+void JobSystem::Wait(JobCounter& counter)
+{
+	int queueIndex = GetQueueIndex();
+	while (!counter.IsDone())
+	{
+		if (!TryExecuteOne(queueIndex))
+		{
+			// 他のスレッドが実行中のジョブの完了を待つ
+			std::this_thread::yield();
+		}
+	}
+
+	// カウンタを0にしたスレッドがロックを手放すまで待ってから戻る
+	std::lock_guard<std::mutex> lock(counter.mMutex);
+}
+
+void JobSystem::WorkerMain(int index)
+{
+	tQueueOwner = mInstanceId;
+	tQueueIndex = index;
+
+	while (true)
+	{
+		if (TryExecuteOne(index)) { continue; }
+
+		std::unique_lock<std::mutex> lock(mWakeMutex);
+		mWakeCondition.wait(lock, [this]() {
+			return mNumQueuedJobs.load(std::memory_order_acquire) > 0 || !mIsRunning.load(std::memory_order_acquire);
+		});
+		if (!mIsRunning.load(std::memory_order_acquire)) { break; }
+	}
+}
+
+void JobSystem::Push(Job job)
+{
+	Queue& queue = *mQueues[GetQueueIndex()];
+	{
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.jobs.PushBack(std::move(job));
+	}
+
+	// 眠っているワーカーを起こす(ロックを経由して、起きる条件の確認との行き違いを防ぐ)
+	mNumQueuedJobs.fetch_add(1, std::memory_order_release);
+	{
+		std::lock_guard<std::mutex> lock(mWakeMutex);
+	}
+	mWakeCondition.notify_one();
+}
+
+bool JobSystem::TryExecuteOne(int queueIndex)
+{
+	Job job;
+	if (!Pop(queueIndex, job)) { return false; }
+
+	Execute(job);
+	return true;
+}
+
+bool JobSystem::Pop(int queueIndex, Job& job)
+{
+	if (mNumQueuedJobs.load(std::memory_order_acquire) == 0) { return false; }
+
+	// 自分のキューの末尾から取り出す(最後に積んだジョブの方がキャッシュに残っている)
+	{
+		Queue& queue = *mQueues[queueIndex];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (queue.jobs.PopBack(job))
+		{
+			mNumQueuedJobs.fetch_sub(1, std::memory_order_relaxed);
+			return true;
+		}
+	}
+
+	// 他のキューの先頭から盗む
+	int numQueues = mQueues.size();
+	for (int i = 1; i < numQueues; i++)
+	{
+		Queue& queue = *mQueues[(queueIndex + i) % numQueues];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (queue.jobs.PopFront(job))
+		{
+			mNumQueuedJobs.fetch_sub(1, std::memory_order_relaxed);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool JobSystem::IsInJob()
+{
+	return tJobDepth > 0;
+}
+
+JobSystem::JobScope::JobScope()
+{
+	tJobDepth++;
+}
+
+JobSystem::JobScope::~JobScope()
+{
+	tJobDepth--;
+}
+
+void JobSystem::Execute(Job& job)
+{
+	{
+		JobScope scope;
+		job.function();
+	}
+
+	JobCounter* counter = job.counter;
+	if (!counter) { return; }
+
+	// ロックを取ったまま減らすので、Wait から戻った側がカウンタを破棄しても、ここではもう触らない
+	std::vector<Job> continuations;
+	{
+		std::lock_guard<std::mutex> lock(counter->mMutex);
+		if (counter->mValue.fetch_sub(1, std::memory_order_acq_rel) != 1) { return; }
+
+		// 0になったので、このカウンタを待っていた継続ジョブを登録する
+		continuations.swap(counter->mContinuations);
+	}
+	for (auto& continuation : continuations)
+	{
+		Push(std::move(continuation));
+	}
+}
+
+int JobSystem::GetQueueIndex()
+{
+	if (tQueueOwner != mInstanceId)
+	{
+		// ワーカー以外のスレッドには、先頭から順に専用のキューを割り当てる
+		int index = mNextExternalQueue.fetch_add(1, std::memory_order_relaxed);
+		tQueueOwner = mInstanceId;
+		tQueueIndex = std::min(index, mMaxExternalThreads - 1);
+	}
+	return tQueueIndex;
+}
\ No newline at end of file
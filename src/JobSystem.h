@@ -0,0 +1,187 @@
+#pragma once
+
+#include "RingDeque.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// ジョブ(関数と、終わったときに減らすカウンタ)
+struct Job
+{
+	std::function<void()> function;
+	class JobCounter* counter = nullptr;
+};
+
+/**
+ * @brief ジョブの完了を待つためのカウンタ
+ * ジョブを登録するたびに増え、ジョブが終わるたびに減る。0になると全てのジョブが終わったことを表す。
+ * カウンタが0になるのを待ってから実行されるジョブ(継続ジョブ)を登録することもできる。
+ * カウンタを破棄するのは JobSystem::Wait で待ち終えてからにする。
+ *
+ */
+class JobCounter
+{
+public:
+	JobCounter() = default;
+	JobCounter(const JobCounter&) = delete;
+	JobCounter& operator=(const JobCounter&) = delete;
+
+	bool IsDone() const { return mValue.load(std::memory_order_acquire) == 0; }
+
+private:
+	friend class JobSystem;
+
+	std::atomic<int> mValue{0};
+	// 0になったときに登録するジョブ
+	std::mutex mMutex;
+	std::vector<Job> mContinuations;
+};
+
+/**
+ * @brief ワーカースレッドごとに両端キューを持つワークスティーリング方式のジョブシステム
+ * ワーカーは自分のキューの末尾からジョブを取り出し、空になったら他のワーカーのキューの先頭から盗む。
+ * 待機(Wait)中のスレッドもジョブを実行するので、ジョブの中から別のジョブを待ってもデッドロックしない。
+ * SDL や Core には依存しないので、単体でも使える(tests/JobSystemTest.cpp)。
+ *
+ * ワーカー以外のスレッド(メインスレッドやシミュレーションのスレッド)も、最初にジョブを登録したときに
+ * 専用のキューを割り当てられる(mMaxExternalThreads 個まで。超えた分のスレッドは最後のキューを共有する)。
+ * ただし Wait 中のスレッドは他のキューからも盗んで実行するので、あるスレッドが登録したジョブが
+ * 別のスレッド(例えばシミュレーションのスレッドのジョブがメインスレッド)で実行されることはある。
+ * ジョブはどのスレッドで実行されても正しく動くように書く。
+ *
+ */
+class JobSystem
+{
+public:
+	/**
+	 * @param numWorkers ワーカースレッドの数(0以下ならハードウェアのスレッド数-1)
+	 */
+	explicit JobSystem(int numWorkers = 0);
+	~JobSystem();
+
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+
+	/**
+	 * @brief ジョブを登録する
+	 * キューはジョブの数が最大値を超えたときだけ拡張するので、関数オブジェクトが std::function に
+	 * そのまま収まる大きさ(参照と整数2つ程度)ならヒープ確保は起こらない。
+	 * 依存するカウンタがまだ0でない場合は、継続ジョブの配列が足りなくなったときに確保が起こる。
+	 *
+	 * @param function 実行する関数
+	 * @param counter ジョブの登録で増え、完了で減るカウンタ(nullptr でもよい)
+	 * @param dependency このカウンタが0になってからジョブを実行する(nullptr なら依存しない)
+	 */
+	void Schedule(std::function<void()> function, JobCounter* counter = nullptr, JobCounter* dependency = nullptr);
+
+	/**
+	 * @brief カウンタが0になるまで待つ
+	 * 待っている間は、登録されているジョブを実行する。
+	 *
+	 * @param counter 待つカウンタ
+	 */
+	void Wait(JobCounter& counter);
+
+	/**
+	 * @brief [begin, end) の範囲を grainSize ずつに分けて並列に処理し、全て終わるまで待つ
+	 * 呼び出したスレッドも処理に加わる。範囲が grainSize 以下なら呼び出したスレッドだけで処理する。
+	 *
+	 * @param begin 範囲の先頭
+	 * @param end 範囲の末尾(含まない)
+	 * @param grainSize 1つのジョブで処理する要素の数
+	 * @param function 部分範囲 [first, last) を処理する関数
+	 */
+	template <typename Function>
+	void ParallelFor(int begin, int end, int grainSize, const Function& function);
+
+	// 呼び出したスレッドを含めた、ジョブを実行するスレッドの数
+	int GetNumThreads() const { return (int)mWorkers.size() + 1; }
+	int GetNumWorkers() const { return (int)mWorkers.size(); }
+
+	// 呼び出したスレッドがジョブを実行している最中かどうか
+	// Wait の中で他のジョブを実行している場合と、ParallelFor の関数を呼び出したスレッドで直接実行している場合も含む
+	// 共有の状態を変更する関数が、直列の区間から呼ばれていることを確かめるのに使う
+	static bool IsInJob();
+
+private:
+	// 生存している間、このスレッドをジョブの実行中として扱う(入れ子にできる)
+	struct JobScope
+	{
+		JobScope();
+		~JobScope();
+	};
+
+	// ワーカーごとのキュー(他のスレッドから盗まれるので排他制御する)
+	// 両端キューを環状バッファで実装し、ジョブの出し入れでメモリを確保しないようにする
+	struct Queue
+	{
+		std::mutex mutex;
+		RingDeque<Job> jobs{mInitialQueueCapacity};
+	};
+
+	// ワーカースレッドの処理
+	void WorkerMain(int index);
+	// ジョブをキューに積む(依存は解決済み)
+	void Push(Job job);
+	// ジョブを1つ取り出して実行する(なければ false)
+	bool TryExecuteOne(int queueIndex);
+	// 自分のキューの末尾か、他のキューの先頭からジョブを取り出す
+	bool Pop(int queueIndex, Job& job);
+	// ジョブを実行して、カウンタを減らす
+	void Execute(Job& job);
+	// 呼び出したスレッドのキューのインデックス(ワーカー以外のスレッドには初回の呼び出しで割り当てる)
+	int GetQueueIndex();
+
+	// 専用のキューを割り当てる、ワーカー以外のスレッドの数
+	static const inline int mMaxExternalThreads{4};
+	// キューに最初に確保しておくジョブの数(2のべき)
+	static const inline std::size_t mInitialQueueCapacity{256};
+
+	// スレッドごとのキューの割り当てを、どのジョブシステムのものか見分けるための番号
+	const unsigned mInstanceId;
+	std::vector<std::thread> mWorkers;
+	// 先頭の mMaxExternalThreads 個はワーカー以外のスレッドが使い、その後ろにワーカーのキューが並ぶ
+	std::vector<std::unique_ptr<Queue>> mQueues;
+	// 次にワーカー以外のスレッドに割り当てるキュー
+	std::atomic<int> mNextExternalQueue{0};
+
+	// キューに積まれていて、まだ取り出されていないジョブの数
+	std::atomic<int> mNumQueuedJobs{0};
+	std::atomic<bool> mIsRunning{true};
+	// 仕事のないワーカーを眠らせる
+	std::mutex mWakeMutex;
+	std::condition_variable mWakeCondition;
+};
+
+template <typename Function>
+void JobSystem::ParallelFor(int begin, int end, int grainSize, const Function& function)
+{
+	if (grainSize < 1) { grainSize = 1; }
+	if (end - begin <= grainSize || mWorkers.empty())
+	{
+		if (begin < end)
+		{
+			JobScope scope;
+			function(begin, end);
+		}
+		return;
+	}
+
+	// 先頭の部分範囲は呼び出したスレッドで処理し、残りをジョブにする
+	JobCounter counter;
+	for (int first = begin + grainSize; first < end; first += grainSize)
+	{
+		int last = first + grainSize < end ? first + grainSize : end;
+		Schedule([&function, first, last]() { function(first, last); }, &counter);
+	}
+	{
+		JobScope scope;
+		function(begin, begin + grainSize);
+	}
+	Wait(counter);
+}
\ No newline at end of file
@@ -3,9 +3,11 @@
 #include "MeshLoader.h"
 
 #include <SDL.h>
+#include <utility>
 
 Mesh::Mesh()
-  : mVertexArray(nullptr)
+  : mVertexArray(nullptr),
+	mNumVertices(0)
 {
 }
 
@@ -14,7 +16,7 @@ Mesh::~Mesh()
 }
 
 template <typename LoadPolicy>
-bool Mesh::Load(const std::string& path)
+bool Mesh::Load(const std::string& path, bool createVertexArray)
 {
 	// 選択したポリシーのメンバ関数で
 	// 頂点の配列、法線の配列、インデックスの配列を作って戻す
@@ -26,13 +28,31 @@ bool Mesh::Load(const std::string& path)
 		return false;
 	}
 
+	// GL を使わない場合は頂点データをそのまま持っておく
+	mNumVertices = numVertices;
+	mVertices = std::move(vertices);
+	mIndices = std::move(indices);
+
+	return createVertexArray ? CreateVertexArray() : true;
+}
+
+bool Mesh::CreateVertexArray()
+{
+	if (mVertexArray) { return true; }
+	if (mNumVertices == 0) { return false; }
+
 	// VAO を作成
 	mVertexArray = new VertexArray(
-		vertices.data(),
-		numVertices,
-		vertices.size() / numVertices,
-		indices.data(),
-		indices.size());
+		mVertices.data(),
+		mNumVertices,
+		GetVertexSize(),
+		mIndices.data(),
+		mIndices.size());
+
+	// GL にアップロードしたので、CPU 側の頂点データは破棄する
+	mNumVertices = 0;
+	std::vector<float>().swap(mVertices);
+	std::vector<unsigned int>().swap(mIndices);
 
 	return true;
 }
@@ -41,7 +61,11 @@ void Mesh::Unload()
 {
 	delete mVertexArray;
 	mVertexArray = nullptr;
+
+	mNumVertices = 0;
+	mVertices.clear();
+	mIndices.clear();
 }
 
 // 明治的なインスタンス化を行うことでメンバテンプレートをソースファイルに書く
-template bool Mesh::Load<MeshLoader::Obj>(const std::string& path);
\ No newline at end of file
+template bool Mesh::Load<MeshLoader::Obj>(const std::string& path, bool createVertexArray);
\ No newline at end of file
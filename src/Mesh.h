@@ -15,12 +15,38 @@ public:
 	Mesh();
 	~Mesh();
 
+	/**
+	 * @brief メッシュを読み込む
+	 *
+	 * @param path ファイルのパス
+	 * @param createVertexArray false なら VAO を作らずに(GL を使わずに)頂点とインデックスの配列を保持する
+	 * @return bool 読み込めたかどうか
+	 */
 	template <typename LoadPolicy = MeshLoader::Obj>
-	bool Load(const std::string& path);
+	bool Load(const std::string& path, bool createVertexArray = true);
+
+	/**
+	 * @brief VAO を作らずに読み込んだ頂点データから VAO を作成する
+	 * GL のコンテキストを持つスレッドで呼ぶ。作成後は CPU 側の頂点データを破棄する。
+	 *
+	 * @return bool 作成できたかどうか(頂点データがなければ false)
+	 */
+	bool CreateVertexArray();
 
 	void Unload();
+	bool HasVertexArray() const { return mVertexArray != nullptr; }
 	const class VertexArray& GetVertexArray() const { return *mVertexArray; };
 
+	// VAO を作らずに読み込んだ場合の頂点(1頂点あたり GetVertexSize 個の float)とインデックスの配列
+	unsigned int GetNumVertices() const { return mNumVertices; }
+	unsigned int GetVertexSize() const { return mNumVertices ? mVertices.size() / mNumVertices : 0; }
+	const std::vector<float>& GetVertices() const { return mVertices; }
+	const std::vector<unsigned int>& GetIndices() const { return mIndices; }
+
 private:
 	class VertexArray* mVertexArray;
+
+	unsigned int mNumVertices;
+	std::vector<float> mVertices;
+	std::vector<unsigned int> mIndices;
 };
\ No newline at end of file
@@ -23,6 +23,9 @@ public:
 
 	~MeshComponent();
 
+	// Update では何もしない
+	bool CanUpdateInParallel() const override { return true; }
+
 	void Draw(class Shader& shader, bool isDepthRendering = false);
 	void SetMesh(std::weak_ptr<class Mesh> mesh) { mMesh = mesh; }
 	Material& GetMaterial() { return mMaterial; }
@@ -1,128 +1,1464 @@
 #include "PhysicsWorld.h"
 #include "Actor.h"
 #include "RigidBody.h"
+#include "JobSystem.h"
+#include "EntityRegistry.h"
 
-PhysicsWorld::PhysicsWorld() = default;
+#include <SDL.h>
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <utility>
 
-PhysicsWorld::~PhysicsWorld() = default;
+namespace
+{
+// 剛体の並び替えに使うソート用のデータ
+struct RigidbodySortKey
+{
+	SimplePhysics::SpxUInt64 key;	// モートン符号
+	SimplePhysics::SpxUInt32 index;	// 並び替え前のインデックス
+};
+
+// 10bitの整数の各ビットの間に0を2つずつ挟む
+inline SimplePhysics::SpxUInt32 ExpandBits(SimplePhysics::SpxUInt32 v)
+{
+	v = (v * 0x00010001u) & 0xFF0000FFu;
+	v = (v * 0x00000101u) & 0x0F00F00Fu;
+	v = (v * 0x00000011u) & 0xC30C30C3u;
+	v = (v * 0x00000005u) & 0x49249249u;
+	return v;
+}
+
+// [0,1]の範囲に正規化された座標から30bitのモートン符号を求める
+inline SimplePhysics::SpxUInt64 MortonCode(const glm::vec3& p)
+{
+	glm::vec3 q = glm::clamp(p * 1024.0f, glm::vec3(0.0f), glm::vec3(1023.0f));
+	return ExpandBits((SimplePhysics::SpxUInt32)q.x) * 4 +
+		   ExpandBits((SimplePhysics::SpxUInt32)q.y) * 2 +
+		   ExpandBits((SimplePhysics::SpxUInt32)q.z);
+}
+
+// 配列を並び替える(order[i] は新しい位置 i に置く要素の元のインデックス)
+template <typename T>
+void Permute(T* data, const SimplePhysics::SpxUInt32* order, SimplePhysics::SpxUInt32 n, SimplePhysics::SpxAllocator* allocator)
+{
+	T* buff = (T*)allocator->allocate(sizeof(T) * n);
+	for (SimplePhysics::SpxUInt32 i = 0; i < n; i++)
+	{
+		buff[i] = data[order[i]];
+	}
+	for (SimplePhysics::SpxUInt32 i = 0; i < n; i++)
+	{
+		data[i] = buff[i];
+	}
+	allocator->deallocate(buff);
+}
+
+// キューブのメッシュデータ
+
+// 頂点数
+const int box_numVertices = 8;
+// clang-format off
+// 頂点座標()
+const float box_vertices[] = {
+	-0.500000, -0.500000, 0.500000,
+	0.500000, -0.500000, 0.500000,
+	-0.500000, 0.500000, 0.500000,
+	0.500000, 0.500000, 0.500000,
+	-0.500000, 0.500000, -0.500000,
+	0.500000, 0.500000, -0.500000,
+	-0.500000, -0.500000, -0.500000,
+	0.500000, -0.500000, -0.500000};
+
+// 頂点インデックスの数
+const int box_numIndices = 36;
+// 頂点インデックス(反時計回り方向が表になるようにする!)
+// 頂点座標(OpenGLでは、Y up の -Z forward の右手系なので、そこに注意!
+// それを考えて図に書いてみると、確かにインデックスは反時計回りに登録されていることがわかる
+// Blender から出力する時も、Y-up Z-forward にしろ、Y-up -Z-forward にしてもちゃんと
+// インデックスは反時計回りになっている。
+const unsigned short box_indices[] = {
+	0, 1, 2,
+	2, 1, 3,
+	2, 3, 4,
+	4, 3, 5,
+	4, 5, 6,
+	6, 5, 7,
+	6, 7, 0,
+	0, 7, 1,
+	1, 7, 3,
+	3, 7, 5,
+	6, 0, 4,
+	4, 0, 2};
+// clang-format on
+// 凸メッシュの元データの内容のハッシュ(FNV-1a)
+SimplePhysics::SpxUInt64 HashConvexMeshSource(
+	const float* vertices, int numVertices,
+	const unsigned short* indices, int numIndices)
+{
+	SimplePhysics::SpxUInt64 hash = 14695981039346656037ull;
+	auto mix = [&hash](const void* data, size_t size) {
+		const unsigned char* bytes = (const unsigned char*)data;
+		for (size_t i = 0; i < size; i++)
+		{
+			hash = (hash ^ bytes[i]) * 1099511628211ull;
+		}
+	};
+	mix(&numVertices, sizeof(numVertices));
+	mix(&numIndices, sizeof(numIndices));
+	mix(vertices, sizeof(float) * numVertices * 3);
+	mix(indices, sizeof(unsigned short) * numIndices);
+	return hash;
+}
+};	// namespace
+
+PhysicsWorld::PhysicsWorld(const PhysicsWorldSettings& settings)
+  : mMaxRigidBodies(std::min<SimplePhysics::SpxUInt32>(std::max(settings.maxRigidBodies, 1), mSlotMask + 1)),
+	mMaxPairs(std::max(settings.maxPairs, 1)),
+	mContactPool(&mAllocator, 0)
+{
+	ReserveRigidbodies(std::min<SimplePhysics::SpxUInt32>(std::max(settings.initialRigidBodies, 1), mMaxRigidBodies));
+	ReservePairs(std::min<SimplePhysics::SpxUInt32>(std::max(settings.initialPairs, 1), mMaxPairs));
+
+	mBoxMesh = AddConvexMesh(box_vertices, box_numVertices, box_indices, box_numIndices);
+}
+
+PhysicsWorld::~PhysicsWorld()
+{
+	StopThread();
+}
 
 int PhysicsWorld::AddRigidbody(const class RigidBody& rb)
 {
-	int id = mNumRigidBodies;
-	mNumRigidBodies++;
-
-	auto owner = rb.GetOwner();
-	// 各種データを初期化
-	mStates[id].Reset();
-	mStates[id].m_motionType = SimplePhysics::SpxMotionType::SpxMotionTypeActive;
-	mStates[id].m_position = owner.lock()->GetPosition();
-	mStates[id].m_orientation = owner.lock()->GetRotation();
-
-	mRigidbodies[id].Reset();
-	mCollidables[id].Reset();
-
-	SimplePhysics::SpxShape shape;
-	shape.Reset();
-
-	// キューブのメッシュデータ
-
-	// 頂点数
-	const int box_numVertices = 8;
-	// clang-format off
-	// 頂点座標()
-	const float box_vertices[] = {
-		-0.500000, -0.500000, 0.500000,
-		0.500000, -0.500000, 0.500000,
-		-0.500000, 0.500000, 0.500000,
-		0.500000, 0.500000, 0.500000,
-		-0.500000, 0.500000, -0.500000,
-		0.500000, 0.500000, -0.500000,
-		-0.500000, -0.500000, -0.500000,
-		0.500000, -0.500000, -0.500000};
-
-	// 頂点インデックスの数
-	const int box_numIndices = 36;
-	// 頂点インデックス(反時計回り方向が表になるようにする!)
-	// 頂点座標(OpenGLでは、Y up の -Z forward の右手系なので、そこに注意!
-	// それを考えて図に書いてみると、確かにインデックスは反時計回りに登録されていることがわかる
-	// Blender から出力する時も、Y-up Z-forward にしろ、Y-up -Z-forward にしてもちゃんと
-	// インデックスは反時計回りになっている。
-	const unsigned short box_indices[] = {
-		0, 1, 2,
-		2, 1, 3,
-		2, 3, 4,
-		4, 3, 5,
-		4, 5, 6,
-		6, 5, 7,
-		6, 7, 0,
-		0, 7, 1,
-		1, 7, 3,
-		3, 7, 5,
-		6, 0, 4,
-		4, 0, 2};
-	// clang-format on
-
-	// メッシュを作る
+	auto owner = rb.GetOwner().lock();
+
 	// 座標、スケール、回転は Actor のデータをもとにする
-	SimplePhysics::SpxCreateConvexMesh(
-		&shape.m_geometry,
-		box_vertices, box_numVertices,
-		box_indices, box_numIndices,
-		owner.lock()->GetScale());
+	RigidbodyDesc desc;
+	desc.position = owner->GetPosition();
+	desc.rotation = owner->GetRotation();
+	desc.scale = owner->GetScale();
 
-	// 形状を登録
-	mCollidables[id].AddShape(shape);
-	// 剛体の登録の完了
-	mCollidables[id].Finish();
+	int id = -1;
+	AddRigidbodies(&desc, 1, &id);
 
+	// 姿勢はステップの後にまとめてアクターに書き出す
+	if (id >= 0)
+	{
+		mSyncTargetOfSlot[SlotOf(id)] = mSyncTargets.size();
+		mSyncTargets.push_back(SyncTarget{id, owner->GetEntity()});
+	}
 	return id;
 }
 
+int PhysicsWorld::AddRigidbodies(const RigidbodyDesc* descs, int count, int* ids)
+{
+	assert(IsOwnerThread() && "PhysicsWorld: add rigid bodies from the main thread outside of jobs");
+	if (count <= 0) { return 0; }
+
+	// 上限を超える分は登録しない
+	// 剛体の数は使用中のスロットの数で数える(スレッドの実行中はまだ配列に追加されていない剛体もある)
+	SimplePhysics::SpxUInt32 numUsedSlots = mGenerations.size() - mFreeSlots.size();
+	SimplePhysics::SpxUInt32 numAdd = std::min<SimplePhysics::SpxUInt32>(count, mMaxRigidBodies - numUsedSlots);
+	if (numAdd < (SimplePhysics::SpxUInt32)count)
+	{
+		SDL_Log("PhysicsWorld: cannot add %u rigid bodies (limit %u reached).", count - numAdd, mMaxRigidBodies);
+		for (int i = numAdd; i < count; i++) { ids[i] = -1; }
+	}
+
+	for (SimplePhysics::SpxUInt32 i = 0; i < numAdd; i++)
+	{
+		ids[i] = MakeId(AllocateSlot());
+	}
+
+	if (IsThreadRunning())
+	{
+		std::lock_guard<std::mutex> lock(mCommandMutex);
+		for (SimplePhysics::SpxUInt32 i = 0; i < numAdd; i++)
+		{
+			Command command{CommandTypeAdd, ids[i], descs[i]};
+			mCommands.push_back(command);
+		}
+		return numAdd;
+	}
+
+	InsertRigidbodies(descs, ids, numAdd);
+	return numAdd;
+}
+
+SimplePhysics::SpxUInt32 PhysicsWorld::AllocateSlot()
+{
+	// 削除された剛体のスロットがあれば再利用する
+	if (!mFreeSlots.empty())
+	{
+		SimplePhysics::SpxUInt32 slot = mFreeSlots.back();
+		mFreeSlots.pop_back();
+		return slot;
+	}
+
+	// 未使用のスロットがなければ、新しいスロットを使う
+	mGenerations.push_back(0);
+	mSyncTargetOfSlot.push_back(-1);
+	return mGenerations.size() - 1;
+}
+
+void PhysicsWorld::InsertRigidbodies(const RigidbodyDesc* descs, const int* ids, SimplePhysics::SpxUInt32 count)
+{
+	// 配列の拡張は最初に1回だけ行う
+	// スロット番号は使用中のスロットの数の最大値より小さいので、剛体の配列と同じ大きさで足りる
+	ReserveRigidbodies(mNumRigidBodies + count);
+
+	SimplePhysics::SpxUInt32 firstIndex = mNumRigidBodies;
+
+	for (SimplePhysics::SpxUInt32 i = 0; i < count; i++)
+	{
+		const RigidbodyDesc& desc = descs[i];
+		SimplePhysics::SpxUInt32 slot = SlotOf(ids[i]);
+
+		SimplePhysics::SpxUInt32 index = mNumRigidBodies;
+		mNumRigidBodies++;
+
+		mSlotToIndex[slot] = index;
+		mIndexToSlot[index] = slot;
+		mIdOfSlot[slot] = ids[i];
+		mArticulationOfSlot[slot] = -1;
+
+		// 各種データを初期化
+		mStates[index].Reset();
+		mStates[index].m_motionType = desc.motionType;
+		mStates[index].m_position = desc.position;
+		mStates[index].m_orientation = desc.rotation;
+
+		mRigidbodies[index].Reset();
+		mCollidables[index].Reset();
+
+		// 凸メッシュは登録済みのものを共有し、大きさは形状のスケールで表す
+		SimplePhysics::SpxShape shape;
+		shape.Reset();
+		shape.m_geometry = ResolveConvexMesh(desc.convexMesh);
+		shape.m_scale = desc.scale;
+
+		// 形状を登録
+		mCollidables[index].AddShape(shape);
+		// 剛体の登録の完了
+		mCollidables[index].Finish(mConvexMeshes.data());
+		// 次のブロードフェーズまでに位置更新が行われない剛体もあるので、ここで計算しておく
+		SimplePhysics::SpxUpdateBounds(mStates[index], mCollidables[index], mTimeStep, mAabbs[index], mTransforms[index]);
+		mPrevTransforms[index] = mTransforms[index];
+	}
+
+	PlaceActiveRigidbodies(firstIndex);
+}
+
+void PhysicsWorld::PlaceActiveRigidbodies(SimplePhysics::SpxUInt32 firstIndex)
+{
+	using namespace SimplePhysics;
+
+	SpxUInt32 first = mNumActiveRigidBodies;
+	SpxUInt32 numActive = first;
+	for (SpxUInt32 i = firstIndex; i < mNumRigidBodies; i++)
+	{
+		if (mStates[i].m_motionType == SpxMotionTypeActive) { numActive++; }
+	}
+
+	// 動く剛体の範囲を [first, numActive) まで広げる
+	// 広げた範囲にある動かない剛体を、その後ろにある追加した動く剛体と1対1で入れ替える
+	// 既存の剛体は [first, firstIndex) の動かない剛体だけが高々1回移動するので、
+	// 移動先を覚えておき、ペアなどのインデックスは最後にまとめて1回の走査で付け替える
+	SpxUInt32 numMoved = std::min(numActive, firstIndex) - first;
+	SpxFrameAllocatorScope scope(mFrameAllocator);
+	SpxUInt32* movedTo = (SpxUInt32*)mFrameAllocator.allocate(sizeof(SpxUInt32) * std::max<SpxUInt32>(numMoved, 1));
+
+	SpxUInt32 right = numActive;
+	for (SpxUInt32 left = first; left < numActive; left++)
+	{
+		if (mStates[left].m_motionType == SpxMotionTypeActive) { continue; }
+
+		while (mStates[right].m_motionType != SpxMotionTypeActive) { right++; }
+		SwapRigidbodyData(left, right);
+		if (left < firstIndex) { movedTo[left - first] = right; }
+		right++;
+	}
+	mNumActiveRigidBodies = numActive;
+
+	if (numMoved == 0) { return; }
+
+	// 追加した剛体はまだどこからも参照されていないので、移動した既存の剛体の参照だけを付け替える
+	auto remap = [first, numMoved, movedTo](SpxUInt32 index) {
+		return index - first < numMoved ? movedTo[index - first] : index;
+	};
+
+	SpxPair* pairs = mPairs[mPairSwap].data();
+	for (SpxUInt32 i = 0; i < mNumPairs[mPairSwap]; i++)
+	{
+		SpxUInt32 a = remap(pairs[i].rigidBodyA);
+		SpxUInt32 b = remap(pairs[i].rigidBodyB);
+		if (a == pairs[i].rigidBodyA && b == pairs[i].rigidBodyB) { continue; }
+
+		// rigidBodyA < rigidBodyB を保つ
+		if (a > b)
+		{
+			std::swap(a, b);
+			mContactPool[pairs[i].contact].Flip();
+		}
+		pairs[i].rigidBodyA = a;
+		pairs[i].rigidBodyB = b;
+		mPairsNeedSort = true;
+	}
+
+	for (SpxUInt32 i = 0; i < mNumJoints; i++)
+	{
+		mJoints[i].rigidBodyA = remap(mJoints[i].rigidBodyA);
+		mJoints[i].rigidBodyB = remap(mJoints[i].rigidBodyB);
+	}
+
+	for (SpxUInt32 i = 0; i < mNumArticulations; i++)
+	{
+		for (SpxUInt32 j = 0; j < mArticulations[i].m_numLinks; j++)
+		{
+			SpxArticulationLink& link = mArticulations[i].m_links[j];
+			link.rigidBody = remap(link.rigidBody);
+		}
+	}
+}
+
+int PhysicsWorld::AddConvexMesh(
+	const float* vertices, int numVertices,
+	const unsigned short* indices, int numIndices)
+{
+	assert(IsOwnerThread() && "PhysicsWorld: add convex meshes from the main thread outside of jobs");
+
+	if (!vertices || !indices || numVertices <= 0 || numIndices <= 0)
+	{
+		SDL_Log("PhysicsWorld: cannot create a convex mesh (%d vertices, %d indices).", numVertices, numIndices);
+		return -1;
+	}
+
+	// 同じ内容の元データから作った凸メッシュがあれば、それを共有する
+	SimplePhysics::SpxUInt64 hash = HashConvexMeshSource(vertices, numVertices, indices, numIndices);
+	auto range = mConvexMeshCache.equal_range(hash);
+	for (auto cached = range.first; cached != range.second; ++cached)
+	{
+		const ConvexMeshSource& source = mConvexMeshSources[cached->second];
+		if (source.vertices.size() == (size_t)numVertices * 3 && source.indices.size() == (size_t)numIndices &&
+			std::memcmp(source.vertices.data(), vertices, sizeof(float) * numVertices * 3) == 0 &&
+			std::memcmp(source.indices.data(), indices, sizeof(unsigned short) * numIndices) == 0)
+		{
+			return cached->second;
+		}
+	}
+
+	SimplePhysics::SpxConvexMesh mesh;
+	if (!SimplePhysics::SpxCreateConvexMesh(&mesh, vertices, numVertices, indices, numIndices))
+	{
+		SDL_Log("PhysicsWorld: cannot create a convex mesh (%d vertices, %d indices).", numVertices, numIndices);
+		return -1;
+	}
+
+	int handle = (int)mConvexMeshes.size();
+	mConvexMeshes.push_back(mesh);
+	mConvexMeshSources.push_back(ConvexMeshSource{
+		std::vector<float>(vertices, vertices + numVertices * 3),
+		std::vector<unsigned short>(indices, indices + numIndices)});
+	mConvexMeshCache.emplace(hash, handle);
+	return handle;
+}
+
+SimplePhysics::SpxUInt32 PhysicsWorld::ResolveConvexMesh(int handle) const
+{
+	if (handle < 0) { return mBoxMesh; }
+
+	if ((SimplePhysics::SpxUInt32)handle >= mConvexMeshes.size())
+	{
+		SDL_Log("PhysicsWorld: unknown convex mesh handle %d; using a box instead.", handle);
+		return mBoxMesh;
+	}
+	return (SimplePhysics::SpxUInt32)handle;
+}
+
+bool PhysicsWorld::IsValidRigidbody(int id) const
+{
+	if (id < 0) { return false; }
+
+	SimplePhysics::SpxUInt32 slot = SlotOf(id);
+	if (slot >= mGenerations.size()) { return false; }
+
+	// 世代番号が一致しなければ、削除済みの剛体のIDである
+	if (MakeId(slot) != id) { return false; }
+
+	// スレッドの実行中は配列を参照できないので、世代番号だけで判定する
+	if (IsThreadRunning()) { return true; }
+
+	SimplePhysics::SpxUInt32 index = mSlotToIndex[slot];
+	return index < mNumRigidBodies && mIndexToSlot[index] == slot;
+}
+
+bool PhysicsWorld::RemoveRigidbody(int id)
+{
+	using namespace SimplePhysics;
+
+	assert(IsOwnerThread() && "PhysicsWorld: remove rigid bodies from the main thread outside of jobs");
+
+	if (!IsValidRigidbody(id)) { return false; }
+
+	SpxUInt32 slot = SlotOf(id);
+
+	// 世代番号を進めて、削除した剛体のIDを無効にする
+	// 命令は順に実行されるので、スロットを再利用する追加の命令は必ずこの削除の後に実行される
+	mGenerations[slot] = (mGenerations[slot] + 1) & mGenerationMask;
+	mFreeSlots.push_back(slot);
+
+	// 姿勢の書き出し先から外す(末尾を空いた位置に移して詰める)
+	int target = mSyncTargetOfSlot[slot];
+	if (target >= 0)
+	{
+		mSyncTargets[target] = mSyncTargets.back();
+		mSyncTargetOfSlot[SlotOf(mSyncTargets[target].id)] = target;
+		mSyncTargets.pop_back();
+		mSyncTargetOfSlot[slot] = -1;
+	}
+
+	if (IsThreadRunning())
+	{
+		Command command{CommandTypeRemove, id};
+		PushCommand(command);
+	}
+	else {
+		RemoveRigidbodyInSlot(slot);
+	}
+
+	return true;
+}
+
+void PhysicsWorld::RemoveRigidbodyInSlot(SimplePhysics::SpxUInt32 slot)
+{
+	using namespace SimplePhysics;
+
+	// 解体するとリンクの運動の種類が変わって並び替えが起こるので、インデックスは後で取り出す
+	if (mArticulationOfSlot[slot] >= 0)
+	{
+		DissolveArticulation(mArticulationOfSlot[slot]);
+	}
+
+	// 動く剛体は、先に動く剛体の範囲の末尾に移してから範囲の外に出す
+	// こうすると、以降で末尾の剛体を空いた位置に移しても範囲が崩れない
+	SpxUInt32 index = mSlotToIndex[slot];
+	if (index < mNumActiveRigidBodies)
+	{
+		mNumActiveRigidBodies--;
+		SwapRigidbodies(index, mNumActiveRigidBodies);
+		index = mNumActiveRigidBodies;
+	}
+
+	// 剛体が関わるジョイントを削除する
+	for (SpxUInt32 i = 0; i < mNumJoints;)
+	{
+		if (mJoints[i].rigidBodyA == index || mJoints[i].rigidBodyB == index)
+		{
+			mJoints[i] = mJoints[--mNumJoints];
+		}
+		else {
+			i++;
+		}
+	}
+
+	// 剛体が関わるペアを削除して衝突情報を解放する
+	// 次のブロードフェーズで前のフレームのペアとして使われるのは mPairs[mPairSwap] の方
+	SpxPair* pairs = mPairs[mPairSwap].data();
+	SpxUInt32 numPairs = 0;
+	for (SpxUInt32 i = 0; i < mNumPairs[mPairSwap]; i++)
+	{
+		if (pairs[i].rigidBodyA == index || pairs[i].rigidBodyB == index)
+		{
+			mContactPool.deallocate(pairs[i].contact);
+			continue;
+		}
+		pairs[numPairs++] = pairs[i];
+	}
+	mNumPairs[mPairSwap] = numPairs;
+
+	// 末尾の剛体を空いた位置に移して配列を詰める
+	// 削除する剛体を参照するものはもう残っていないので、入れ替えて末尾を切り捨てればよい
+	SwapRigidbodies(index, mNumRigidBodies - 1);
+	mNumRigidBodies--;
+}
+
+void PhysicsWorld::SwapRigidbodies(SimplePhysics::SpxUInt32 a, SimplePhysics::SpxUInt32 b)
+{
+	using namespace SimplePhysics;
+
+	if (a == b) { return; }
+
+	SwapRigidbodyData(a, b);
+	// 入れ替える前に a と b にあった剛体のスロット
+	SpxUInt32 slotA = mIndexToSlot[b];
+	SpxUInt32 slotB = mIndexToSlot[a];
+
+	// a と b を参照しているペアのインデックスを付け替える
+	SpxPair* pairs = mPairs[mPairSwap].data();
+	SpxUInt32 numPairs = mNumPairs[mPairSwap];
+	for (SpxUInt32 i = 0; i < numPairs; i++)
+	{
+		SpxUInt32 pairA = pairs[i].rigidBodyA;
+		SpxUInt32 pairB = pairs[i].rigidBodyB;
+		if (pairA != a && pairA != b && pairB != a && pairB != b) { continue; }
+
+		pairA = pairA == a ? b : (pairA == b ? a : pairA);
+		pairB = pairB == a ? b : (pairB == b ? a : pairB);
+		// rigidBodyA < rigidBodyB を保つ
+		if (pairA > pairB)
+		{
+			SpxUInt32 tmp = pairA;
+			pairA = pairB;
+			pairB = tmp;
+			mContactPool[pairs[i].contact].Flip();
+		}
+		pairs[i].rigidBodyA = pairA;
+		pairs[i].rigidBodyB = pairB;
+		// ソートし直すのは次のステップのブロードフェーズの前に1回だけ
+		mPairsNeedSort = true;
+	}
+
+	for (SpxUInt32 i = 0; i < mNumJoints; i++)
+	{
+		SpxUInt32& jointA = mJoints[i].rigidBodyA;
+		SpxUInt32& jointB = mJoints[i].rigidBodyB;
+		jointA = jointA == a ? b : (jointA == b ? a : jointA);
+		jointB = jointB == a ? b : (jointB == b ? a : jointB);
+	}
+
+	// 多関節体のリンクは、入れ替えた剛体が属している多関節体だけを調べればよい
+	SpxInt32 articulations[2] = {mArticulationOfSlot[slotA], mArticulationOfSlot[slotB]};
+	for (int k = 0; k < 2; k++)
+	{
+		if (articulations[k] < 0 || (k == 1 && articulations[1] == articulations[0])) { continue; }
+
+		SpxArticulation& articulation = mArticulations[articulations[k]];
+		for (SpxUInt32 i = 0; i < articulation.m_numLinks; i++)
+		{
+			SpxUInt32& rigidBody = articulation.m_links[i].rigidBody;
+			rigidBody = rigidBody == a ? b : (rigidBody == b ? a : rigidBody);
+		}
+	}
+}
+
+void PhysicsWorld::SwapRigidbodyData(SimplePhysics::SpxUInt32 a, SimplePhysics::SpxUInt32 b)
+{
+	std::swap(mStates[a], mStates[b]);
+	std::swap(mRigidbodies[a], mRigidbodies[b]);
+	std::swap(mCollidables[a], mCollidables[b]);
+	std::swap(mAabbs[a], mAabbs[b]);
+	std::swap(mTransforms[a], mTransforms[b]);
+	std::swap(mPrevTransforms[a], mPrevTransforms[b]);
+
+	SimplePhysics::SpxUInt32 slotA = mIndexToSlot[a];
+	SimplePhysics::SpxUInt32 slotB = mIndexToSlot[b];
+	mIndexToSlot[a] = slotB;
+	mIndexToSlot[b] = slotA;
+	mSlotToIndex[slotA] = b;
+	mSlotToIndex[slotB] = a;
+}
+
+SimplePhysics::SpxUInt32 PhysicsWorld::ChangeMotionType(SimplePhysics::SpxUInt32 index, SimplePhysics::SpxMotionType type)
+{
+	using namespace SimplePhysics;
+
+	SpxState& state = mStates[index];
+	state.m_motionType = type;
+
+	bool wasActive = index < mNumActiveRigidBodies;
+	bool isActive = type == SpxMotionTypeActive;
+
+	if (type == SpxMotionTypeStatic)
+	{
+		// 固定された剛体は位置更新されないので、残った速度が衝突の計算に使われないようにする
+		state.m_linearVelocity = glm::vec3(0.0f);
+		state.m_angularVelocity = glm::vec3(0.0f);
+	}
+
+	if (wasActive && !isActive)
+	{
+		// 動く剛体の範囲の末尾と入れ替えて範囲を縮める
+		mNumActiveRigidBodies--;
+		SwapRigidbodies(index, mNumActiveRigidBodies);
+		return mNumActiveRigidBodies;
+	}
+	if (!wasActive && isActive)
+	{
+		// 動く剛体の範囲の直後と入れ替えて範囲を広げる
+		SwapRigidbodies(index, mNumActiveRigidBodies);
+		mNumActiveRigidBodies++;
+		return mNumActiveRigidBodies - 1;
+	}
+	return index;
+}
+
+int PhysicsWorld::Update(float deltaTime)
+{
+	if (IsThreadRunning())
+	{
+		AcquireSnapshot();
+
+		// 最新のスナップショットが公開されてからの経過時間で補間する
+		const Snapshot& snapshot = mSnapshots[mSnapshotRead];
+		double now = SDL_GetPerformanceCounter() / (double)SDL_GetPerformanceFrequency();
+		mInterpolationAlpha = glm::clamp((float)((now - snapshot.time) / mTimeStep), 0.0f, 1.0f);
+		return 0;
+	}
+
+	mAccumulator += deltaTime;
+
+	int numSteps = 0;
+	while (mAccumulator >= mTimeStep && numSteps < mMaxStepsPerUpdate)
+	{
+		Simulate();
+		mAccumulator -= mTimeStep;
+		numSteps++;
+	}
+
+	// 追いつけなかった分は捨てて、遅れが次のフレーム以降に持ち越されないようにする
+	if (mAccumulator >= mTimeStep)
+	{
+		mAccumulator = std::fmod(mAccumulator, mTimeStep);
+	}
+
+	// スレッドを使わない場合も、同じスナップショットを通して姿勢を読む
+	if (numSteps > 0)
+	{
+		PublishSnapshot(0.0);
+		AcquireSnapshot();
+	}
+
+	mInterpolationAlpha = mAccumulator / mTimeStep;
+	return numSteps;
+}
+
+bool PhysicsWorld::GetInterpolatedTransform(int id, SimplePhysics::SpxTransform& transform) const
+{
+	const Snapshot& snapshot = mSnapshots[mSnapshotRead];
+	SimplePhysics::SpxUInt32 slot = SlotOf(id);
+	if (slot >= snapshot.ids.size() || snapshot.ids[slot] != id) { return false; }
+
+	const SimplePhysics::SpxTransform& prev = snapshot.prevTransforms[slot];
+	const SimplePhysics::SpxTransform& curr = snapshot.transforms[slot];
+	transform.m_position = glm::mix(prev.m_position, curr.m_position, mInterpolationAlpha);
+	transform.m_orientation = glm::slerp(prev.m_orientation, curr.m_orientation, mInterpolationAlpha);
+	return true;
+}
+
+void PhysicsWorld::SyncActorTransforms(EntityRegistry& entities)
+{
+	const SyncTarget* targets = mSyncTargets.data();
+	auto sync = [this, targets, &entities](int first, int last) {
+		for (int i = first; i < last; i++)
+		{
+			SimplePhysics::SpxTransform transform;
+			if (!GetInterpolatedTransform(targets[i].id, transform)) { continue; }
+
+			// アクターを経由せずにエンティティの姿勢の配列に直接書き込み、ワールド変換もその場で作る
+			entities.SetPose(targets[i].entity, transform.m_position, transform.m_orientation);
+		}
+	};
+
+	if (mJobSystem)
+	{
+		mJobSystem->ParallelFor(0, (int)mSyncTargets.size(), mActorsPerJob, sync);
+	}
+	else if (!mSyncTargets.empty()) {
+		sync(0, (int)mSyncTargets.size());
+	}
+}
+
 void PhysicsWorld::Simulate()
 {
+	const Uint64 startCounter = SDL_GetPerformanceCounter();
+
+	// 前のステップの作業領域をまとめて解放する
+	mFrameAllocator.reset();
+
+	// 前のステップまでの処理時間で決めた品質を使う
+	ApplyBudgetQuality();
+
+	// 補間のために、1つ前のステップの姿勢を残しておく
+	std::copy(mTransforms.begin(), mTransforms.begin() + mNumRigidBodies, mPrevTransforms.begin());
+
+	// 剛体の並び替え
+	if (mReorderInterval > 0 && mFrame % mReorderInterval == 0)
+	{
+		ReorderRigidbodies();
+	}
+
+	// 剛体の追加、削除、並び替えでインデックスを付け替えたペアをソートし直す
+	// ブロードフェーズは前フレームのペアがキーでソートされていることを前提にしている
+	if (mPairsNeedSort)
+	{
+		SimplePhysics::SpxPair* pairSortBuff = (SimplePhysics::SpxPair*)mFrameAllocator.allocate(sizeof(SimplePhysics::SpxPair) * mNumPairs[mPairSwap]);
+		SimplePhysics::SpxSort<SimplePhysics::SpxPair>(mPairs[mPairSwap].data(), pairSortBuff, mNumPairs[mPairSwap]);
+		mFrameAllocator.deallocate(pairSortBuff);
+		mPairsNeedSort = false;
+	}
+
 	// バッファをスワップ
 	mPairSwap = 1 - mPairSwap;
 
 	// 外力の適用
-	for (SimplePhysics::SpxUInt32 i = 0; i < mNumRigidBodies; i++)
+	// サブステップを行う場合はサブステップごとに適用する
+	if (mSolverType == SimplePhysics::SpxSolverTypePGS)
 	{
-		glm::vec3 externalForce = mGravity * mRigidbodies[i].m_mass;
-		glm::vec3 externalTorque(0.0f);
-		SimplePhysics::SpxApplyExternalForce(mStates[i], mRigidbodies[i], externalForce, externalTorque, mTimeStep);
+		ApplyExternalForces(mTimeStep);
+		ApplyArticulationForces(mTimeStep);
 	}
 
 	// ブロードフェーズ
-	SimplePhysics::SpxBroadPhase(
-		mStates, mCollidables, mNumRigidBodies,
-		mPairs[1 - mPairSwap], mNumPairs[1 - mPairSwap],
-		mPairs[mPairSwap], mNumPairs[mPairSwap],
-		mMaxPairs, &mAllocator, nullptr, nullptr);
+	DetectPairs();
 
 	// 衝突判定
-	SimplePhysics::SpxDetectCollision(
-		mStates, mCollidables, mNumRigidBodies,
-		mPairs[mPairSwap], mNumPairs[mPairSwap]);
-
-	// 拘束演算
-	SimplePhysics::SpxSolveConstraints(
-		mStates, mRigidbodies, mNumRigidBodies,
-		mPairs[mPairSwap], mNumPairs[mPairSwap],
-		mJoints, mNumJoints,
-		mIteration, mContactBias, mContactSlop, mTimeStep, &mAllocator);
+	DetectCollision();
+
+	if (mSolverType == SimplePhysics::SpxSolverTypePGS)
+	{
+		// 拘束演算
+		SimplePhysics::SpxSolveConstraints(
+			mStates.data(), mRigidbodies.data(), mNumRigidBodies,
+			mPairs[mPairSwap].data(), mNumPairs[mPairSwap],
+			mContactPool.getContacts(),
+			mJoints, mNumJoints,
+			mActiveIterations, mContactBias, mContactSlop, mTimeStep, &mFrameAllocator,
+			mUseBlockSolver);
 
-	// 位置更新
-	SimplePhysics::SpxIntegrate(mStates, mNumRigidBodies, mTimeStep);
+		// 位置更新(次のステップで使う AABB と描画用の姿勢も書き出す)
+		IntegrateActive(mTimeStep);
+		IntegrateArticulations(mTimeStep);
+	}
+	else {
+		// 拘束演算と位置更新
+		SolveSoftStep();
+	}
+
+	// 生きている衝突情報をペアの順に詰め直して、次のステップでの走査を連続したメモリアクセスにする
+	if (mFrame % mContactCompactInterval == 0)
+	{
+		mContactPool.compact(mPairs[mPairSwap].data(), mNumPairs[mPairSwap], &mFrameAllocator);
+	}
 
 	// フレーム更新
 	mFrame++;
+
+	UpdateBudget((SDL_GetPerformanceCounter() - startCounter) * 1000.0f / (float)SDL_GetPerformanceFrequency());
 }
 
-void PhysicsWorld::SetMotionType(int i, SimplePhysics::SpxMotionType type)
+void PhysicsWorld::SetBudgetSettings(const PhysicsBudgetSettings& settings)
 {
-	mStates[i].m_motionType = type;
+	mBudgetSettings = settings;
+	if (!mBudgetSettings.enabled) { mBudgetQuality = 1.0f; }
 }
 
-void PhysicsWorld::ApplyImpulse(int i, glm::vec3 velocity)
+void PhysicsWorld::ApplyBudgetQuality()
 {
-	mStates[i].m_linearVelocity = velocity;
+	if (!mBudgetSettings.enabled)
+	{
+		mActiveIterations = mIteration;
+		mActiveSubsteps = mNumSubsteps;
+		mContactReuseInterval = 1;
+		return;
+	}
+
+	// 下限と上限(設定したイテレーション数とサブステップ数)の間を品質で補間する
+	int minIterations = std::max(std::min(mBudgetSettings.minIterations, mIteration), 1);
+	int minSubsteps = std::max(std::min(mBudgetSettings.minSubsteps, mNumSubsteps), 1);
+	int maxReuseInterval = std::max(mBudgetSettings.maxContactReuseInterval, 1);
+	mActiveIterations = minIterations + (int)std::lround(mBudgetQuality * (mIteration - minIterations));
+	mActiveSubsteps = minSubsteps + (int)std::lround(mBudgetQuality * (mNumSubsteps - minSubsteps));
+	mContactReuseInterval = 1 + (int)std::lround((1.0f - mBudgetQuality) * (maxReuseInterval - 1));
+}
+
+void PhysicsWorld::UpdateBudget(float milliseconds)
+{
+	PhysicsBudgetTelemetry& telemetry = mBudgetTelemetry;
+	telemetry.simulateMilliseconds = milliseconds;
+	telemetry.averageMilliseconds = telemetry.averageMilliseconds > 0.0f
+										? telemetry.averageMilliseconds + mBudgetSmoothing * (milliseconds - telemetry.averageMilliseconds)
+										: milliseconds;
+	telemetry.quality = mBudgetSettings.enabled ? mBudgetQuality : 1.0f;
+	telemetry.numIterations = mActiveIterations;
+	telemetry.numSubsteps = mActiveSubsteps;
+	telemetry.contactReuseInterval = mContactReuseInterval;
+	telemetry.decision = PhysicsBudgetHold;
+
+	if (!mBudgetSettings.enabled) { return; }
+
+	// 目標時間を超えたら品質を大きく下げ、余裕があるときは少しずつ戻す
+	// 平滑化した時間は遅れて下がるので、このステップが目標時間に収まっていれば下げない
+	// 1ステップだけでも目標時間を大きく超えた場合は、平滑化した時間を待たずに下げる
+	float target = mBudgetSettings.targetMilliseconds;
+	if (milliseconds > target &&
+		(telemetry.averageMilliseconds > target || milliseconds > mBudgetSpikeRatio * target))
+	{
+		if (mBudgetQuality > 0.0f)
+		{
+			mBudgetQuality = std::max(mBudgetQuality - mBudgetDegradeStep, 0.0f);
+			telemetry.decision = PhysicsBudgetDegrade;
+		}
+	}
+	else if (telemetry.averageMilliseconds < mBudgetRestoreRatio * target && mBudgetQuality < 1.0f) {
+		mBudgetQuality = std::min(mBudgetQuality + mBudgetRestoreStep, 1.0f);
+		telemetry.decision = PhysicsBudgetRestore;
+	}
+}
+
+void PhysicsWorld::DetectPairs()
+{
+	// 多関節体がある場合は、同じ多関節体に属する剛体同士のペアを除外する
+	SimplePhysics::SpxBroadPhaseCallback callback = mNumArticulations > 0 ? FilterArticulationPair : nullptr;
+
+	while (!SimplePhysics::SpxBroadPhase(
+		mStates.data(), mAabbs.data(), mNumRigidBodies,
+		mPairs[1 - mPairSwap].data(), mNumPairs[1 - mPairSwap],
+		mPairs[mPairSwap].data(), mNumPairs[mPairSwap],
+		mPairs[mPairSwap].size(), &mFrameAllocator, &mContactPool, this, callback))
+	{
+		// 失敗した場合は mNumPairs に必要なペア数が入っている
+		SimplePhysics::SpxUInt32 required = mNumPairs[mPairSwap];
+		if (ReservePairs(required)) { continue; }
+
+		// 上限を超えた場合は、このステップのペアの更新をあきらめて前のステップのペアを使い続ける
+		SDL_Log("PhysicsWorld: %u overlapping pairs exceed the limit %u; keeping the previous pairs.", required, mMaxPairs);
+		std::copy(
+			mPairs[1 - mPairSwap].begin(), mPairs[1 - mPairSwap].begin() + mNumPairs[1 - mPairSwap],
+			mPairs[mPairSwap].begin());
+		mNumPairs[mPairSwap] = mNumPairs[1 - mPairSwap];
+		for (SimplePhysics::SpxUInt32 i = 0; i < mNumPairs[mPairSwap]; i++)
+		{
+			mPairs[mPairSwap][i].type = SimplePhysics::SpxPairTypeKeep;
+		}
+		break;
+	}
+}
+
+bool PhysicsWorld::ReserveRigidbodies(SimplePhysics::SpxUInt32 numRigidBodies)
+{
+	SimplePhysics::SpxUInt32 capacity = mStates.size();
+	if (numRigidBodies <= capacity) { return true; }
+	if (numRigidBodies > mMaxRigidBodies) { return false; }
+
+	// 倍々に拡張する
+	capacity = std::min(std::max(capacity * 2, numRigidBodies), mMaxRigidBodies);
+	mStates.resize(capacity);
+	mRigidbodies.resize(capacity);
+	mCollidables.resize(capacity);
+	mAabbs.resize(capacity);
+	mTransforms.resize(capacity);
+	mPrevTransforms.resize(capacity);
+	mSlotToIndex.resize(capacity);
+	mIndexToSlot.resize(capacity);
+	mArticulationOfSlot.resize(capacity, -1);
+	mIdOfSlot.resize(capacity, -1);
+	return true;
+}
+
+bool PhysicsWorld::ReservePairs(SimplePhysics::SpxUInt32 numPairs)
+{
+	SimplePhysics::SpxUInt32 capacity = mPairs[0].size();
+	if (numPairs <= capacity) { return true; }
+	if (numPairs > mMaxPairs) { return false; }
+
+	// 倍々に拡張する
+	// 衝突情報はペアごとに1つなので、プールも同じ数だけ確保する
+	capacity = std::min(std::max(capacity * 2, numPairs), mMaxPairs);
+	if (!mContactPool.reserve(capacity)) { return false; }
+	mPairs[0].resize(capacity);
+	mPairs[1].resize(capacity);
+	return true;
+}
+
+template <typename Function>
+void PhysicsWorld::ParallelFor(SimplePhysics::SpxUInt32 count, const Function& function)
+{
+	if (mJobSystem)
+	{
+		mJobSystem->ParallelFor(0, (int)count, mBodiesPerJob, function);
+	}
+	else if (count > 0) {
+		function(0, (int)count);
+	}
+}
+
+void PhysicsWorld::ApplyExternalForces(float timeStep)
+{
+	// 固定された剛体と多関節体のリンクは動く剛体の範囲の外にある
+	// 剛体ごとに独立した計算なので、範囲に分けて並列に処理する
+	ParallelFor(mNumActiveRigidBodies, [this, timeStep](int first, int last) {
+		SimplePhysics::SpxApplyGravity(&mStates[first], last - first, mGravity, timeStep);
+		if (mUseGyroscopicTorque)
+		{
+			SimplePhysics::SpxApplyGyroscopicTorque(&mStates[first], &mRigidbodies[first], last - first, timeStep);
+		}
+	});
+}
+
+void PhysicsWorld::IntegrateActive(float timeStep)
+{
+	ParallelFor(mNumActiveRigidBodies, [this, timeStep](int first, int last) {
+		SimplePhysics::SpxIntegrate(
+			&mStates[first], &mCollidables[first], last - first, timeStep, mTimeStep,
+			&mAabbs[first], &mTransforms[first]);
+	});
+}
+
+void PhysicsWorld::DetectCollision()
+{
+	// ペアごとに自分の衝突情報だけに書き込むので、ペアの範囲に分けて並列に処理する
+	SimplePhysics::SpxPair* pairs = mPairs[mPairSwap].data();
+	auto detect = [this, pairs](int first, int last) {
+		SimplePhysics::SpxDetectCollision(
+			mStates.data(), mCollidables.data(), mConvexMeshes.data(), mNumRigidBodies,
+			pairs + first, last - first,
+			mContactPool.getContacts(), mTimeStep,
+			(SimplePhysics::SpxUInt32)mContactReuseInterval, (SimplePhysics::SpxUInt32)mFrame);
+	};
+
+	if (mJobSystem)
+	{
+		mJobSystem->ParallelFor(0, (int)mNumPairs[mPairSwap], mPairsPerJob, detect);
+	}
+	else if (mNumPairs[mPairSwap] > 0) {
+		detect(0, (int)mNumPairs[mPairSwap]);
+	}
+}
+
+void PhysicsWorld::SolveSoftStep()
+{
+	// 衝突検出は1ステップにつき1回だけ行い、
+	// サブステップごとに衝突点の貫通深度を剛体の位置から計算し直す
+	const float subTimeStep = mTimeStep / mActiveSubsteps;
+
+	SimplePhysics::SpxSoftStepContext context;
+	SimplePhysics::SpxSetupSoftStep(
+		context,
+		mStates.data(), mRigidbodies.data(), mNumRigidBodies,
+		mPairs[mPairSwap].data(), mNumPairs[mPairSwap],
+		mContactPool.getContacts(),
+		mJoints, mNumJoints,
+		mContactHertz, mContactDampingRatio,
+		mJointHertz, mJointDampingRatio,
+		mContactSlop, mMaxBiasVelocity, subTimeStep, &mFrameAllocator);
+
+	for (int i = 0; i < mActiveSubsteps; i++)
+	{
+		ApplyExternalForces(subTimeStep);
+		ApplyArticulationForces(subTimeStep);
+		SimplePhysics::SpxWarmStartSoftStep(context, mStates.data());
+		SimplePhysics::SpxSolveSoftStep(context, mStates.data(), true);
+		if (i < mActiveSubsteps - 1)
+		{
+			ParallelFor(mNumActiveRigidBodies, [this, subTimeStep](int first, int last) {
+				SimplePhysics::SpxIntegrate(&mStates[first], last - first, subTimeStep);
+			});
+		}
+		else {
+			// 最後のサブステップでは、次のステップで使う AABB と描画用の姿勢も書き出す
+			IntegrateActive(subTimeStep);
+		}
+		IntegrateArticulations(subTimeStep);
+		SimplePhysics::SpxSolveSoftStep(context, mStates.data(), false);
+	}
+
+	SimplePhysics::SpxFinishSoftStep(context, mStates.data(), &mFrameAllocator);
+}
+
+void PhysicsWorld::ApplyArticulationForces(float timeStep)
+{
+	// 前回の位置更新の後にリンクの速度に加えられた変化もここで関節空間に取り込まれる
+	for (SimplePhysics::SpxUInt32 i = 0; i < mNumArticulations; i++)
+	{
+		SimplePhysics::SpxArticulationForwardDynamics(mArticulations[i], mStates.data(), mRigidbodies.data(), mGravity, timeStep);
+	}
+}
+
+void PhysicsWorld::IntegrateArticulations(float timeStep)
+{
+	for (SimplePhysics::SpxUInt32 i = 0; i < mNumArticulations; i++)
+	{
+		SimplePhysics::SpxArticulationApplySolverImpulses(mArticulations[i], mStates.data(), mRigidbodies.data());
+		SimplePhysics::SpxArticulationIntegrate(mArticulations[i], mStates.data(), timeStep);
+
+		// リンクは動く剛体の範囲の外にあるので、AABB と描画用の姿勢はここで更新する
+		const SimplePhysics::SpxArticulation& articulation = mArticulations[i];
+		for (SimplePhysics::SpxUInt32 j = 0; j < articulation.m_numLinks; j++)
+		{
+			SimplePhysics::SpxUInt32 rigidBody = articulation.m_links[j].rigidBody;
+			SimplePhysics::SpxUpdateBounds(mStates[rigidBody], mCollidables[rigidBody], mTimeStep, mAabbs[rigidBody], mTransforms[rigidBody]);
+		}
+	}
+}
+
+bool PhysicsWorld::FilterArticulationPair(SimplePhysics::SpxUInt32 i, SimplePhysics::SpxUInt32 j, void* userData)
+{
+	const PhysicsWorld* world = static_cast<const PhysicsWorld*>(userData);
+	SimplePhysics::SpxInt32 articulationA = world->mArticulationOfSlot[world->mIndexToSlot[i]];
+	SimplePhysics::SpxInt32 articulationB = world->mArticulationOfSlot[world->mIndexToSlot[j]];
+	return articulationA < 0 || articulationA != articulationB;
+}
+
+int PhysicsWorld::AddBallJoint(int idA, int idB, const glm::vec3& anchor)
+{
+	assert(IsOwnerThread() && "PhysicsWorld: add joints from the main thread outside of jobs");
+	// 剛体の配列を直接書き換えるので、シミュレーションのスレッドの実行中は作成しない
+	if (IsThreadRunning())
+	{
+		SDL_Log("PhysicsWorld: cannot add a joint while the simulation thread is running.");
+		return -1;
+	}
+	if (mNumJoints >= mMaxJoints) { return -1; }
+	if (!IsValidRigidbody(idA) || !IsValidRigidbody(idB)) { return -1; }
+
+	int jointIndex = mNumJoints;
+	mNumJoints++;
+
+	SimplePhysics::SpxUInt32 indexA = mSlotToIndex[SlotOf(idA)];
+	SimplePhysics::SpxUInt32 indexB = mSlotToIndex[SlotOf(idB)];
+	const SimplePhysics::SpxState& stateA = mStates[indexA];
+	const SimplePhysics::SpxState& stateB = mStates[indexB];
+
+	SimplePhysics::SpxBallJoint& joint = mJoints[jointIndex];
+	joint.Reset();
+	joint.rigidBodyA = indexA;
+	joint.rigidBodyB = indexB;
+	joint.anchorA = glm::inverse(stateA.m_orientation) * (anchor - stateA.m_position);
+	joint.anchorB = glm::inverse(stateB.m_orientation) * (anchor - stateB.m_position);
+
+	return jointIndex;
+}
+
+void PhysicsWorld::DissolveArticulation(SimplePhysics::SpxUInt32 articulation)
+{
+	using namespace SimplePhysics;
+
+	// リンクは最後に計算された速度を持ったまま通常の剛体に戻る
+	const SpxArticulation& target = mArticulations[articulation];
+	for (SpxUInt32 i = 0; i < target.m_numLinks; i++)
+	{
+		// 並び替えでリンクのインデックスが書き換わるので、毎回読み直す
+		SpxUInt32 rigidBody = target.m_links[i].rigidBody;
+		mArticulationOfSlot[mIndexToSlot[rigidBody]] = -1;
+		ChangeMotionType(rigidBody, SpxMotionTypeActive);
+	}
+
+	// 末尾の多関節体を空いた位置に移す
+	SpxUInt32 last = mNumArticulations - 1;
+	if (articulation != last)
+	{
+		mArticulations[articulation] = mArticulations[last];
+		const SpxArticulation& moved = mArticulations[articulation];
+		for (SpxUInt32 i = 0; i < moved.m_numLinks; i++)
+		{
+			mArticulationOfSlot[mIndexToSlot[moved.m_links[i].rigidBody]] = articulation;
+		}
+	}
+	mNumArticulations--;
+}
+
+int PhysicsWorld::CreateArticulation(int rootId)
+{
+	return CreateArticulation(rootId, false, glm::vec3(0.0f));
+}
+
+int PhysicsWorld::CreateArticulation(int rootId, const glm::vec3& baseAnchor)
+{
+	return CreateArticulation(rootId, true, baseAnchor);
+}
+
+int PhysicsWorld::CreateArticulation(int rootId, bool fixedBase, const glm::vec3& baseAnchor)
+{
+	using namespace SimplePhysics;
+
+	assert(IsOwnerThread() && "PhysicsWorld: create articulations from the main thread outside of jobs");
+	if (IsThreadRunning())
+	{
+		SDL_Log("PhysicsWorld: cannot create an articulation while the simulation thread is running.");
+		return -1;
+	}
+	if (mNumArticulations >= mMaxArticulations) { return -1; }
+	if (!IsValidRigidbody(rootId)) { return -1; }
+	if (mArticulationOfSlot[SlotOf(rootId)] >= 0) { return -1; }
+
+	int articulationIndex = mNumArticulations;
+	mNumArticulations++;
+
+	// 位置と速度は多関節体が更新する(動く剛体の範囲から外れるのでインデックスが変わる)
+	SpxUInt32 rootIndex = ChangeMotionType(mSlotToIndex[SlotOf(rootId)], SpxMotionTypeArticulated);
+	SpxState& rootState = mStates[rootIndex];
+
+	SpxArticulation& articulation = mArticulations[articulationIndex];
+	articulation.Reset();
+	articulation.m_fixedBase = fixedBase;
+	articulation.m_baseAnchor = baseAnchor;
+	if (!fixedBase)
+	{
+		articulation.m_rootLinearVelocity = rootState.m_linearVelocity;
+		articulation.m_rootAngularVelocity = rootState.m_angularVelocity;
+	}
+
+	SpxArticulationLink& root = articulation.m_links[0];
+	root.rigidBody = rootIndex;
+	root.parent = -1;
+	root.anchorParent = glm::vec3(0.0f);
+	root.anchorChild = fixedBase ? glm::inverse(rootState.m_orientation) * (baseAnchor - rootState.m_position) : glm::vec3(0.0f);
+	root.jointVelocity = glm::vec3(0.0f);
+	articulation.m_numLinks = 1;
+
+	mArticulationOfSlot[SlotOf(rootId)] = articulationIndex;
+
+	return articulationIndex;
+}
+
+bool PhysicsWorld::AddArticulationLink(int articulation, int parentId, int linkId, const glm::vec3& anchor)
+{
+	using namespace SimplePhysics;
+
+	assert(IsOwnerThread() && "PhysicsWorld: add articulation links from the main thread outside of jobs");
+	if (IsThreadRunning())
+	{
+		SDL_Log("PhysicsWorld: cannot add an articulation link while the simulation thread is running.");
+		return false;
+	}
+	if (articulation < 0 || articulation >= (int)mNumArticulations) { return false; }
+	if (!IsValidRigidbody(parentId) || !IsValidRigidbody(linkId)) { return false; }
+	if (mArticulationOfSlot[SlotOf(parentId)] != articulation) { return false; }
+	if (mArticulationOfSlot[SlotOf(linkId)] >= 0) { return false; }
+
+	SpxArticulation& target = mArticulations[articulation];
+	if (target.m_numLinks >= SPX_ARTICULATION_MAX_LINKS) { return false; }
+
+	// 位置と速度は多関節体が更新する
+	// 動く剛体の範囲から外れてインデックスが変わるので、先に行う
+	SpxUInt32 linkIndex = ChangeMotionType(mSlotToIndex[SlotOf(linkId)], SpxMotionTypeArticulated);
+
+	// 親のリンクを探す
+	SpxUInt32 parentIndex = mSlotToIndex[SlotOf(parentId)];
+	SpxInt32 parentLink = -1;
+	for (SpxUInt32 i = 0; i < target.m_numLinks; i++)
+	{
+		if (target.m_links[i].rigidBody == parentIndex)
+		{
+			parentLink = i;
+			break;
+		}
+	}
+
+	const SpxState& parentState = mStates[parentIndex];
+	SpxState& linkState = mStates[linkIndex];
+
+	SpxArticulationLink& link = target.m_links[target.m_numLinks];
+	link.rigidBody = linkIndex;
+	link.parent = parentLink;
+	link.anchorParent = glm::inverse(parentState.m_orientation) * (anchor - parentState.m_position);
+	link.anchorChild = glm::inverse(linkState.m_orientation) * (anchor - linkState.m_position);
+	link.jointVelocity = glm::vec3(0.0f);
+	target.m_numLinks++;
+
+	mArticulationOfSlot[SlotOf(linkId)] = articulation;
+
+	return true;
+}
+
+void PhysicsWorld::ReorderRigidbodies()
+{
+	using namespace SimplePhysics;
+
+	if (mNumRigidBodies < 2) { return; }
+
+	// 全剛体を囲む範囲
+	glm::vec3 boundsMin(FLT_MAX), boundsMax(-FLT_MAX);
+	for (SpxUInt32 i = 0; i < mNumRigidBodies; i++)
+	{
+		boundsMin = GLMExtension::MinPerElem(boundsMin, mStates[i].m_position);
+		boundsMax = GLMExtension::MaxPerElem(boundsMax, mStates[i].m_position);
+	}
+	glm::vec3 extent = GLMExtension::MaxPerElem(boundsMax - boundsMin, glm::vec3(SPX_EPSILON));
+
+	// 剛体の位置からモートン符号を求めてソートする
+	// 動く剛体の範囲を保つため、動かない剛体は最上位ビットを立てて後ろに回す
+	RigidbodySortKey* keys = (RigidbodySortKey*)mFrameAllocator.allocate(sizeof(RigidbodySortKey) * mNumRigidBodies);
+	RigidbodySortKey* sortBuff = (RigidbodySortKey*)mFrameAllocator.allocate(sizeof(RigidbodySortKey) * mNumRigidBodies);
+	for (SpxUInt32 i = 0; i < mNumRigidBodies; i++)
+	{
+		glm::vec3 p = (mStates[i].m_position - boundsMin) / extent;
+		keys[i].key = MortonCode(p) | (i < mNumActiveRigidBodies ? 0ull : (1ull << 63));
+		keys[i].index = i;
+	}
+	SpxSort<RigidbodySortKey>(keys, sortBuff, mNumRigidBodies);
+	mFrameAllocator.deallocate(sortBuff);
+
+	SpxUInt32* order = (SpxUInt32*)mFrameAllocator.allocate(sizeof(SpxUInt32) * mNumRigidBodies);
+	for (SpxUInt32 i = 0; i < mNumRigidBodies; i++)
+	{
+		order[i] = keys[i].index;
+	}
+	PermuteRigidbodies(order);
+
+	mFrameAllocator.deallocate(order);
+	mFrameAllocator.deallocate(keys);
+}
+
+void PhysicsWorld::PermuteRigidbodies(const SimplePhysics::SpxUInt32* order)
+{
+	using namespace SimplePhysics;
+
+	// 古いインデックス -> 新しいインデックス
+	SpxUInt32* newIndex = (SpxUInt32*)mFrameAllocator.allocate(sizeof(SpxUInt32) * mNumRigidBodies);
+	for (SpxUInt32 i = 0; i < mNumRigidBodies; i++)
+	{
+		newIndex[order[i]] = i;
+	}
+
+	// 剛体のデータを並び替える
+	Permute(mStates.data(), order, mNumRigidBodies, &mFrameAllocator);
+	Permute(mRigidbodies.data(), order, mNumRigidBodies, &mFrameAllocator);
+	Permute(mCollidables.data(), order, mNumRigidBodies, &mFrameAllocator);
+	Permute(mAabbs.data(), order, mNumRigidBodies, &mFrameAllocator);
+	Permute(mTransforms.data(), order, mNumRigidBodies, &mFrameAllocator);
+	Permute(mPrevTransforms.data(), order, mNumRigidBodies, &mFrameAllocator);
+
+	// スロットとインデックスの対応表を更新
+	SpxUInt32* oldIndexToSlot = (SpxUInt32*)mFrameAllocator.allocate(sizeof(SpxUInt32) * mNumRigidBodies);
+	for (SpxUInt32 i = 0; i < mNumRigidBodies; i++)
+	{
+		oldIndexToSlot[i] = mIndexToSlot[i];
+	}
+	for (SpxUInt32 i = 0; i < mNumRigidBodies; i++)
+	{
+		SpxUInt32 slot = oldIndexToSlot[order[i]];
+		mIndexToSlot[i] = slot;
+		mSlotToIndex[slot] = i;
+	}
+	mFrameAllocator.deallocate(oldIndexToSlot);
+
+	// 次のブロードフェーズで前フレームのペアとして使われるペアのインデックスを付け替える
+	SpxPair* pairs = mPairs[mPairSwap].data();
+	SpxUInt32 numPairs = mNumPairs[mPairSwap];
+	for (SpxUInt32 i = 0; i < numPairs; i++)
+	{
+		SpxUInt32 a = newIndex[pairs[i].rigidBodyA];
+		SpxUInt32 b = newIndex[pairs[i].rigidBodyB];
+		// rigidBodyA < rigidBodyB を保つ
+		if (a > b)
+		{
+			SpxUInt32 tmp = a;
+			a = b;
+			b = tmp;
+			mContactPool[pairs[i].contact].Flip();
+		}
+		pairs[i].rigidBodyA = a;
+		pairs[i].rigidBodyB = b;
+	}
+	mPairsNeedSort = numPairs > 0;
+
+	for (SpxUInt32 i = 0; i < mNumJoints; i++)
+	{
+		mJoints[i].rigidBodyA = newIndex[mJoints[i].rigidBodyA];
+		mJoints[i].rigidBodyB = newIndex[mJoints[i].rigidBodyB];
+	}
+
+	for (SpxUInt32 i = 0; i < mNumArticulations; i++)
+	{
+		for (SpxUInt32 j = 0; j < mArticulations[i].m_numLinks; j++)
+		{
+			SpxArticulationLink& link = mArticulations[i].m_links[j];
+			link.rigidBody = newIndex[link.rigidBody];
+		}
+	}
+
+	mFrameAllocator.deallocate(newIndex);
+}
+
+void PhysicsWorld::SetMotionType(int id, SimplePhysics::SpxMotionType type)
+{
+	assert(IsOwnerThread() && "PhysicsWorld: change rigid bodies from the main thread outside of jobs");
+	if (IsThreadRunning())
+	{
+		Command command{CommandTypeSetMotionType, id};
+		command.motionType = type;
+		PushCommand(command);
+		return;
+	}
+
+	// 多関節体のリンクの運動の種類は多関節体が管理する
+	if (mArticulationOfSlot[SlotOf(id)] >= 0) { return; }
+	ChangeMotionType(mSlotToIndex[SlotOf(id)], type);
+}
+
+void PhysicsWorld::ApplyImpulse(int id, glm::vec3 velocity)
+{
+	assert(IsOwnerThread() && "PhysicsWorld: change rigid bodies from the main thread outside of jobs");
+	if (IsThreadRunning())
+	{
+		Command command{CommandTypeApplyImpulse, id};
+		command.velocity = velocity;
+		PushCommand(command);
+		return;
+	}
+
+	mStates[mSlotToIndex[SlotOf(id)]].m_linearVelocity = velocity;
+}
+
+bool PhysicsWorld::IsOwnerThread() const
+{
+	return std::this_thread::get_id() == mOwnerThread && !JobSystem::IsInJob();
+}
+
+void PhysicsWorld::StartThread()
+{
+	if (IsThreadRunning()) { return; }
+
+	mThreadRunning.store(true, std::memory_order_release);
+	mThread = std::thread(&PhysicsWorld::ThreadMain, this);
+}
+
+void PhysicsWorld::StopThread()
+{
+	if (!IsThreadRunning()) { return; }
+
+	mThreadRunning.store(false, std::memory_order_release);
+	mThread.join();
+
+	// スレッドが最後のステップの後に受け取った命令を実行する
+	ExecuteCommands();
+}
+
+void PhysicsWorld::ThreadMain()
+{
+	const double frequency = (double)SDL_GetPerformanceFrequency();
+	Uint64 lastCounter = SDL_GetPerformanceCounter();
+	float accumulator = 0.0f;
+
+	while (mThreadRunning.load(std::memory_order_acquire))
+	{
+		Uint64 counter = SDL_GetPerformanceCounter();
+		accumulator += (float)((counter - lastCounter) / frequency);
+		lastCounter = counter;
+
+		// 追いつけなかった分は捨てる(Update と同じ)
+		accumulator = std::min(accumulator, mTimeStep * mMaxStepsPerUpdate);
+
+		if (accumulator < mTimeStep)
+		{
+			// 次のステップの時刻まで眠る
+			SDL_Delay(std::max<Uint32>((Uint32)((mTimeStep - accumulator) * 1000.0f), 1u));
+			continue;
+		}
+
+		while (accumulator >= mTimeStep)
+		{
+			// 命令はステップの境目で実行する
+			ExecuteCommands();
+			Simulate();
+			accumulator -= mTimeStep;
+		}
+
+		PublishSnapshot(SDL_GetPerformanceCounter() / frequency);
+	}
+}
+
+void PhysicsWorld::PushCommand(const Command& command)
+{
+	std::lock_guard<std::mutex> lock(mCommandMutex);
+	mCommands.push_back(command);
+}
+
+void PhysicsWorld::ExecuteCommands()
+{
+	{
+		std::lock_guard<std::mutex> lock(mCommandMutex);
+		std::swap(mCommands, mExecutingCommands);
+	}
+
+	const Command* commands = mExecutingCommands.data();
+	size_t numCommands = mExecutingCommands.size();
+
+	for (size_t i = 0; i < numCommands;)
+	{
+		const Command& command = commands[i];
+		SimplePhysics::SpxUInt32 slot = SlotOf(command.id);
+
+		switch (command.type)
+		{
+			case CommandTypeAdd:
+			{
+				// 続けて積まれた剛体の追加はまとめて行う
+				size_t end = i;
+				while (end < numCommands && commands[end].type == CommandTypeAdd) { end++; }
+
+				SimplePhysics::SpxUInt32 count = end - i;
+				SimplePhysics::SpxFrameAllocatorScope scope(mFrameAllocator);
+				RigidbodyDesc* descs = (RigidbodyDesc*)mFrameAllocator.allocate(sizeof(RigidbodyDesc) * count);
+				int* ids = (int*)mFrameAllocator.allocate(sizeof(int) * count);
+				for (SimplePhysics::SpxUInt32 j = 0; j < count; j++)
+				{
+					descs[j] = commands[i + j].desc;
+					ids[j] = commands[i + j].id;
+				}
+				InsertRigidbodies(descs, ids, count);
+				mFrameAllocator.deallocate(ids);
+				mFrameAllocator.deallocate(descs);
+
+				i = end;
+				continue;
+			}
+
+			case CommandTypeRemove:
+				RemoveRigidbodyInSlot(slot);
+				break;
+
+			case CommandTypeSetMotionType:
+				// 多関節体のリンクの運動の種類は多関節体が管理する
+				if (mArticulationOfSlot[slot] < 0)
+				{
+					ChangeMotionType(mSlotToIndex[slot], command.motionType);
+				}
+				break;
+
+			case CommandTypeApplyImpulse:
+				mStates[mSlotToIndex[slot]].m_linearVelocity = command.velocity;
+				break;
+		}
+		i++;
+	}
+
+	mExecutingCommands.clear();
+}
+
+void PhysicsWorld::PublishSnapshot(double time)
+{
+	Snapshot& snapshot = mSnapshots[mSnapshotWrite];
+
+	// 剛体の並び替えや削除があっても読み込み側がIDで引けるように、スロット番号の順に書き出す
+	SimplePhysics::SpxUInt32 numSlots = mSlotToIndex.size();
+	if (snapshot.ids.size() < numSlots)
+	{
+		snapshot.prevTransforms.resize(numSlots);
+		snapshot.transforms.resize(numSlots);
+		snapshot.ids.resize(numSlots, -1);
+	}
+
+	for (SimplePhysics::SpxUInt32 i = 0; i < mNumRigidBodies; i++)
+	{
+		SimplePhysics::SpxUInt32 slot = mIndexToSlot[i];
+		snapshot.prevTransforms[slot] = mPrevTransforms[i];
+		snapshot.transforms[slot] = mTransforms[i];
+		snapshot.ids[slot] = mIdOfSlot[slot];
+	}
+	snapshot.time = time;
+	snapshot.telemetry = mBudgetTelemetry;
+
+	// 書き終えたバッファを共有のバッファと交換する
+	mSnapshotWrite = mSnapshotShared.exchange(mSnapshotWrite | mSnapshotFresh, std::memory_order_acq_rel) & mSnapshotIndexMask;
+}
+
+void PhysicsWorld::AcquireSnapshot()
+{
+	// 新しいバッファが公開されていなければ、今読んでいるバッファを使い続ける
+	if (!(mSnapshotShared.load(std::memory_order_relaxed) & mSnapshotFresh)) { return; }
+
+	mSnapshotRead = mSnapshotShared.exchange(mSnapshotRead, std::memory_order_acq_rel) & mSnapshotIndexMask;
 }
\ No newline at end of file
@@ -4,97 +4,656 @@
 #include <glm/glm.hpp>
 #include <vector>
 #include <memory>
+#include <map>
+#include <atomic>
+#include <mutex>
+#include <thread>
 
+// PhysicsWorld が確保する配列の大きさの設定
+// 配列は初期値から始まり、足りなくなるたびに上限まで倍々に拡張される
+struct PhysicsWorldSettings
+{
+	int initialRigidBodies = 64;   // 最初に確保する剛体の数
+	int maxRigidBodies = 100000;   // 剛体の数の上限(IDの都合で 2^20 まで)
+	int initialPairs = 256;		   // 最初に確保するペアの数
+	int maxPairs = 1000000;		   // ペアの数の上限
+};
+
+// 負荷に応じてシミュレーションの品質を下げる(フレーム予算の)設定
+// 品質の上限は SetNumIterations と SetNumSubsteps で設定した値で、負荷が高いと下限に向かって下げる
+struct PhysicsBudgetSettings
+{
+	bool enabled = false;			 // 品質を調整するかどうか
+	float targetMilliseconds = 4.0f;  // 1ステップの Simulate にかける目標時間(ミリ秒)
+	int minIterations = 3;			 // 拘束演算のイテレーション数の下限(SpxSolverTypePGS)
+	int minSubsteps = 1;			 // サブステップ数の下限(SpxSolverTypeSoftStep)
+	int maxContactReuseInterval = 4;  // 継続しているペアの衝突検出を間引く間隔の上限(1ならば間引かない)
+};
+
+// 品質の調整の判断
+enum PhysicsBudgetDecision
+{
+	PhysicsBudgetHold,	   // 品質を維持した
+	PhysicsBudgetDegrade,  // 目標時間を超えたので品質を下げた
+	PhysicsBudgetRestore,  // 目標時間に余裕があるので品質を上げた
+};
+
+// ステップごとの処理時間と、品質の調整の結果
+struct PhysicsBudgetTelemetry
+{
+	float simulateMilliseconds = 0.0f;	// Simulate にかかった時間(ミリ秒)
+	float averageMilliseconds = 0.0f;	// 平滑化した Simulate の時間(ミリ秒)
+	float quality = 1.0f;				// そのステップで使った品質(0が下限、1が上限)
+	int numIterations = 0;				// そのステップで使った拘束演算のイテレーション数
+	int numSubsteps = 0;				// そのステップで使ったサブステップ数
+	int contactReuseInterval = 1;		// そのステップで使った衝突検出を間引く間隔
+	PhysicsBudgetDecision decision = PhysicsBudgetHold;	 // ステップの後に行った判断(次のステップから反映される)
+};
+
+// AddRigidbodies でまとめて登録する剛体の設定
+struct RigidbodyDesc
+{
+	glm::vec3 position{0.0f};					 // 座標
+	glm::quat rotation{1.0f, 0.0f, 0.0f, 0.0f};	 // 回転
+	glm::vec3 scale{1.0f};						 // 形状のスケール
+	int convexMesh = -1;						 // 凸メッシュのハンドル(AddConvexMesh の戻り値。-1 ならキューブ)
+	// 運動の種類
+	SimplePhysics::SpxMotionType motionType = SimplePhysics::SpxMotionTypeActive;
+};
+
+// 剛体の追加、削除、属性の変更は、シミュレーションのスレッドの実行中は命令としてキューに積まれ、
+// ステップの境目でまとめて実行される。剛体のIDは呼び出した時点で割り当てられる。
+// これらの関数と Update は PhysicsWorld を作ったスレッド(メインスレッド)から、ジョブの外で呼ぶ(assert で確かめる)。
+// コンポーネントの並列の更新の中から呼んではいけない。
+// 多関節体やジョイントの作成、設定の変更、剛体のデータの取得はスレッドを止めている間に行う
+// (多関節体とジョイントの作成はスレッドの実行中は失敗する)。
 class PhysicsWorld
 {
 public:
-	PhysicsWorld();
+	explicit PhysicsWorld(const PhysicsWorldSettings& settings = PhysicsWorldSettings());
 	~PhysicsWorld();
 
 	/**
 	 * @brief 剛体を登録する
+	 * 剛体の姿勢は SyncActorTransforms で RigidBody の持ち主のアクターにまとめて書き出される。
 	 *
 	 * @param rb RigiBody コンポーネント
-	 * @return int 剛体のID
+	 * @return int 剛体のID(剛体の数が上限に達していた場合は -1)
 	 */
 	int AddRigidbody(const class RigidBody& rb);
 
+	/**
+	 * @brief 複数の剛体をまとめて登録する
+	 * 配列の拡張は1回だけ行い、凸メッシュは登録済みのものを共有するので、
+	 * シーンの読み込みや大量の剛体の生成を剛体の数に比例する時間で行える。
+	 *
+	 * @param descs 剛体の設定の配列
+	 * @param count 剛体の数
+	 * @param ids 剛体のIDを受け取る配列(count 個。登録できなかった剛体は -1)
+	 * @return int 登録できた剛体の数(剛体の数の上限を超えた分は登録しない)
+	 */
+	int AddRigidbodies(const RigidbodyDesc* descs, int count, int* ids);
+
+	/**
+	 * @brief 凸メッシュを登録する
+	 * 凸メッシュは変更されないデータとして一度だけ作られ、ハンドルを通して複数の剛体の形状から共有される。
+	 * 頂点とインデックスの内容が登録済みのものと一致する場合は、作り直さずに登録済みのハンドルを返す。
+	 * 内容のハッシュで探して要素ごとに比較するので、呼び出し側は配列を使い回したり解放したりしてよい。
+	 * 剛体ごとの大きさの違いは形状のスケール(SpxShape::m_scale)で表す。
+	 *
+	 * @param vertices 頂点座標の配列(xyzの順に並ぶ)
+	 * @param numVertices 頂点数
+	 * @param indices 面を構成する頂点のインデックスの配列(反時計回りが表)
+	 * @param numIndices インデックスの数
+	 * @return int 凸メッシュのハンドル(作成できなかった場合は -1)
+	 */
+	int AddConvexMesh(
+		const float* vertices, int numVertices,
+		const unsigned short* indices, int numIndices);
+
+	/**
+	 * @brief 剛体を削除する
+	 * 配列の末尾の剛体を空いた位置に移して詰める。剛体が関わるペアとジョイントも削除され、
+	 * 多関節体に属していた場合は多関節体を解体する(他のリンクは通常の剛体に戻る)。
+	 * 削除した剛体のIDは無効になり、以後の RemoveRigidbody や IsValidRigidbody で検出できる。
+	 *
+	 * @param id 剛体のID
+	 * @return bool 削除できたかどうか(IDが無効な場合は false)
+	 */
+	bool RemoveRigidbody(int id);
+
+	/**
+	 * @brief 剛体のIDが有効かどうかを調べる
+	 *
+	 * @param id 剛体のID
+	 * @return bool 登録されていて、まだ削除されていなければ true
+	 */
+	bool IsValidRigidbody(int id) const;
+
+	/**
+	 * @brief 2つの剛体をボールジョイントで連結する
+	 * ジョイントは拘束ソルバーで他の拘束と一緒に反復計算される。
+	 *
+	 * @param idA 剛体AのID
+	 * @param idB 剛体BのID
+	 * @param anchor 連結する点(ワールド座標系)
+	 * @return int ジョイントのインデックス(登録できなかった場合と、シミュレーションのスレッドの実行中は -1)
+	 */
+	int AddBallJoint(int idA, int idB, const glm::vec3& anchor);
+
+	/**
+	 * @brief 多関節体(ボールジョイントで連結された剛体の木構造)を作成する
+	 * 関節の拘束は Featherstone の方法で関節空間で解かれるので、長い鎖でも関節がずれない。
+	 * 根元の剛体は自由に動く。
+	 *
+	 * @param rootId 根元になる剛体のID
+	 * @return int 多関節体のインデックス(作成できなかった場合と、シミュレーションのスレッドの実行中は -1)
+	 */
+	int CreateArticulation(int rootId);
+
+	/**
+	 * @brief 根元の剛体をワールドの点に吊るした多関節体を作成する
+	 *
+	 * @param rootId 根元になる剛体のID
+	 * @param baseAnchor 根元の剛体を吊るす点(ワールド座標系)
+	 * @return int 多関節体のインデックス(作成できなかった場合と、シミュレーションのスレッドの実行中は -1)
+	 */
+	int CreateArticulation(int rootId, const glm::vec3& baseAnchor);
+
+	/**
+	 * @brief 多関節体にリンクを追加する
+	 * 同じ多関節体に属する剛体同士の衝突判定は行わない。
+	 *
+	 * @param articulation 多関節体のインデックス
+	 * @param parentId 親になる剛体のID(すでに多関節体に追加されている必要がある)
+	 * @param linkId 追加する剛体のID
+	 * @param anchor 親とつなぐ関節の位置(ワールド座標系)
+	 * @return bool 追加できたかどうか(シミュレーションのスレッドの実行中は false)
+	 */
+	bool AddArticulationLink(int articulation, int parentId, int linkId, const glm::vec3& anchor);
+
 	/**
 	 * @brief 1タイムステップ間における剛体シミュレーションを行う
 	 *
 	 */
 	void Simulate();
 
+	/**
+	 * @brief 経過時間に合わせて、固定タイムステップのシミュレーションを0回以上行う
+	 * 経過時間を蓄積し、タイムステップ分たまるごとに Simulate を呼ぶ。
+	 * 処理が追いつかない場合は SetMaxStepsPerUpdate の回数で打ち切り、残りの時間は捨てる。
+	 * 余った時間は補間係数(GetInterpolationAlpha)として描画側の補間に使う。
+	 * シミュレーションのスレッドの実行中はステップを行わず、最新のスナップショットを取得して補間係数を求める。
+	 *
+	 * @param deltaTime 前回の呼び出しからの経過時間(秒)
+	 * @return int 行ったステップ数
+	 */
+	int Update(float deltaTime);
+
+	/**
+	 * @brief シミュレーションのタイムステップを設定する
+	 *
+	 * @param timeStep タイムステップ(秒)
+	 */
+	void SetTimeStep(float timeStep) { mTimeStep = timeStep > 0.0f ? timeStep : mTimeStep; }
+	float GetTimeStep() const { return mTimeStep; }
+
+	/**
+	 * @brief Update で1回に行うステップ数の上限を設定する
+	 *
+	 * @param maxSteps ステップ数の上限(1以上)
+	 */
+	void SetMaxStepsPerUpdate(int maxSteps) { mMaxStepsPerUpdate = maxSteps < 1 ? 1 : maxSteps; }
+	int GetMaxStepsPerUpdate() const { return mMaxStepsPerUpdate; }
+
+	// 直前の2ステップの間の補間係数(0なら1つ前のステップ、1なら最後のステップの状態)
+	float GetInterpolationAlpha() const { return mInterpolationAlpha; }
+
+	/**
+	 * @brief シミュレーションを専用のスレッドで実行する
+	 * スレッドは固定タイムステップでステップを進め、ステップごとに剛体の姿勢のスナップショットを公開する。
+	 * Update はステップを行わず、最新のスナップショットを取得するだけになる。
+	 *
+	 */
+	void StartThread();
+
+	/**
+	 * @brief シミュレーションのスレッドを止める
+	 * キューに残っている命令は全て実行してから戻る。
+	 *
+	 */
+	void StopThread();
+
+	bool IsThreadRunning() const { return mThreadRunning.load(std::memory_order_relaxed); }
+
+	/**
+	 * @brief ステップの処理を分割して並列に実行するジョブシステムを設定する
+	 * 重力の適用、衝突判定、位置更新を剛体やペアの範囲ごとのジョブに分ける。
+	 *
+	 * @param jobSystem ジョブシステム(nullptr なら全て呼び出したスレッドで処理する)
+	 */
+	void SetJobSystem(class JobSystem* jobSystem) { mJobSystem = jobSystem; }
+
+	/**
+	 * @brief 拘束ソルバーの種類を切り替える
+	 *
+	 * @param type SpxSolverTypePGS か SpxSolverTypeSoftStep
+	 */
+	void SetSolverType(SimplePhysics::SpxSolverType type) { mSolverType = type; }
+	SimplePhysics::SpxSolverType GetSolverType() const { return mSolverType; }
+
+	/**
+	 * @brief SpxSolverTypeSoftStep のときの1ステップあたりのサブステップ数を設定する
+	 *
+	 * @param numSubsteps サブステップ数(1以上)
+	 */
+	void SetNumSubsteps(int numSubsteps) { mNumSubsteps = numSubsteps < 1 ? 1 : numSubsteps; }
+	int GetNumSubsteps() const { return mNumSubsteps; }
+
+	/**
+	 * @brief SpxSolverTypePGS のときの拘束演算のイテレーション数を設定する
+	 *
+	 * @param numIterations イテレーション数(1以上)
+	 */
+	void SetNumIterations(int numIterations) { mIteration = numIterations < 1 ? 1 : numIterations; }
+	int GetNumIterations() const { return mIteration; }
+
+	/**
+	 * @brief 負荷に応じてシミュレーションの品質を調整する設定を行う
+	 * Simulate にかかった時間を計り、目標時間を超えるとイテレーション数、サブステップ数を下限に向かって減らし、
+	 * 継続しているペアの衝突検出を間引く。余裕ができると少しずつ元に戻す。
+	 * 接触は柔らかくなるが、フレームの処理時間が急に伸びるのを抑えられる。
+	 *
+	 * @param settings 設定
+	 */
+	void SetBudgetSettings(const PhysicsBudgetSettings& settings);
+	const PhysicsBudgetSettings& GetBudgetSettings() const { return mBudgetSettings; }
+
+	/**
+	 * @brief 最後に取得したスナップショットのステップの、処理時間と品質の調整の結果を取得する
+	 * シミュレーションのスレッドの実行中でも、Update の後ならばフレームごとに読める。
+	 *
+	 */
+	const PhysicsBudgetTelemetry& GetBudgetTelemetry() const { return mSnapshots[mSnapshotRead].telemetry; }
+
+	/**
+	 * @brief SpxSolverTypePGS のときに、1つのペアの法線方向の拘束をまとめて解くかどうかを設定する
+	 *
+	 * @param enabled true ならブロックソルバーを使う
+	 */
+	void SetBlockSolverEnabled(bool enabled) { mUseBlockSolver = enabled; }
+	bool GetBlockSolverEnabled() const { return mUseBlockSolver; }
+
+	/**
+	 * @brief ジャイロ効果によるトルクを陰的に与えるかどうかを設定する
+	 * 慣性テンソルが等方的でない剛体を速く回転させる場合に、大きなタイムステップでも回転が安定する。
+	 * 剛体ごとに3x3行列の逆行列を求めるので、必要な場合だけ有効にする。
+	 *
+	 * @param enabled true ならジャイロ効果を与える
+	 */
+	void SetGyroscopicTorqueEnabled(bool enabled) { mUseGyroscopicTorque = enabled; }
+	bool GetGyroscopicTorqueEnabled() const { return mUseGyroscopicTorque; }
+
+	/**
+	 * @brief 剛体の並び替えを行う間隔を設定する
+	 * 剛体を空間上の位置(モートン符号)の順に並び替えて、ソルバーや衝突判定のメモリアクセスを局所化する。
+	 * 並び替えても剛体のIDは変わらない。
+	 *
+	 * @param frames 並び替えを行う間隔(フレーム数)。0ならば並び替えを行わない
+	 */
+	void SetReorderInterval(int frames) { mReorderInterval = frames < 0 ? 0 : frames; }
+	int GetReorderInterval() const { return mReorderInterval; }
+
+	/**
+	 * @brief 剛体をモートン符号の順に並び替える
+	 *
+	 */
+	void ReorderRigidbodies();
+
 	///////////////////////////////////////////////////////////////////////////////
 	//
 	// 剛体に関連するデータを取得する関数
 
+	// 引数には有効な剛体のID(AddRigidbody の戻り値)を渡す
+
 	int GetNumRigidbodies() { return mNumRigidBodies; }
-	const SimplePhysics::SpxState& GetState(int i) { return mStates[i]; }
-	const SimplePhysics::SpxRigidBody& GetRigidbody(int i) { return mRigidbodies[i]; }
-	const SimplePhysics::SpxCollidable& GetCollidable(int i) { return mCollidables[i]; }
+	const SimplePhysics::SpxState& GetState(int id) { return mStates[mSlotToIndex[SlotOf(id)]]; }
+	const SimplePhysics::SpxRigidBody& GetRigidbody(int id) { return mRigidbodies[mSlotToIndex[SlotOf(id)]]; }
+	const SimplePhysics::SpxCollidable& GetCollidable(int id) { return mCollidables[mSlotToIndex[SlotOf(id)]]; }
+	// 最後の位置更新で書き出された描画用の姿勢
+	const SimplePhysics::SpxTransform& GetTransform(int id) { return mTransforms[mSlotToIndex[SlotOf(id)]]; }
+	/**
+	 * @brief 最後に取得したスナップショットの、直前の2ステップの描画用の姿勢を補間係数(GetInterpolationAlpha)で補間する
+	 * シミュレーションのスレッドの実行中でも使える。
+	 *
+	 * @param id 剛体のID
+	 * @param transform 補間した姿勢を受け取る
+	 * @return bool スナップショットに剛体が含まれていたかどうか(追加直後でまだステップが行われていなければ false)
+	 */
+	bool GetInterpolatedTransform(int id, SimplePhysics::SpxTransform& transform) const;
+
+	/**
+	 * @brief AddRigidbody で登録した剛体の姿勢を、持ち主のアクターのエンティティにまとめて書き出す
+	 * 最新のスナップショットの姿勢を補間し、エンティティのスケールを掛けたワールド変換を直接組み立てて書き込む。
+	 * 剛体の配列を1回走査するだけで済み、ジョブシステムがあれば並列に処理する。Update の後に1回呼ぶ。
+	 *
+	 */
+	void SyncActorTransforms(class EntityRegistry& entities);
+	// 引数には凸メッシュのハンドル(SpxShape::m_geometry)を渡す
+	const SimplePhysics::SpxConvexMesh& GetConvexMesh(SimplePhysics::SpxUInt32 handle) { return mConvexMeshes[handle]; }
 
 	///////////////////////////////////////////////////////////////////////////////
 	//
 	// 剛体の属性を変更する関数
 
-	void SetMotionType(int i, SimplePhysics::SpxMotionType type);
-	void ApplyImpulse(int i, glm::vec3 velocity);
+	void SetMotionType(int id, SimplePhysics::SpxMotionType type);
+	void ApplyImpulse(int id, glm::vec3 velocity);
 
 	///////////////////////////////////////////////////////////////////////////////
 	//
 	// 衝突情報を取得する関数
 
 	int GetNumContacts() { return mNumPairs[mPairSwap]; }
-	const SimplePhysics::SpxContact& GetContact(int i) { return *mPairs[mPairSwap][i].contact; }
-	SimplePhysics::SpxUInt32 GetRigidbodyAInContact(int i) { return mPairs[mPairSwap][i].rigidBodyA; }
-	SimplePhysics::SpxUInt32 GetRigidbodyBInContact(int i) { return mPairs[mPairSwap][i].rigidBodyB; }
+	const SimplePhysics::SpxContact& GetContact(int i) { return mContactPool[mPairs[mPairSwap][i].contact]; }
+	// 戻り値は剛体のID
+	SimplePhysics::SpxUInt32 GetRigidbodyAInContact(int i) { return mIdOfSlot[mIndexToSlot[mPairs[mPairSwap][i].rigidBodyA]]; }
+	SimplePhysics::SpxUInt32 GetRigidbodyBInContact(int i) { return mIdOfSlot[mIndexToSlot[mPairs[mPairSwap][i].rigidBodyB]]; }
+
+	// 作業領域のアロケータ(ヒープ確保の回数や使用量の確認用)
+	const SimplePhysics::SpxFrameAllocator& GetFrameAllocator() const { return mFrameAllocator; }
+	// 剛体や衝突情報の配列のためにヒープから確保した回数(作業領域のブロックを含む。スレッドを止めている間に確認する)
+	SimplePhysics::SpxUInt32 GetNumAllocations() const { return mAllocator.GetNumAllocations(); }
 
 private:
+	// 剛体の追加、削除、属性の変更の命令
+	enum CommandType
+	{
+		CommandTypeAdd,
+		CommandTypeRemove,
+		CommandTypeSetMotionType,
+		CommandTypeApplyImpulse,
+	};
+
+	struct Command
+	{
+		CommandType type;
+		int id;			   // 剛体のID
+		RigidbodyDesc desc;	 // CommandTypeAdd
+		SimplePhysics::SpxMotionType motionType;  // CommandTypeSetMotionType
+		glm::vec3 velocity;	 // CommandTypeApplyImpulse
+	};
+
+	// 1ステップ分の剛体の描画用の姿勢(配列はスロット番号で引く)
+	struct Snapshot
+	{
+		std::vector<SimplePhysics::SpxTransform> prevTransforms;
+		std::vector<SimplePhysics::SpxTransform> transforms;
+		// スロットを使っていた剛体のID(剛体の追加と削除を見分けるのに使う)
+		std::vector<int> ids;
+		// 公開した時刻(秒)
+		double time = 0.0;
+		// 最後のステップの処理時間と品質の調整の結果
+		PhysicsBudgetTelemetry telemetry;
+	};
+
+	// シミュレーションのスレッドの処理
+	void ThreadMain();
+	// 姿勢を書き出すアクター
+	struct SyncTarget
+	{
+		int id;					 // 剛体のID
+		SimplePhysics::SpxUInt32 entity;  // 持ち主のアクターのエンティティ(RigidBody が削除されるときに登録を解除する)
+	};
+
+	// 命令をキューに積む
+	void PushCommand(const Command& command);
+	// キューに積まれた命令を全て実行する(ステップの境目で呼ぶ)
+	void ExecuteCommands();
+	// 最後のステップの姿勢をスナップショットに書き出して公開する
+	void PublishSnapshot(double time);
+	// 公開された最新のスナップショットを取得する
+	void AcquireSnapshot();
+	// スロットを割り当てる(ID の管理はメインスレッドで行う)
+	SimplePhysics::SpxUInt32 AllocateSlot();
+	// 割り当て済みのスロットに剛体を追加する
+	void InsertRigidbodies(const RigidbodyDesc* descs, const int* ids, SimplePhysics::SpxUInt32 count);
+	// firstIndex 以降に追加した動く剛体を、動く剛体の範囲に入れる(既存の剛体は高々1回移動する)
+	void PlaceActiveRigidbodies(SimplePhysics::SpxUInt32 firstIndex);
+	// スロットの剛体を配列から削除する
+	void RemoveRigidbodyInSlot(SimplePhysics::SpxUInt32 slot);
+	// [0, count) を範囲に分けて、ジョブシステムがあれば並列に処理する
+	template <typename Function>
+	void ParallelFor(SimplePhysics::SpxUInt32 count, const Function& function);
+	// 全ての剛体に重力を与える
+	void ApplyExternalForces(float timeStep);
+	// 動く剛体の位置更新を行い、次のステップで使う AABB と描画用の姿勢も書き出す
+	void IntegrateActive(float timeStep);
+	// 衝突判定を行う
+	void DetectCollision();
+	// サブステップに分けて拘束演算と位置更新を行う
+	void SolveSoftStep();
+	// 品質から、このステップで使うイテレーション数、サブステップ数、衝突検出を間引く間隔を決める
+	void ApplyBudgetQuality();
+	// Simulate にかかった時間から、次のステップの品質を決める
+	void UpdateBudget(float milliseconds);
+	// 多関節体に重力を与える
+	void ApplyArticulationForces(float timeStep);
+	// 拘束演算の結果を多関節体に反映して位置更新を行う
+	void IntegrateArticulations(float timeStep);
+	// 剛体の配列を少なくとも numRigidBodies 個格納できるように拡張する
+	bool ReserveRigidbodies(SimplePhysics::SpxUInt32 numRigidBodies);
+	// ペアの配列と衝突情報のプールを少なくとも numPairs 個格納できるように拡張する
+	bool ReservePairs(SimplePhysics::SpxUInt32 numPairs);
+	// ブロードフェーズを行う(ペアが足りなければ配列を拡張してやり直す)
+	void DetectPairs();
+	// 2つの剛体の配列上の位置を入れ替え、ペア、ジョイント、多関節体が持つインデックスを付け替える
+	void SwapRigidbodies(SimplePhysics::SpxUInt32 a, SimplePhysics::SpxUInt32 b);
+	// 2つの剛体のデータとスロットの対応だけを入れ替える(ペアなどが持つインデックスは付け替えない)
+	void SwapRigidbodyData(SimplePhysics::SpxUInt32 a, SimplePhysics::SpxUInt32 b);
+	// 剛体を order の順に並び替える(order[i] は新しい位置 i に置く剛体の元のインデックス)
+	void PermuteRigidbodies(const SimplePhysics::SpxUInt32* order);
+	// 運動の種類を変更し、動く剛体の範囲を保つように剛体を移動する(移動後のインデックスを返す)
+	SimplePhysics::SpxUInt32 ChangeMotionType(SimplePhysics::SpxUInt32 index, SimplePhysics::SpxMotionType type);
+	// 多関節体を解体して、リンクを通常の剛体に戻す
+	void DissolveArticulation(SimplePhysics::SpxUInt32 articulation);
+	// RigidbodyDesc::convexMesh を形状の凸メッシュのハンドルに変換する(-1 や無効な値ならキューブ)
+	SimplePhysics::SpxUInt32 ResolveConvexMesh(int handle) const;
+	// 剛体の追加、削除、属性の変更を行ってよいか(作ったスレッドで、ジョブの外にいるか)
+	bool IsOwnerThread() const;
+
+	// 凸メッシュの元データ(AddConvexMesh の引数の内容のコピー)
+	struct ConvexMeshSource
+	{
+		std::vector<float> vertices;
+		std::vector<unsigned short> indices;
+	};
+
+	// 剛体のIDからスロット番号を取り出す
+	static SimplePhysics::SpxUInt32 SlotOf(int id) { return (SimplePhysics::SpxUInt32)id & mSlotMask; }
+	// スロット番号と現在の世代番号から剛体のIDを作る
+	int MakeId(SimplePhysics::SpxUInt32 slot) const { return (int)((mGenerations[slot] << mSlotBits) | slot); }
+	// 多関節体を作成する
+	int CreateArticulation(int rootId, bool fixedBase, const glm::vec3& baseAnchor);
+	// 同じ多関節体に属する剛体のペアを除外する(ブロードフェーズのコールバック)
+	static bool FilterArticulationPair(SimplePhysics::SpxUInt32 i, SimplePhysics::SpxUInt32 j, void* userData);
+
 	///////////////////////////////////////////////////////////////////////////////
 	//
 	// シミュレーション定数
 
-	// 最大剛体数
-	static const inline int mMaxRigidBodies{500};
+	// 剛体のIDのうちスロット番号に使うビット数(残りのビットは世代番号)
+	static const inline int mSlotBits{20};
+	static const inline SimplePhysics::SpxUInt32 mSlotMask{(1u << mSlotBits) - 1};
+	static const inline SimplePhysics::SpxUInt32 mGenerationMask{(1u << (31 - mSlotBits)) - 1};
 	// 最大ジョイント数
 	static const inline int mMaxJoints{100};
-	// 最大ペア数
-	static const inline int mMaxPairs{5000};
-	// シミュレーションのタイムステップ
-	static const inline float mTimeStep{0.016f};
-	// 拘束演算のイテレーション数
-	static const inline int mIteration{10};
+	// 最大多関節体数
+	static const inline int mMaxArticulations{16};
+	// 衝突情報のプールを詰め直す間隔(フレーム数)
+	static const inline int mContactCompactInterval{60};
 	// 位置補正のバイアス
 	static const inline float mContactBias{0.1f};
 	// 貫通許容誤差
 	static const inline float mContactSlop{0.001f};
 	// 重力
 	static const inline glm::vec3 mGravity{0.0f, -9.8f, 0.0f};
+	// 衝突のソフト拘束の固有振動数(SpxSolverTypeSoftStep)
+	static const inline float mContactHertz{30.0f};
+	// 衝突のソフト拘束の減衰比(SpxSolverTypeSoftStep)
+	static const inline float mContactDampingRatio{10.0f};
+	// ジョイントのソフト拘束の固有振動数(SpxSolverTypeSoftStep)
+	static const inline float mJointHertz{60.0f};
+	// ジョイントのソフト拘束の減衰比(SpxSolverTypeSoftStep)
+	static const inline float mJointDampingRatio{2.0f};
+	// 位置補正で与える速度の最大値(SpxSolverTypeSoftStep)
+	static const inline float mMaxBiasVelocity{3.0f};
+	// 並列処理で1つのジョブが受け持つ剛体の数
+	static const inline int mBodiesPerJob{512};
+	// 並列処理で1つのジョブが受け持つペアの数
+	static const inline int mPairsPerJob{256};
+	// Simulate の時間を平滑化する係数(大きいほど最新の時間を重視する)
+	static const inline float mBudgetSmoothing{0.2f};
+	// 目標時間を超えたときに下げる品質の量と、余裕があるときに上げる品質の量
+	static const inline float mBudgetDegradeStep{0.25f};
+	static const inline float mBudgetRestoreStep{0.05f};
+	// 平滑化した時間が目標時間のこの割合を下回ったら品質を上げる
+	static const inline float mBudgetRestoreRatio{0.75f};
+	// 1ステップの時間が目標時間のこの倍率を超えたら、平滑化した時間によらず品質を下げる
+	static const inline float mBudgetSpikeRatio{2.0f};
+
+	// シミュレーションのタイムステップ
+	float mTimeStep = 0.016f;
+	// Update で1回に行うステップ数の上限
+	int mMaxStepsPerUpdate = 4;
+	// Update で蓄積された、まだシミュレーションしていない時間
+	float mAccumulator = 0.0f;
+	// 描画用の姿勢の補間係数
+	float mInterpolationAlpha = 1.0f;
+	// 拘束ソルバーの種類
+	SimplePhysics::SpxSolverType mSolverType = SimplePhysics::SpxSolverTypePGS;
+	// 拘束演算のイテレーション数(SpxSolverTypePGS)
+	int mIteration = 10;
+	// サブステップ数(SpxSolverTypeSoftStep)
+	int mNumSubsteps = 4;
+	// ブロックソルバーを使うかどうか(SpxSolverTypePGS)
+	bool mUseBlockSolver = false;
+	// ジャイロ効果によるトルクを与えるかどうか
+	bool mUseGyroscopicTorque = false;
+	// 剛体の並び替えを行う間隔(0ならば行わない)
+	int mReorderInterval = 0;
+	// 品質の調整の設定と状態
+	PhysicsBudgetSettings mBudgetSettings;
+	// 現在の品質(0が下限、1が上限)
+	float mBudgetQuality = 1.0f;
+	// このステップで使うイテレーション数、サブステップ数、衝突検出を間引く間隔
+	int mActiveIterations = 10;
+	int mActiveSubsteps = 4;
+	int mContactReuseInterval = 1;
+	// 最後のステップの処理時間と品質の調整の結果(スナップショットで公開する)
+	PhysicsBudgetTelemetry mBudgetTelemetry;
+	// ステップの処理を並列に実行するジョブシステム(Core が所有する)
+	class JobSystem* mJobSystem = nullptr;
+
+	// PhysicsWorld を作ったスレッド(剛体の追加、削除、属性の変更はこのスレッドからだけ行う)
+	std::thread::id mOwnerThread = std::this_thread::get_id();
+	// 剛体の数の上限
+	SimplePhysics::SpxUInt32 mMaxRigidBodies;
+	// ペアの数の上限
+	SimplePhysics::SpxUInt32 mMaxPairs;
 
 	///////////////////////////////////////////////////////////////////////////////
 	//
 	// シミュレーションデータ
 
-	// 剛体
-	SimplePhysics::SpxState mStates[mMaxRigidBodies];
-	SimplePhysics::SpxRigidBody mRigidbodies[mMaxRigidBodies];
-	SimplePhysics::SpxCollidable mCollidables[mMaxRigidBodies];
+	// 剛体(配列の大きさが確保済みの数を表し、先頭の mNumRigidBodies 個を使う)
+	std::vector<SimplePhysics::SpxState> mStates;
+	std::vector<SimplePhysics::SpxRigidBody> mRigidbodies;
+	std::vector<SimplePhysics::SpxCollidable> mCollidables;
+	// 位置更新のときに書き出す、次のブロードフェーズで使う AABB と描画用の姿勢
+	std::vector<SimplePhysics::SpxAabb> mAabbs;
+	std::vector<SimplePhysics::SpxTransform> mTransforms;
+	// 1つ前のステップの描画用の姿勢(補間に使う)
+	std::vector<SimplePhysics::SpxTransform> mPrevTransforms;
 	SimplePhysics::SpxUInt32 mNumRigidBodies = 0;
+	// 先頭の mNumActiveRigidBodies 個は SpxMotionTypeActive の剛体で、その後ろに固定された剛体と多関節体のリンクが並ぶ
+	// 重力の適用と位置更新はこの範囲だけを分岐なしで処理する
+	SimplePhysics::SpxUInt32 mNumActiveRigidBodies = 0;
+
+	// 凸メッシュ(形状からハンドルで参照され、登録後は変更しない)
+	std::vector<SimplePhysics::SpxConvexMesh> mConvexMeshes;
+	// 凸メッシュのハンドルごとの元データ(キャッシュが当たったときに内容を比較する)
+	std::vector<ConvexMeshSource> mConvexMeshSources;
+	// 元データの内容のハッシュ -> 凸メッシュのハンドル(ハッシュが衝突した場合は複数)
+	std::multimap<SimplePhysics::SpxUInt64, int> mConvexMeshCache;
+	// キューブの凸メッシュのハンドル
+	SimplePhysics::SpxUInt32 mBoxMesh = SimplePhysics::SPX_INVALID_CONVEX_MESH;
+
+	// 剛体のIDは、スロット番号と、スロットが再利用されるたびに増える世代番号からなる
+	// スロット番号 -> 配列のインデックス
+	std::vector<SimplePhysics::SpxUInt32> mSlotToIndex;
+	// 配列のインデックス -> スロット番号
+	std::vector<SimplePhysics::SpxUInt32> mIndexToSlot;
+	// スロット番号 -> 配列に追加された剛体のID
+	std::vector<int> mIdOfSlot;
+
+	// 以下の2つはメインスレッドだけが使う(大きさは割り当てたことのあるスロットの数)
+	// スロットの世代番号
+	std::vector<SimplePhysics::SpxUInt32> mGenerations;
+	// 削除された剛体のスロット番号
+	std::vector<SimplePhysics::SpxUInt32> mFreeSlots;
+
+	// 姿勢を書き出すアクター(メインスレッドだけが使う)
+	std::vector<SyncTarget> mSyncTargets;
+	// スロット番号 -> mSyncTargets のインデックス(登録されていなければ -1)
+	std::vector<int> mSyncTargetOfSlot;
+	// 並列処理で1つのジョブが受け持つアクターの数
+	static const inline int mActorsPerJob{256};
 
 	// ジョイント
 
 	SimplePhysics::SpxBallJoint mJoints[mMaxJoints];
 	SimplePhysics::SpxUInt32 mNumJoints = 0;
 
+	// 多関節体
+
+	SimplePhysics::SpxArticulation mArticulations[mMaxArticulations];
+	SimplePhysics::SpxUInt32 mNumArticulations = 0;
+	// スロット番号 -> 属する多関節体のインデックス(属していなければ -1)
+	std::vector<SimplePhysics::SpxInt32> mArticulationOfSlot;
+
 	// ペア
 
-	unsigned int mPairSwap;
-	SimplePhysics::SpxUInt32 mNumPairs[2];
-	SimplePhysics::SpxPair mPairs[2][mMaxPairs];
+	unsigned int mPairSwap = 0;
+	SimplePhysics::SpxUInt32 mNumPairs[2] = {0, 0};
+	std::vector<SimplePhysics::SpxPair> mPairs[2];
+	// mPairs[mPairSwap] のインデックスを付け替えたので、次のステップの先頭でソートし直す必要があるか
+	bool mPairsNeedSort = false;
 
-	// 経過フレーム
-	static inline unsigned long mFrame = 0ul;
+	// 経過フレーム(並び替えや衝突情報の整理の間隔、衝突検出を間引くときの順番に使う)
+	// ワールドごとに数えるので、複数のワールドを別々のスレッドで進めても干渉しない
+	unsigned long mFrame = 0ul;
+
+	///////////////////////////////////////////////////////////////////////////////
+	//
+	// シミュレーションのスレッド
+
+	std::thread mThread;
+	std::atomic<bool> mThreadRunning{false};
+
+	// 命令のキュー(メインスレッドが積み、ステップの境目で mExecutingCommands と交換して実行する)
+	std::mutex mCommandMutex;
+	std::vector<Command> mCommands;
+	std::vector<Command> mExecutingCommands;
+
+	// スナップショットのトリプルバッファ
+	// 書き込み側と読み込み側はそれぞれ1つを占有し、残りの1つを mSnapshotShared を介して交換する
+	static const inline unsigned mSnapshotIndexMask{3u};
+	// mSnapshotShared のバッファがまだ読まれていない新しいものであることを表すビット
+	static const inline unsigned mSnapshotFresh{4u};
+	Snapshot mSnapshots[3];
+	unsigned mSnapshotWrite = 0;
+	unsigned mSnapshotRead = 1;
+	std::atomic<unsigned> mSnapshotShared{2u};
 
 	///////////////////////////////////////////////////////////////////////////////
 
@@ -104,6 +663,7 @@ private:
 	public:
 		void* allocate(size_t bytes) override
 		{
+			mNumAllocations++;
 			return malloc(bytes);
 		}
 
@@ -111,7 +671,17 @@ private:
 		{
 			free(p);
 		}
+
+		SimplePhysics::SpxUInt32 GetNumAllocations() const { return mNumAllocations; }
+
+	private:
+		SimplePhysics::SpxUInt32 mNumAllocations = 0;
 	};
 
+	// 剛体や衝突情報など、ステップをまたいで保持するデータのためのアロケータ
 	DefaultAllocator mAllocator;
+	// 1ステップの間だけ使う作業領域のためのアロケータ(ステップの先頭でリセットする)
+	SimplePhysics::SpxFrameAllocator mFrameAllocator{&mAllocator};
+	// 衝突情報のプール(ペアはこの中のインデックスを持つ)
+	SimplePhysics::SpxContactPool mContactPool;
 };
\ No newline at end of file
@@ -4,9 +4,38 @@
 #include "Renderer.h"
 #include "MeshComponent.h"
 
+const char* PresetActor::GetMeshPath(PresetType type)
+{
+	switch (type)
+	{
+		case PresetType::Cube:
+			return "Assets/cube.obj";
+		case PresetType::Sphere:
+			return "Assets/sphere.obj";
+		case PresetType::Plane:
+			return "Assets/plane.obj";
+		case PresetType::Quad:
+			return "Assets/quad.obj";
+		default:
+			return nullptr;
+	}
+}
+
+void PresetActor::LoadMeshes(Core& core)
+{
+	core.GetRenderer().LoadMeshes({
+		GetMeshPath(PresetType::Cube),
+		GetMeshPath(PresetType::Sphere),
+		GetMeshPath(PresetType::Plane),
+		GetMeshPath(PresetType::Quad),
+	});
+}
+
 std::shared_ptr<class Actor> PresetActor::CreatePreset(Core& core, const std::string& id, PresetType type)
 {
 	auto actor = core.CreateActor(id);
+	if (!actor) { return nullptr; }
+
 	Renderer& renderer = core.GetRenderer();
 	auto meshComponent = actor->AddComponent<MeshComponent>();
 
@@ -16,30 +45,11 @@ std::shared_ptr<class Actor> PresetActor::CreatePreset(Core& core, const std::st
 	mat.mSpecular = glm::vec3(0.3f, 0.3f, 0.3f);
 	mat.mSmoothness = 1.0f;
 
-	switch (type)
+	const char* path = GetMeshPath(type);
+	if (path)
 	{
-		case PresetType::Cube:
-			meshComponent->SetMesh(renderer.GetMesh("Assets/cube.obj"));
-			mat.mShaderType = Renderer::ShaderType::ShadowMapping;
-			break;
-
-		case PresetType::Sphere:
-			meshComponent->SetMesh(renderer.GetMesh("Assets/sphere.obj"));
-			mat.mShaderType = Renderer::ShaderType::ShadowMapping;
-			break;
-
-		case PresetType::Plane:
-			meshComponent->SetMesh(renderer.GetMesh("Assets/plane.obj"));
-			mat.mShaderType = Renderer::ShaderType::ShadowMapping;
-			break;
-
-		case PresetType::Quad:
-			meshComponent->SetMesh(renderer.GetMesh("Assets/quad.obj"));
-			mat.mShaderType = Renderer::ShaderType::ShadowMapping;
-			break;
-
-		default:
-			break;
+		meshComponent->SetMesh(renderer.GetMesh(path));
+		mat.mShaderType = Renderer::ShaderType::ShadowMapping;
 	}
 	meshComponent->RegisterToRenderer();
 
@@ -15,4 +15,11 @@ public:
 	};
 
 	static std::shared_ptr<class Actor> CreatePreset(class Core& core, const std::string& id, PresetType type);
+
+	// プリセットが使うメッシュをまとめて読み込んでおく(シーンの読み込みの最初に呼ぶ)
+	static void LoadMeshes(class Core& core);
+
+private:
+	// プリセットの種類ごとのメッシュのパス
+	static const char* GetMeshPath(PresetType type);
 };
\ No newline at end of file
@@ -5,6 +5,7 @@
 #include "VertexArray.h"
 #include "MeshComponent.h"
 #include "Texture.h"
+#include "JobSystem.h"
 
 #include <GL/glew.h>
 #include <glm/glm.hpp>
@@ -12,6 +13,7 @@
 #include <glm/ext/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <algorithm>
+#include <cassert>
 
 #include <glm/gtx/string_cast.hpp>
 
@@ -24,10 +26,23 @@ Renderer::~Renderer()
 {
 }
 
-bool Renderer::Initialize(float screenWidth, float screenHeight)
+bool Renderer::Initialize(float screenWidth, float screenHeight, bool headless)
 {
 	mScreenWidth = screenWidth;
 	mScreenHeight = screenHeight;
+	mIsHeadless = headless;
+
+	// ヘッドレスではカメラの行列だけを用意する(カメラのコンポーネントが書き込むため)
+	if (mIsHeadless)
+	{
+		mProjection = glm::perspective(
+			glm::radians(45.0f),
+			static_cast<float>(mScreenWidth) / static_cast<float>(mScreenHeight),
+			0.1f,
+			600.0f);
+		mView = glm::mat4(1.0f);
+		return true;
+	}
 
 	SDL_GL_SetAttribute(SDL_GL_CONTEXT_FLAGS, SDL_GL_CONTEXT_FORWARD_COMPATIBLE_FLAG);
 	SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
@@ -58,7 +73,12 @@ bool Renderer::Initialize(float screenWidth, float screenHeight)
 
 	mContext = SDL_GL_CreateContext(mWindow);
 	SDL_GL_MakeCurrent(mWindow, mContext);
-	// SDL_GL_SetSwapInterval(1);	// Enable vsync
+	// 垂直同期を有効にする(フレームの待機は SwapWindow で行われる)
+	// 使えない環境では Core::Update でスリープして待機する
+	if (SDL_GL_SetSwapInterval(1) != 0)
+	{
+		SDL_Log("VSync is not available: %s", SDL_GetError());
+	}
 
 	glewExperimental = GL_TRUE;
 
@@ -125,6 +145,8 @@ void Renderer::Shutdown()
 		i.second->Unload();
 	}
 
+	if (mIsHeadless) { return; }
+
 	for (auto i : mTextures)
 	{
 		i.second->Unload();
@@ -155,6 +177,8 @@ void Renderer::Shutdown()
 
 void Renderer::Draw()
 {
+	if (mIsHeadless) { return; }
+
 	// シャドウマップを作成
 	DrawShadowMap();
 	// レンダーテクスチャ
@@ -221,7 +245,8 @@ void Renderer::Draw3DScene(unsigned int frameBuffer, glm::mat4 view, glm::mat4 p
 
 			if (meshComp)
 			{
-				meshComp->Draw(shader);
+				// 無効なもの(プールで待機中のアクターなど)は描画しない
+				if (meshComp->GetEnabled()) { meshComp->Draw(shader); }
 				++iter;
 			}
 			// メッシュコンポーネントのリンク切れ
@@ -270,7 +295,7 @@ void Renderer::DrawShadowMap()
 			if (meshComp)
 			{
 				// 深度だけを描画
-				meshComp->Draw(shader, true);
+				if (meshComp->GetEnabled()) { meshComp->Draw(shader, true); }
 				++iter;
 			}
 			// メッシュコンポーネントのリンク切れ
@@ -293,6 +318,9 @@ std::weak_ptr<class Texture> Renderer::GetTexture(const std::string& filePath)
 		return std::weak_ptr<Texture>(iter->second);
 	}
 
+	// ヘッドレスではテクスチャを使わない
+	if (mIsHeadless) { return std::weak_ptr<Texture>(); }
+
 	// 見つからなかったのでロードする
 	std::shared_ptr<Texture> texture = std::make_shared<Texture>();
 	if (texture->Load(filePath))
@@ -310,6 +338,12 @@ std::weak_ptr<class Texture> Renderer::GetTexture(const std::string& filePath)
 
 void Renderer::AddMeshComponent(std::weak_ptr<MeshComponent> meshComp)
 {
+	// 描画するメッシュのリストは排他制御しないので、直列の区間からだけ変更する
+	assert(mCore.IsInSerialSection() && "Renderer::AddMeshComponent must be called from the main thread outside of parallel updates");
+
+	// ヘッドレスでは描画しないので登録しない
+	if (mIsHeadless) { return; }
+
 	// 既存のリストに含まれていないか確認する
 	// 存在したら取り除く
 	for (auto&& dic : mMeshCompDict)
@@ -335,6 +369,9 @@ void Renderer::AddMeshComponent(std::weak_ptr<MeshComponent> meshComp)
 
 std::weak_ptr<Mesh> Renderer::GetMesh(const std::string& path)
 {
+	// 読み込んでいなければ、ここで読み込んで登録する
+	assert(mCore.IsInSerialSection() && "Renderer::GetMesh must be called from the main thread outside of parallel updates");
+
 	auto iter = mMeshes.find(path);
 	if (iter != mMeshes.end())
 	{
@@ -342,8 +379,9 @@ std::weak_ptr<Mesh> Renderer::GetMesh(const std::string& path)
 	}
 
 	// 見つからなかったのでロードする
+	// ヘッドレスでは VAO を作らずに頂点データだけを持つ
 	std::shared_ptr<Mesh> m = std::make_shared<Mesh>();
-	if (m->Load(path))
+	if (m->Load(path, !mIsHeadless))
 	{
 		mMeshes.emplace(path, m);
 		return std::weak_ptr<Mesh>(m);
@@ -356,6 +394,43 @@ std::weak_ptr<Mesh> Renderer::GetMesh(const std::string& path)
 	return std::weak_ptr<Mesh>();
 }
 
+void Renderer::LoadMeshes(const std::vector<std::string>& paths)
+{
+	std::vector<std::string> newPaths;
+	for (const auto& path : paths)
+	{
+		if (mMeshes.find(path) == mMeshes.end() &&
+			std::find(newPaths.begin(), newPaths.end(), path) == newPaths.end())
+		{
+			newPaths.push_back(path);
+		}
+	}
+
+	// ファイルの読み込みと解析を並列に行う
+	// (vector<bool> は要素ごとに別のスレッドから書き込めないので char を使う)
+	int numMeshes = (int)newPaths.size();
+	std::vector<std::shared_ptr<Mesh>> meshes(numMeshes);
+	std::vector<char> loaded(numMeshes, 0);
+	mCore.GetJobSystem().ParallelFor(0, numMeshes, 1, [&newPaths, &meshes, &loaded](int first, int last) {
+		for (int i = first; i < last; i++)
+		{
+			meshes[i] = std::make_shared<Mesh>();
+			loaded[i] = meshes[i]->Load(newPaths[i], false);
+		}
+	});
+
+	// GL のコンテキストはこのスレッドにあるので、VAO の作成は順に行う
+	for (int i = 0; i < numMeshes; i++)
+	{
+		if (!loaded[i] || (!mIsHeadless && !meshes[i]->CreateVertexArray()))
+		{
+			SDL_Log("Failed to load Mesh file: %s", newPaths[i].c_str());
+			continue;
+		}
+		mMeshes.emplace(newPaths[i], meshes[i]);
+	}
+}
+
 void Renderer::SetLightUniforms(Shader& shader)
 {
 	// 平行光源の光線方向ベクトル
@@ -30,8 +30,18 @@ public:
 	Renderer(class Core& core);
 	~Renderer();
 
-	bool Initialize(float screenWidth, float screenHeight);
+	/**
+	 * @brief ウィンドウと GL のコンテキストを作成し、シェーダーなどを準備する
+	 *
+	 * @param screenWidth 画面の幅
+	 * @param screenHeight 画面の高さ
+	 * @param headless true ならウィンドウも GL のコンテキストも作らず、描画を行わない
+	 * (メッシュは GL にアップロードせずに頂点データだけを読み込む)
+	 * @return bool 初期化できたかどうか
+	 */
+	bool Initialize(float screenWidth, float screenHeight, bool headless = false);
 	void Shutdown();
+	bool IsHeadless() const { return mIsHeadless; }
 
 	void Draw();
 	void Draw3DScene(unsigned int frameBuffer, glm::mat4 view, glm::mat4 projection, float viewPortScale = 1.0f);
@@ -42,9 +52,20 @@ public:
 
 	std::weak_ptr<class Texture> GetTexture(const std::string& filePath);
 
+	// メッシュの登録と取得(読み込み)は、メインスレッドの直列の区間からだけ行う(Core::IsInSerialSection)
 	void AddMeshComponent(std::weak_ptr<class MeshComponent> meshComp);
 	std::weak_ptr<class Mesh> GetMesh(const std::string& path);
 
+	/**
+	 * @brief 複数のメッシュをまとめて読み込む
+	 * ファイルの読み込みと解析は GL を使わないので、Core のジョブシステムで並列に行い、
+	 * VAO の作成だけをこのスレッド(GL のコンテキストを持つメインスレッド)で順に行う。
+	 * 読み込んだメッシュは GetMesh で取得できる。
+	 *
+	 * @param paths メッシュのファイルのパス(読み込み済みのものは読み込まない)
+	 */
+	void LoadMeshes(const std::vector<std::string>& paths);
+
 	void SetViewMatrix(const glm::mat4& mat) { mView = mat; }
 	void SetCameraPos(const glm::vec3& pos) { mCameraPos = pos; }
 
@@ -71,8 +92,10 @@ private:
 	float mScreenWidth;
 	float mScreenHeight;
 
-	SDL_Window* mWindow;
-	SDL_GLContext mContext;
+	SDL_Window* mWindow = nullptr;
+	SDL_GLContext mContext = nullptr;
+	// ウィンドウと GL を使わずに動かしているかどうか
+	bool mIsHeadless = false;
 
 	// 読み込んだ画像データをTextureにしたものを格納
 	std::unordered_map<std::string, std::shared_ptr<class Texture>> mTextures;
@@ -18,29 +18,41 @@ RigidBody::RigidBody(std::weak_ptr<Actor> owner, int updateOrder)
 {
 }
 
+RigidBody::~RigidBody()
+{
+	if (mID < 0) { return; }
+	mPhysicsWorld.RemoveRigidbody(mID);
+}
+
 void RigidBody::SetMotionType(SimplePhysics::SpxMotionType type)
 {
+	mMotionType = type;
+	if (mID < 0) { return; }
 	mPhysicsWorld.SetMotionType(mID, type);
 }
 
-void RigidBody::ApplyImpulse(glm::vec3 velocity)
+void RigidBody::SetEnabled(bool enabled)
 {
-	mPhysicsWorld.ApplyImpulse(mID, velocity);
+	if (enabled == GetEnabled()) { return; }
+	Component::SetEnabled(enabled);
+
+	if (!enabled)
+	{
+		// 削除した剛体のスロットは、次に登録する剛体で再利用される
+		if (mID >= 0) { mPhysicsWorld.RemoveRigidbody(mID); }
+		mID = -1;
+		return;
+	}
+
+	mID = mPhysicsWorld.AddRigidbody(*this);
+	if (mID >= 0 && mMotionType != SimplePhysics::SpxMotionTypeActive)
+	{
+		mPhysicsWorld.SetMotionType(mID, mMotionType);
+	}
 }
 
-void RigidBody::Update(float deltaTime)
+void RigidBody::ApplyImpulse(glm::vec3 velocity)
 {
-	const SimplePhysics::SpxState& state = mPhysicsWorld.GetState(mID);
-	const SimplePhysics::SpxCollidable& collidable = mPhysicsWorld.GetCollidable(mID);
-
-	// 今のところ、剛体の数は1つだけとする
-	glm::mat4x3 rigidBodyTransform = GLMExtension::To3x4TransformMat(state.m_orientation, state.m_position);
-
-	const SimplePhysics::SpxShape& shape = collidable.m_shapes[0];
-	glm::mat4x3 shapeTransform = GLMExtension::To3x4TransformMat(shape.m_offsetQuaternion, shape.m_offsetPosition);
-	glm::mat4x3 worldTransform = GLMExtension::AffineTransformMultiply(rigidBodyTransform, shapeTransform);
-
-	auto owner = mOwner.lock();
-	owner->SetPosition(GLMExtension::GetTranslation(worldTransform));
-	owner->SetRotation(glm::quat(glm::mat3(worldTransform)));
-}
\ No newline at end of file
+	if (mID < 0) { return; }
+	mPhysicsWorld.ApplyImpulse(mID, velocity);
+}
@@ -10,7 +10,20 @@ public:
 		std::weak_ptr<class Actor> owner,
 		int updateOrder);
 
+	// 剛体を PhysicsWorld から削除する
+	~RigidBody();
+
+	// Update では何もしない(剛体の変更は直列の区間で行う)
+	bool CanUpdateInParallel() const override { return true; }
+
 	void SetMotionType(SimplePhysics::SpxMotionType type);
+	/**
+	 * @brief 無効にすると剛体を PhysicsWorld から削除し、有効にすると持ち主の現在の姿勢で登録し直す
+	 * 登録し直した剛体は静止した状態から始まり、運動の種類は SetMotionType で設定したものに戻る。
+	 *
+	 * @param enabled true なら有効にする
+	 */
+	void SetEnabled(bool enabled) override;
 	/**
 	 * @brief 激力を与える。(速度を変更する)
 	 * 
@@ -19,8 +32,9 @@ public:
 	void ApplyImpulse(glm::vec3 velocity);
 
 private:
-	void Update(float deltaTime) override;
 	RigidBody(std::weak_ptr<class Actor> owner, int updateOrder);
 	int mID;
 	class PhysicsWorld& mPhysicsWorld;
+	// 登録し直すときに使う運動の種類
+	SimplePhysics::SpxMotionType mMotionType = SimplePhysics::SpxMotionTypeActive;
 };
\ No newline at end of file
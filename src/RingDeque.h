@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief 環状バッファで実装した両端キュー
+ * 要素の配列は要素の数が容量を超えたときだけ2倍に拡張するので、容量の範囲で出し入れする限り
+ * メモリの確保が起こらない(std::deque はブロックごとに確保と解放を繰り返す)。
+ * 末尾に積み、末尾と先頭の両方から取り出せる。JobSystem のワーカーごとのキューに使う。
+ *
+ */
+template <typename T>
+class RingDeque
+{
+public:
+	/**
+	 * @param capacity 最初に確保しておく要素の数(2のべき)
+	 */
+	explicit RingDeque(std::size_t capacity = 16)
+		: mItems(capacity)
+	{
+		assert(capacity > 0 && (capacity & (capacity - 1)) == 0 && "RingDeque capacity must be a power of two");
+	}
+
+	// 末尾に積む(いっぱいなら2倍に拡張する)
+	void PushBack(T&& item)
+	{
+		std::size_t capacity = mItems.size();
+		if (mCount == capacity)
+		{
+			// 先頭から順に並べ直して2倍に拡張する
+			std::vector<T> grown(capacity * 2);
+			for (std::size_t i = 0; i < mCount; i++)
+			{
+				grown[i] = std::move(mItems[(mHead + i) & (capacity - 1)]);
+			}
+			mItems.swap(grown);
+			mHead = 0;
+			capacity = mItems.size();
+		}
+
+		mItems[(mHead + mCount) & (capacity - 1)] = std::move(item);
+		mCount++;
+	}
+
+	// 末尾から取り出す(空なら false)
+	bool PopBack(T& item)
+	{
+		if (mCount == 0) { return false; }
+
+		mCount--;
+		item = std::move(mItems[(mHead + mCount) & (mItems.size() - 1)]);
+		return true;
+	}
+
+	// 先頭から取り出す(空なら false)
+	bool PopFront(T& item)
+	{
+		if (mCount == 0) { return false; }
+
+		item = std::move(mItems[mHead]);
+		mHead = (mHead + 1) & (mItems.size() - 1);
+		mCount--;
+		return true;
+	}
+
+	std::size_t Size() const { return mCount; }
+	std::size_t Capacity() const { return mItems.size(); }
+
+private:
+	// 大きさは2のべき
+	std::vector<T> mItems;
+	// 先頭の要素の位置と、要素の数
+	std::size_t mHead = 0;
+	std::size_t mCount = 0;
+};
\ No newline at end of file
@@ -13,6 +13,9 @@
 
 void SceneLoader::LoadScene(Core& core)
 {
+	// メッシュのファイルの読み込みと解析は、ジョブシステムで並列に行っておく
+	PresetActor::LoadMeshes(core);
+
 	auto cameraActor = core.CreateActor("camera");
 	cameraActor->SetPosition(glm::vec3(0, 2, -10));
 	// glm::quat q = glm::angleAxis(glm::radians(10.0f), glm::vec3(1.0f, 0.0f, 0.0f)) * cameraActor->GetRotation();
@@ -20,15 +23,18 @@ void SceneLoader::LoadScene(Core& core)
 
 	cameraActor->AddComponent<CameraComponent>(100);
 	cameraActor->AddComponent<CameraMove>(50);
-	cameraActor->AddComponent<CubeShooter>();
+	// 撃ち出すキューブはシーンの読み込み時に組み立てておき、
+	// 同時に存在する数を抑えて古いものから使い回す
+	auto shooter = cameraActor->AddComponent<CubeShooter>();
+	shooter->WarmUp(16);
+	shooter->SetMaxShots(16);
 
 	for (int i = 0; i < 5; i++)
 	{
 		auto cube = PresetActor::CreatePreset(
 			core, "cube", PresetActor::PresetType::Cube);
 		cube->SetPosition(glm::vec3(0.0f, 4.0f + i * 1.5f, 3.0f));
-		auto meshComponent = cube->GetComponent<MeshComponent>();
-		MeshComponent::Material& mat = meshComponent.lock()->GetMaterial();
+		MeshComponent::Material& mat = cube->FindComponent<MeshComponent>()->GetMaterial();
 		mat.mAmbient = glm::vec3(0.1f, 0.1f, 0.9f);
 		mat.mDiffuse = glm::vec3(0.1f, 0.1f, 0.9f);
 		mat.mSpecular = glm::vec3(0.9f, 0.9f, 0.9f);
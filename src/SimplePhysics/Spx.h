@@ -9,10 +9,16 @@
 #include "elements/SpxConstraint.h"
 #include "elements/SpxPair.h"
 #include "elements/SpxBallJoint.h"
+#include "elements/SpxArticulation.h"
 #include "elements/SpxConvexMesh.h"
+#include "elements/SpxAabb.h"
+#include "elements/SpxTransform.h"
 #include "pipeline/SpxAllocator.h"
+#include "pipeline/SpxArticulationSolver.h"
 #include "pipeline/SpxBroadphase.h"
+#include "pipeline/SpxFrameAllocator.h"
 #include "pipeline/SpxCollisionDetection.h"
+#include "pipeline/SpxContactPool.h"
 #include "pipeline/SpxConstraintSolver.h"
 #include "pipeline/SpxIntegrate.h"
 #include "pipeline/SpxSort.h"
\ No newline at end of file
@@ -24,8 +24,8 @@ enum SpxSatType
 	++satCount;\
 	float d1 = AMin - BMax;\
 	float d2 = BMin - AMax;\
-	if(d1 >= 0.0f || d2 >= 0.0f) {\
-	/* 2つの凸メッシュは衝突していなかった */\
+	if(d1 >= maxSeparation || d2 >= maxSeparation) {\
+	/* 2つの凸メッシュは許容距離以上離れていた */\
 		return false;\
 	}\
 	if(distanceMin < d1) {\
@@ -45,11 +45,35 @@ enum SpxSatType
 }
 
 // clang-format on
+
+// スケールをかけた凸メッシュを軸に投影する
+// スケールをかけた頂点 s*v と軸 a の内積は、頂点 v と s*a の内積に等しい
+static inline void SpxGetScaledProjection(
+	float& pmin,
+	float& pmax,
+	const SpxConvexMesh* convexMesh,
+	const glm::vec3& scale,
+	const glm::vec3& axis)
+{
+	SpxGetProjection(pmin, pmax, convexMesh, scale * axis);
+}
+
+// スケールをかけた凸メッシュの面法線を求める
+// 法線はスケールの逆数をかけてから正規化する
+static inline glm::vec3 SpxGetScaledNormal(const glm::vec3& normal, const glm::vec3& invScale)
+{
+	return glm::normalize(normal * invScale);
+}
+
+// 判定はスケールをかけたAのローカル座標系で行う
 bool SpxConvexConvexContact_local(
 	const SpxConvexMesh& convexA,
 	const glm::mat4x3& transformA,
+	const glm::vec3& scaleA,
 	const SpxConvexMesh& convexB,
 	const glm::mat4x3& transformB,
+	const glm::vec3& scaleB,
+	float maxSeparation,
 	glm::vec3& normal,
 	float& penetrationDepth,
 	glm::vec3& contactPointA,
@@ -71,6 +95,10 @@ bool SpxConvexConvexContact_local(
 	// Aローカル->Bローカルへの変換の並進移動成分
 	glm::vec3 offsetBA = GLMExtension::GetTranslation(transformBA);
 
+	// 面法線の変換に使うスケールの逆数
+	const glm::vec3 invScaleA = 1.0f / scaleA;
+	const glm::vec3 invScaleB = 1.0f / scaleB;
+
 	// 最も浅い貫通深度とそのときの分離軸
 	float distanceMin = -FLT_MAX;
 	// 分離軸はAを押し返す方向を向くようにセットされる
@@ -89,17 +117,17 @@ bool SpxConvexConvexContact_local(
 	{
 		const SpxFacet& facet = convexA.m_facets[f];
 		// 分離軸
-		const glm::vec3 separatingAxis = facet.normal;
+		const glm::vec3 separatingAxis = SpxGetScaledNormal(facet.normal, invScaleA);
 
 		// ConvexAを分離軸に投影
 		float minA, maxA;
-		SpxGetProjection(minA, maxA, &convexA, separatingAxis);
+		SpxGetScaledProjection(minA, maxA, &convexA, scaleA, separatingAxis);
 
 		// ConvexBを分離軸に投影
 		// 判定の際の基準はAのローカル座標系。
 		float minB, maxB;
 		// 分離軸はAのローカル座標系->Bのローカル座標系に変換しておく。
-		SpxGetProjection(minB, maxB, &convexB, matrixBA * facet.normal);
+		SpxGetScaledProjection(minB, maxB, &convexB, scaleB, matrixBA * separatingAxis);
 		// Aのローカル座標系におけるBの軸上の位置を計算。
 		float offset = glm::dot(offsetAB, separatingAxis);
 		// minBとmaxBをAのローカル座標系に変換
@@ -114,16 +142,17 @@ bool SpxConvexConvexContact_local(
 	for (SpxUInt32 f = 0; f < convexB.m_numFacets; f++)
 	{
 		const SpxFacet& facet = convexB.m_facets[f];
+		const glm::vec3 normalB = SpxGetScaledNormal(facet.normal, invScaleB);
 		// 分離軸はBのローカル座標系からAのローカル座標系に変換する
-		const glm::vec3 separatingAxis = matrixAB * facet.normal;
+		const glm::vec3 separatingAxis = matrixAB * normalB;
 
 		// ConvexAを分離軸に投影
 		float minA, maxA;
-		SpxGetProjection(minA, maxA, &convexA, separatingAxis);
+		SpxGetScaledProjection(minA, maxA, &convexA, scaleA, separatingAxis);
 
 		// ConvexBを分離軸に投影
 		float minB, maxB;
-		SpxGetProjection(minB, maxB, &convexB, facet.normal);
+		SpxGetScaledProjection(minB, maxB, &convexB, scaleB, normalB);
 		// Aのローカル座標系におけるBの軸上の位置を計算。
 		float offset = dot(offsetAB, separatingAxis);
 		minB += offset;
@@ -144,7 +173,7 @@ bool SpxConvexConvexContact_local(
 		if (edgeA.type != SpxEdgeTypeConvex) { continue; }
 
 		// 凸メッシュA側のエッジのベクトルを作成
-		const glm::vec3 edgeVecA = convexA.m_vertices[edgeA.vertId[1]] - convexA.m_vertices[edgeA.vertId[0]];
+		const glm::vec3 edgeVecA = scaleA * (convexA.m_vertices[edgeA.vertId[1]] - convexA.m_vertices[edgeA.vertId[0]]);
 
 		// 内側はBのエッジでループ
 		for (SpxUInt32 eB = 0; eB < convexB.m_numEdges; eB++)
@@ -154,7 +183,7 @@ bool SpxConvexConvexContact_local(
 
 			// 凸メッシュB側のエッジのベクトルを作成
 			// 判定はやはりAのローカル座標系なので、ベクトルをBのローカル座標系からAのローカル座標系に変換する
-			const glm::vec3 edgeVecB = matrixAB * (convexB.m_vertices[edgeB.vertId[1]] - convexB.m_vertices[edgeB.vertId[0]]);
+			const glm::vec3 edgeVecB = matrixAB * (scaleB * (convexB.m_vertices[edgeB.vertId[1]] - convexB.m_vertices[edgeB.vertId[0]]));
 
 			glm::vec3 separatingAxis = glm::cross(edgeVecA, edgeVecB);
 			// 2つのベクトルの外積が0に近い(2つのベクトルがほぼ平行)ならば、そのベクトルは分離軸として使えないので
@@ -165,11 +194,11 @@ bool SpxConvexConvexContact_local(
 
 			// ConvexAを分離軸に投影
 			float minA, maxA;
-			SpxGetProjection(minA, maxA, &convexA, separatingAxis);
+			SpxGetScaledProjection(minA, maxA, &convexA, scaleA, separatingAxis);
 
 			// ConvexBを分離軸に投影
 			float minB, maxB;
-			SpxGetProjection(minB, maxB, &convexB, matrixBA * separatingAxis);
+			SpxGetScaledProjection(minB, maxB, &convexB, scaleB, matrixBA * separatingAxis);
 			float offset = glm::dot(offsetAB, separatingAxis);
 			minB += offset;
 			maxB += offset;
@@ -179,9 +208,10 @@ bool SpxConvexConvexContact_local(
 		}
 	}
 
-	// ここまで到達した場合、２つの凸メッシュは交差している。
+	// ここまで到達した場合、２つの凸メッシュは交差しているか、maxSeparation より近くにある。
 	// また、反発ベクトル(axisMin)と貫通深度(distanceMin)が求まった。
 	// 反発ベクトルはＡを押しだす方向をプラスにとる。
+	// 離れている場合の distanceMin は正の値になり、分離軸上の距離(実際の距離以下)を表す。
 
 	// ~~~~~~~~~~~~~~~~ 衝突座標検出 ~~~~~~~~~~~~~~~~
 
@@ -190,14 +220,16 @@ bool SpxConvexConvexContact_local(
 	float closestMinSqr = FLT_MAX;
 	glm::vec3 closestPointA, closestPointB;
 	// 衝突点を求めるために、形状の重なりを無くす必要がある。
-	glm::vec3 separation = 1.1f * glm::abs(distanceMin) * axisMin;
+	// すでに離れている場合はそのままでよい。
+	glm::vec3 separation = distanceMin < 0.0f ? 1.1f * -distanceMin * axisMin : glm::vec3(0.0f);
 
 	// 大外はAの面でループ
 	for (SpxUInt32 fA = 0; fA < convexA.m_numFacets; fA++)
 	{
 		const SpxFacet& facetA = convexA.m_facets[fA];
+		const glm::vec3 normalA = SpxGetScaledNormal(facetA.normal, invScaleA);
 
-		float checkA = glm::dot(facetA.normal, -axisMin);
+		float checkA = glm::dot(normalA, -axisMin);
 		// axisFlip の意味がわからない。
 		if (satType == SpxSatTypePointBFacetA && checkA < 0.99f && axisFlip)
 		{
@@ -215,8 +247,9 @@ bool SpxConvexConvexContact_local(
 		for (SpxUInt32 fB = 0; fB < convexB.m_numFacets; fB++)
 		{
 			const SpxFacet& facetB = convexB.m_facets[fB];
+			const glm::vec3 normalB = SpxGetScaledNormal(facetB.normal, invScaleB);
 
-			float checkB = dot(facetB.normal, matrixBA * axisMin);
+			float checkB = dot(normalB, matrixBA * axisMin);
 			if (satType == SpxSatTypePointAFacetB && checkB < 0.99f && !axisFlip)
 			{
 				// 判定軸が面Bの法線のとき、向きの違うBの面は判定しない
@@ -233,15 +266,15 @@ bool SpxConvexConvexContact_local(
 
 			// 面Ａと面Ｂの最近接点を求める
 			glm::vec3 triangleA[3] = {
-				separation + convexA.m_vertices[facetA.vertId[0]],
-				separation + convexA.m_vertices[facetA.vertId[1]],
-				separation + convexA.m_vertices[facetA.vertId[2]],
+				separation + scaleA * convexA.m_vertices[facetA.vertId[0]],
+				separation + scaleA * convexA.m_vertices[facetA.vertId[1]],
+				separation + scaleA * convexA.m_vertices[facetA.vertId[2]],
 			};
 
 			glm::vec3 triangleB[3] = {
-				offsetAB + matrixAB * convexB.m_vertices[facetB.vertId[0]],
-				offsetAB + matrixAB * convexB.m_vertices[facetB.vertId[1]],
-				offsetAB + matrixAB * convexB.m_vertices[facetB.vertId[2]],
+				offsetAB + matrixAB * (scaleB * convexB.m_vertices[facetB.vertId[0]]),
+				offsetAB + matrixAB * (scaleB * convexB.m_vertices[facetB.vertId[1]]),
+				offsetAB + matrixAB * (scaleB * convexB.m_vertices[facetB.vertId[2]]),
 			};
 
 			// エッジ同士の最近接点算出
@@ -273,7 +306,7 @@ bool SpxConvexConvexContact_local(
 			for (int i = 0; i < 3; i++)
 			{
 				glm::vec3 s;
-				SpxGetClosestPointTriangle(triangleA[i], triangleB[0], triangleB[1], triangleB[2], matrixAB * facetB.normal, s);
+				SpxGetClosestPointTriangle(triangleA[i], triangleB[0], triangleB[1], triangleB[2], matrixAB * normalB, s);
 				float dSqr = glm::length2(triangleA[i] - s);
 				if (dSqr < closestMinSqr)
 				{
@@ -287,7 +320,7 @@ bool SpxConvexConvexContact_local(
 			for (int i = 0; i < 3; i++)
 			{
 				glm::vec3 s;
-				SpxGetClosestPointTriangle(triangleB[i], triangleA[0], triangleA[1], triangleA[2], facetA.normal, s);
+				SpxGetClosestPointTriangle(triangleB[i], triangleA[0], triangleA[1], triangleA[2], normalA, s);
 				float dSqr = glm::length2(triangleB[i] - s);
 				if (dSqr < closestMinSqr)
 				{
@@ -310,8 +343,11 @@ bool SpxConvexConvexContact_local(
 bool SpxConvexConvexContact(
 	const SpxConvexMesh& convexA,
 	const glm::mat4x3& transformA,
+	const glm::vec3& scaleA,
 	const SpxConvexMesh& convexB,
 	const glm::mat4x3& transformB,
+	const glm::vec3& scaleB,
+	float maxSeparation,
 	glm::vec3& normal,
 	float& penetrationDepth,
 	glm::vec3& contactPointA,
@@ -323,15 +359,15 @@ bool SpxConvexConvexContact(
 	if (convexA.m_numFacets >= convexB.m_numFacets)
 	{
 		ret = SpxConvexConvexContact_local(
-			convexA, transformA,
-			convexB, transformB,
-			normal, penetrationDepth, contactPointA, contactPointB);
+			convexA, transformA, scaleA,
+			convexB, transformB, scaleB,
+			maxSeparation, normal, penetrationDepth, contactPointA, contactPointB);
 	}
 	else {
 		ret = SpxConvexConvexContact_local(
-			convexB, transformB,
-			convexA, transformA,
-			normal, penetrationDepth, contactPointB, contactPointA);
+			convexB, transformB, scaleB,
+			convexA, transformA, scaleA,
+			maxSeparation, normal, penetrationDepth, contactPointB, contactPointA);
 		normal = -normal;
 	}
 
@@ -9,20 +9,26 @@ namespace SimplePhysics
 	 * @brief 2つの凸メッシュの衝突検出
 	 *
 	 * @param convexA 凸メッシュA
-	 * @param transformA Aのワールド変換行列(3行4列)
+	 * @param transformA Aのワールド変換行列(3行4列、スケールを含まない)
+	 * @param scaleA 凸メッシュAのスケール
 	 * @param convexB 凸メッシュB
-	 * @param transformB Bのワールド変換行列(3行4列)
+	 * @param transformB Bのワールド変換行列(3行4列、スケールを含まない)
+	 * @param scaleB 凸メッシュBのスケール
+	 * @param maxSeparation 衝突点を求める最大の距離(0より大きければ、離れていてもこの距離までは投機的な衝突点を戻す)
 	 * @param normal 衝突点の法線ベクトル(ワールド座標系)
-	 * @param penetrationDepth 貫通深度
-	 * @param contactPointA 衝突点(剛体Aのローカル座標系)
-	 * @param contactPointB 衝突点(剛体Bのローカル座標系)
-	 * @return 衝突が検出されたら true
+	 * @param penetrationDepth 貫通深度(離れている場合は正の値)
+	 * @param contactPointA 衝突点(剛体Aのローカル座標系。スケールをかけた後の座標)
+	 * @param contactPointB 衝突点(剛体Bのローカル座標系。スケールをかけた後の座標)
+	 * @return 衝突(または maxSeparation より近い位置)が検出されたら true
 	 */
 	bool SpxConvexConvexContact(
 		const SpxConvexMesh& convexA,
 		const glm::mat4x3& transformA,
+		const glm::vec3& scaleA,
 		const SpxConvexMesh& convexB,
 		const glm::mat4x3& transformB,
+		const glm::vec3& scaleB,
+		float maxSeparation,
 		glm::vec3& normal,
 		float& penetrationDepth,
 		glm::vec3& contactPointA,
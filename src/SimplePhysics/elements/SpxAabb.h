@@ -0,0 +1,20 @@
+#pragma once
+
+#include "../SpxBase.h"
+
+namespace SimplePhysics
+{
+	// ブロードフェーズで取りこぼしが出ないように AABB を拡張する大きさ
+	const float SPX_AABB_EXPAND = 0.01f;
+
+	/**
+	 * @brief ワールド座標系の AABB
+	 * 剛体の位置更新のときに計算しておき、次のステップのブロードフェーズで使う。
+	 *
+	 */
+	struct SpxAabb
+	{
+		glm::vec3 m_center;	 // 中心座標
+		glm::vec3 m_half;	 // それぞれの軸の大きさの半分
+	};
+};	// namespace SimplePhysics
\ No newline at end of file
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "../SpxBase.h"
+
+namespace SimplePhysics
+{
+	// 1つの多関節体が持てるリンクの最大数
+	const SpxUInt32 SPX_ARTICULATION_MAX_LINKS = 64;
+
+	// 多関節体のリンク(ボールジョイントで親リンクとつながった剛体)
+	struct SpxArticulationLink
+	{
+		SpxUInt32 rigidBody;		 // 剛体のインデックス
+		SpxInt32 parent;			 // 親リンクのインデックス(根元のリンクは -1)
+		glm::vec3 anchorParent;		 // 親剛体のローカル座標系における関節の位置
+		glm::vec3 anchorChild;		 // 自身のローカル座標系における関節の位置
+		glm::vec3 jointVelocity;	 // 親リンクに対する相対角速度(ワールド座標系)
+	};
+
+	/**
+	 * @brief 関節で連結された剛体の木構造
+	 * 関節の自由度(各リンクの相対角速度)を状態として持ち、関節の拘束は常に厳密に満たされる。
+	 * リンクは親リンクより後ろに並んでいる必要がある。
+	 *
+	 */
+	struct SpxArticulation
+	{
+		SpxUInt32 m_numLinks;									  // リンクの数
+		bool m_fixedBase;										  // 根元のリンクがワールドに固定された点につながっているかどうか
+		glm::vec3 m_baseAnchor;									  // 根元のリンクをつなぐワールド座標系の点(m_fixedBase のとき)
+		glm::vec3 m_rootLinearVelocity;							  // 根元のリンクの並進速度(m_fixedBase でないとき)
+		glm::vec3 m_rootAngularVelocity;						  // 根元のリンクの角速度(m_fixedBase でないとき)
+		SpxArticulationLink m_links[SPX_ARTICULATION_MAX_LINKS];  // リンクの配列(0番が根元)
+
+		void Reset()
+		{
+			m_numLinks = 0;
+			m_fixedBase = false;
+			m_baseAnchor = glm::vec3(0.0f);
+			m_rootLinearVelocity = glm::vec3(0.0f);
+			m_rootAngularVelocity = glm::vec3(0.0f);
+		}
+	};
+};	// namespace SimplePhysics
\ No newline at end of file
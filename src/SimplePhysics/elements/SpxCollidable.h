@@ -35,21 +35,24 @@ namespace SimplePhysics
 			}
 		}
 
-		void Finish()
+		/**
+		 * @brief 形状の登録を完了してAABBを計算する
+		 *
+		 * @param convexMeshes 形状が参照する凸メッシュの配列
+		 */
+		void Finish(const SpxConvexMesh* convexMeshes)
 		{
 			glm::vec3 aabbMax(-FLT_MAX), aabbMin(FLT_MAX);
 			for (SpxUInt32 i = 0; i < m_numShapes; i++)	 // 保持している形状でループを回す
 			{
-				const SpxConvexMesh& mesh = m_shapes[i].m_geometry;
+				const SpxShape& shape = m_shapes[i];
+				const SpxConvexMesh& mesh = convexMeshes[shape.m_geometry];
 
 				for (SpxUInt32 v = 0; v < mesh.m_numVertices; v++)	// メッシュの頂点でループを回す
 				{
-					aabbMax = GLMExtension::MaxPerElem(
-						aabbMax,
-						m_shapes[i].m_offsetPosition + m_shapes[i].m_offsetQuaternion * mesh.m_vertices[v]);
-					aabbMin = GLMExtension::MinPerElem(
-						aabbMin,
-						m_shapes[i].m_offsetPosition + m_shapes[i].m_offsetQuaternion * mesh.m_vertices[v]);
+					glm::vec3 vertex = shape.m_offsetPosition + shape.m_offsetQuaternion * (shape.m_scale * mesh.m_vertices[v]);
+					aabbMax = GLMExtension::MaxPerElem(aabbMax, vertex);
+					aabbMin = GLMExtension::MinPerElem(aabbMin, vertex);
 				}
 			}
 
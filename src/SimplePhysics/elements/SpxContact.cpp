@@ -124,6 +124,23 @@ void SpxContact::Reset()
 	}
 }
 
+void SpxContact::Flip()
+{
+	for (SpxUInt32 i = 0; i < m_numContacts; i++)
+	{
+		SpxContactPoint& cp = m_contactPoints[i];
+		glm::vec3 tmp = cp.pointA;
+		cp.pointA = cp.pointB;
+		cp.pointB = tmp;
+		cp.normal = -cp.normal;
+
+		// 法線ベクトルを反転すると、SpxCalcTangentVector で作られる
+		// 1つ目の接線ベクトルは反転し、2つ目の接線ベクトルは変わらない。
+		// 剛体を入れ替えたことによる符号の反転と合わせると、2つ目の摩擦だけ符号が変わる。
+		cp.constraints[2].accumImpulse = -cp.constraints[2].accumImpulse;
+	}
+}
+
 void SpxContact::RemoveContactPoint(int i)
 {
 	m_contactPoints[i] = m_contactPoints[m_numContacts - 1];
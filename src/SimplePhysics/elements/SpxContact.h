@@ -60,6 +60,13 @@ struct SpxContact
 
 	void Reset();
 
+	/**
+	 * @brief 剛体Aと剛体Bを入れ替える
+	 *
+	 * 衝突点と法線ベクトルを入れ替え、蓄積された拘束力が同じ力を表すように符号を合わせる。
+	 */
+	void Flip();
+
 	/**
 	 * @brief 衝突点をリフレッシュする
 	 *
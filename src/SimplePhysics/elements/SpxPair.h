@@ -5,6 +5,9 @@
 
 namespace SimplePhysics
 {
+	// 衝突情報を参照していないことを表すインデックス
+	const SpxUInt32 SPX_INVALID_CONTACT = 0xFFFFFFFFu;
+
 	// ペアの種類
 	enum SpxPairType
 	{
@@ -28,6 +31,6 @@ namespace SimplePhysics
 				SpxUInt32 rigidBodyB; // 剛体Bのインデックス
 			};
 		};
-		SpxContact* contact; // 衝突情報
+		SpxUInt32 contact; // 衝突情報のインデックス(SpxContactPool)
 	};
 };	// namespace SimplePhysics
\ No newline at end of file
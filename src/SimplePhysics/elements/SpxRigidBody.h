@@ -6,21 +6,37 @@ namespace SimplePhysics
 {
 	/**
 	 * @brief 剛体の属性を格納するデータ型
+	 * 質量と慣性テンソルの逆数は、変更したときに計算しておく。
+	 * 質量と慣性テンソルは SetMass と SetInertia で変更すること。
 	 *
 	 */
 	struct SpxRigidBody
 	{
-		glm::mat3 m_inertia;  // 慣性テンソル
-		float m_mass;		  // 質量
-		float m_restitution;  // 反発係数
-		float m_friction;	  // 摩擦係数
+		glm::mat3 m_inertia;	 // 慣性テンソル
+		glm::mat3 m_inertiaInv;	 // 慣性テンソルの逆行列(ローカル座標系)
+		float m_mass;			 // 質量
+		float m_massInv;		 // 質量の逆数
+		float m_restitution;	 // 反発係数
+		float m_friction;		 // 摩擦係数
 
 		void Reset()
 		{
-			m_mass = 1.0f;
-			m_inertia = glm::mat3(1.0f);  // 単位行列
+			SetMass(1.0f);
+			SetInertia(glm::mat3(1.0f));  // 単位行列
 			m_restitution = 0.2f;
 			m_friction = 0.6f;
 		}
+
+		void SetMass(float mass)
+		{
+			m_mass = mass;
+			m_massInv = 1.0f / mass;
+		}
+
+		void SetInertia(const glm::mat3& inertia)
+		{
+			m_inertia = inertia;
+			m_inertiaInv = glm::inverse(inertia);
+		}
 	};
 };	// namespace SimplePhysics
\ No newline at end of file
@@ -7,16 +7,27 @@
 
 namespace SimplePhysics
 {
+	// 凸メッシュを参照していないことを表すハンドル
+	const SpxUInt32 SPX_INVALID_CONVEX_MESH = 0xFFFFFFFFu;
+
+	/**
+	 * @brief 剛体の形状
+	 * 凸メッシュは複数の形状で共有するので、形状は凸メッシュの配列のインデックスだけを持つ。
+	 * スケールは凸メッシュには含めず、衝突判定のときに適用する。
+	 *
+	 */
 	struct SpxShape
 	{
-		SpxConvexMesh m_geometry;	   // 凸メッシュ
+		SpxUInt32 m_geometry;		   // 凸メッシュのハンドル(凸メッシュの配列のインデックス)
+		glm::vec3 m_scale;			   // 凸メッシュのスケール(各要素は正の値)
 		glm::vec3 m_offsetPosition;	   // 座標のオフセット
 		glm::quat m_offsetQuaternion;  // 回転のオフセット
 		void* userData;				   // ユーザーデータ
 
 		void Reset()
 		{
-			m_geometry.Reset();
+			m_geometry = SPX_INVALID_CONVEX_MESH;
+			m_scale = glm::vec3(1.0f);
 			m_offsetPosition = glm::vec3(0.0f);
 			m_offsetQuaternion = glm::identity<glm::quat>();
 			userData = nullptr;
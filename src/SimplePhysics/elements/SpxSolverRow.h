@@ -0,0 +1,53 @@
+#pragma once
+
+#include "../SpxBase.h"
+#include "SpxContact.h"
+#include "SpxBallJoint.h"
+
+namespace SimplePhysics
+{
+
+// 拘束1本分のヤコビアンをセットアップ時に展開して保持するデータ構造
+// 反復計算では内積と積和だけで済むようにしておく
+struct SpxSolverRow
+{
+	glm::vec3 linear;			   // 並進方向のヤコビアン(拘束軸)
+	glm::vec3 angularA;			   // 剛体Aの回転方向のヤコビアン(rA × axis)
+	glm::vec3 angularB;			   // 剛体Bの回転方向のヤコビアン(rB × axis)
+	glm::vec3 inertiaInvAngularA;  // 慣性テンソルの逆行列を掛けた剛体Aの回転方向のヤコビアン
+	glm::vec3 inertiaInvAngularB;  // 慣性テンソルの逆行列を掛けた剛体Bの回転方向のヤコビアン
+	float jacDiagInv;			   // 拘束式の分母
+	float rhs;					   // 初期拘束力
+	float lowerLimit;			   // 拘束力の下限
+	float upperLimit;			   // 拘束力の上限
+	float accumImpulse;			   // 蓄積される拘束力
+};
+
+// 衝突点1つ分の拘束(法線方向、摩擦方向x2)
+struct SpxSolverContactPoint
+{
+	SpxUInt32 rigidBodyA;			// 剛体Aのインデックス
+	SpxUInt32 rigidBodyB;			// 剛体Bのインデックス
+	float friction;					// 摩擦係数
+	SpxSolverRow rows[3];			// 拘束(0:法線 1,2:摩擦)
+	SpxContactPoint* contactPoint;	// 拘束力を書き戻す衝突点
+};
+
+// 1つのペアが持つ衝突点の拘束をまとめたもの(ブロックソルバー用)
+struct SpxSolverManifold
+{
+	SpxUInt32 firstContact;							// 先頭の衝突点の拘束のインデックス
+	SpxUInt32 numContacts;							// 衝突点の数
+	float K[SPX_NUM_CONTACTS][SPX_NUM_CONTACTS];	// 法線方向の拘束同士の連成行列 J M^-1 J^T
+};
+
+// ボールジョイント1つ分の拘束
+struct SpxSolverJoint
+{
+	SpxUInt32 rigidBodyA;  // 剛体Aのインデックス
+	SpxUInt32 rigidBodyB;  // 剛体Bのインデックス
+	SpxSolverRow row;	   // 拘束
+	SpxBallJoint* joint;   // 拘束力を書き戻すジョイント
+};
+
+};	// namespace SimplePhysics
\ No newline at end of file
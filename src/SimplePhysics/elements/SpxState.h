@@ -8,8 +8,9 @@ namespace SimplePhysics
 	// モーションタイプ(剛体の振る舞い)
 	enum SpxMotionType
 	{
-		SpxMotionTypeActive,  // アクティブ
-		SpxMotionTypeStatic,  // 固定
+		SpxMotionTypeActive,	   // アクティブ
+		SpxMotionTypeStatic,	   // 固定
+		SpxMotionTypeArticulated,  // 多関節体のリンク(位置と速度は SpxArticulation が更新する)
 	};
 
 	// 剛体の状態(速度、姿勢等)
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "../SpxBase.h"
+#include <glm/gtx/quaternion.hpp>
+
+namespace SimplePhysics
+{
+	/**
+	 * @brief 描画側に渡す剛体の姿勢
+	 * 剛体の位置更新のときに書き出しておき、描画側はこの配列だけを読めばよい。
+	 * 剛体の最初の形状のオフセットを含んだ姿勢になる。
+	 *
+	 */
+	struct SpxTransform
+	{
+		glm::vec3 m_position;	   // 座標
+		glm::quat m_orientation;  // 姿勢
+	};
+};	// namespace SimplePhysics
\ No newline at end of file
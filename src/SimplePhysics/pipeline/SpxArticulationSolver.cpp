@@ -0,0 +1,469 @@
+#include "SpxArticulationSolver.h"
+#include "SpxIntegrate.h"
+#include <glm/gtx/quaternion.hpp>
+#include <utility>
+
+namespace SimplePhysics
+{
+
+// 空間ベクトル(回転成分と並進成分の6次元ベクトル)
+// 座標系の変換を省くため、全てワールド座標系の原点まわりで表す
+struct SpxSpatialVector
+{
+	glm::vec3 angular;	// 回転成分(角速度、モーメント)
+	glm::vec3 linear;	// 並進成分(原点に一致する点の速度、力)
+};
+
+// 空間行列(6x6 を 3x3 のブロック4つで表す)
+struct SpxSpatialMatrix
+{
+	glm::mat3 m00, m01;
+	glm::mat3 m10, m11;
+};
+
+// Articulated Body Algorithm の作業領域
+struct SpxArticulationWorkspace
+{
+	glm::vec3 anchor[SPX_ARTICULATION_MAX_LINKS];				 // 関節のワールド座標
+	SpxSpatialVector velocity[SPX_ARTICULATION_MAX_LINKS];		 // リンクの空間速度
+	SpxSpatialVector bias[SPX_ARTICULATION_MAX_LINKS];			 // 速度に依存する加速度の項
+	SpxSpatialMatrix inertia[SPX_ARTICULATION_MAX_LINKS];		 // 多関節体慣性
+	SpxSpatialVector force[SPX_ARTICULATION_MAX_LINKS];			 // 多関節体バイアス力
+	glm::mat3 uTop[SPX_ARTICULATION_MAX_LINKS];					 // U = I^A S の回転成分
+	glm::mat3 uBottom[SPX_ARTICULATION_MAX_LINKS];				 // U = I^A S の並進成分
+	glm::mat3 dInv[SPX_ARTICULATION_MAX_LINKS];					 // D = S^T U の逆行列
+	glm::vec3 u[SPX_ARTICULATION_MAX_LINKS];					 // u = τ - S^T p^A
+	SpxSpatialVector acceleration[SPX_ARTICULATION_MAX_LINKS];	 // リンクの空間加速度(求める値)
+	glm::vec3 jointAcceleration[SPX_ARTICULATION_MAX_LINKS];	 // 関節の角加速度(求める値)
+};
+
+/**
+ * @brief 外積を行列で表す ([v]x w = v × w)
+ *
+ */
+static inline glm::mat3 SpxCrossMatrix(const glm::vec3& v)
+{
+	return glm::mat3(
+		glm::vec3(0.0f, v.z, -v.y),
+		glm::vec3(-v.z, 0.0f, v.x),
+		glm::vec3(v.y, -v.x, 0.0f));
+}
+
+static inline SpxSpatialVector operator+(const SpxSpatialVector& a, const SpxSpatialVector& b)
+{
+	return {a.angular + b.angular, a.linear + b.linear};
+}
+
+static inline SpxSpatialVector operator-(const SpxSpatialVector& a, const SpxSpatialVector& b)
+{
+	return {a.angular - b.angular, a.linear - b.linear};
+}
+
+static inline SpxSpatialVector operator*(const SpxSpatialMatrix& m, const SpxSpatialVector& v)
+{
+	return {m.m00 * v.angular + m.m01 * v.linear, m.m10 * v.angular + m.m11 * v.linear};
+}
+
+/**
+ * @brief 関節の運動 S q̇ を空間速度で表す(関節まわりの回転)
+ *
+ */
+static inline SpxSpatialVector SpxJointMotion(const glm::vec3& anchor, const glm::vec3& jointVelocity)
+{
+	return {jointVelocity, glm::cross(anchor, jointVelocity)};
+}
+
+/**
+ * @brief 空間速度と空間力の外積 v ×* f
+ *
+ */
+static inline SpxSpatialVector SpxCrossForce(const SpxSpatialVector& v, const SpxSpatialVector& f)
+{
+	return {
+		glm::cross(v.angular, f.angular) + glm::cross(v.linear, f.linear),
+		glm::cross(v.angular, f.linear)};
+}
+
+/**
+ * @brief 剛体の空間慣性をワールド座標系の原点まわりで求める
+ *
+ */
+static inline SpxSpatialMatrix SpxSpatialInertia(const SpxState& state, const SpxRigidBody& body)
+{
+	glm::mat3 orientation = glm::toMat3(state.m_orientation);
+	glm::mat3 worldInertia = orientation * body.m_inertia * glm::transpose(orientation);
+	glm::mat3 c = SpxCrossMatrix(state.m_position);
+	float m = body.m_mass;
+
+	return {
+		worldInertia - m * c * c, m * c,
+		-m * c, glm::mat3(m)};
+}
+
+/**
+ * @brief 空間行列の連立一次方程式 M x = b を解く(部分ピボット選択付きのガウスの消去法)
+ *
+ */
+static SpxSpatialVector SpxSolveSpatial(const SpxSpatialMatrix& matrix, const SpxSpatialVector& b)
+{
+	float a[6][7];
+	for (int row = 0; row < 3; row++)
+	{
+		for (int col = 0; col < 3; col++)
+		{
+			// glm は列優先なので [列][行]
+			a[row][col] = matrix.m00[col][row];
+			a[row][col + 3] = matrix.m01[col][row];
+			a[row + 3][col] = matrix.m10[col][row];
+			a[row + 3][col + 3] = matrix.m11[col][row];
+		}
+		a[row][6] = b.angular[row];
+		a[row + 3][6] = b.linear[row];
+	}
+
+	for (int i = 0; i < 6; i++)
+	{
+		int pivot = i;
+		for (int j = i + 1; j < 6; j++)
+		{
+			if (glm::abs(a[j][i]) > glm::abs(a[pivot][i])) { pivot = j; }
+		}
+		if (glm::abs(a[pivot][i]) < SPX_EPSILON) { return {glm::vec3(0.0f), glm::vec3(0.0f)}; }
+		if (pivot != i)
+		{
+			for (int k = i; k < 7; k++) { std::swap(a[i][k], a[pivot][k]); }
+		}
+
+		for (int j = i + 1; j < 6; j++)
+		{
+			float f = a[j][i] / a[i][i];
+			for (int k = i; k < 7; k++) { a[j][k] -= f * a[i][k]; }
+		}
+	}
+
+	float x[6];
+	for (int i = 5; i >= 0; i--)
+	{
+		float sum = a[i][6];
+		for (int k = i + 1; k < 6; k++) { sum -= a[i][k] * x[k]; }
+		x[i] = sum / a[i][i];
+	}
+
+	return {glm::vec3(x[0], x[1], x[2]), glm::vec3(x[3], x[4], x[5])};
+}
+
+/**
+ * @brief リンクが親との間に関節を持つかどうか(浮いている根元のリンクは関節を持たない)
+ *
+ */
+static inline bool SpxHasJoint(const SpxArticulation& articulation, SpxUInt32 i)
+{
+	return i > 0 || articulation.m_fixedBase;
+}
+
+/**
+ * @brief 関節の位置とリンクの空間速度を求める
+ *
+ */
+static void SpxComputeLinkVelocities(
+	const SpxArticulation& articulation,
+	const SpxState* states,
+	SpxArticulationWorkspace& ws)
+{
+	for (SpxUInt32 i = 0; i < articulation.m_numLinks; i++)
+	{
+		const SpxArticulationLink& link = articulation.m_links[i];
+		const glm::vec3& position = states[link.rigidBody].m_position;
+
+		if (!SpxHasJoint(articulation, i))
+		{
+			// 浮いている根元のリンクは自身の速度を持つ
+			const glm::vec3& omega = articulation.m_rootAngularVelocity;
+			ws.anchor[i] = position;
+			ws.velocity[i] = {omega, articulation.m_rootLinearVelocity - glm::cross(omega, position)};
+			ws.bias[i] = {glm::vec3(0.0f), glm::vec3(0.0f)};
+			continue;
+		}
+
+		SpxSpatialVector parentVelocity = {glm::vec3(0.0f), glm::vec3(0.0f)};
+		if (link.parent < 0)
+		{
+			ws.anchor[i] = articulation.m_baseAnchor;
+		}
+		else
+		{
+			const SpxState& parentState = states[articulation.m_links[link.parent].rigidBody];
+			ws.anchor[i] = parentState.m_position + parentState.m_orientation * link.anchorParent;
+			parentVelocity = ws.velocity[link.parent];
+		}
+
+		const glm::vec3& anchor = ws.anchor[i];
+		ws.velocity[i] = parentVelocity + SpxJointMotion(anchor, link.jointVelocity);
+
+		// 関節の位置は親と一緒に動くので、関節の運動の時間微分は (0, Ṗ × q̇) になる
+		glm::vec3 anchorVelocity = parentVelocity.linear + glm::cross(parentVelocity.angular, anchor);
+		ws.bias[i] = {glm::vec3(0.0f), glm::cross(anchorVelocity, link.jointVelocity)};
+	}
+}
+
+/**
+ * @brief リンクの空間速度を剛体の速度に書き込む
+ *
+ */
+static void SpxWriteLinkVelocities(
+	const SpxArticulation& articulation,
+	SpxState* states,
+	const SpxArticulationWorkspace& ws)
+{
+	for (SpxUInt32 i = 0; i < articulation.m_numLinks; i++)
+	{
+		SpxState& state = states[articulation.m_links[i].rigidBody];
+		const SpxSpatialVector& v = ws.velocity[i];
+		state.m_angularVelocity = v.angular;
+		state.m_linearVelocity = v.linear + glm::cross(v.angular, state.m_position);
+	}
+}
+
+/**
+ * @brief Articulated Body Algorithm の内向きと外向きのパス
+ * ws.inertia にリンクの空間慣性、ws.force にバイアス力を入れてから呼ぶ。
+ * 結果は ws.acceleration と ws.jointAcceleration に格納される。
+ *
+ */
+static void SpxSolveArticulatedBody(const SpxArticulation& articulation, SpxArticulationWorkspace& ws)
+{
+	// 先端から根元に向かって多関節体慣性を集める
+	for (SpxUInt32 i = articulation.m_numLinks; i-- > 0;)
+	{
+		if (!SpxHasJoint(articulation, i)) { continue; }
+
+		const SpxArticulationLink& link = articulation.m_links[i];
+		const glm::vec3& anchor = ws.anchor[i];
+		const SpxSpatialMatrix& inertia = ws.inertia[i];
+		const SpxSpatialVector& force = ws.force[i];
+
+		// 関節の運動部分空間 S = [1; [P]x]
+		glm::mat3 anchorCross = SpxCrossMatrix(anchor);
+		glm::mat3 uTop = inertia.m00 + inertia.m01 * anchorCross;
+		glm::mat3 uBottom = inertia.m10 + inertia.m11 * anchorCross;
+		glm::mat3 dInv = glm::inverse(uTop - anchorCross * uBottom);
+		glm::vec3 u = -(force.angular - glm::cross(anchor, force.linear));
+
+		ws.uTop[i] = uTop;
+		ws.uBottom[i] = uBottom;
+		ws.dInv[i] = dInv;
+		ws.u[i] = u;
+
+		if (link.parent < 0) { continue; }
+
+		// 関節の自由度を消去した慣性と力を親リンクに足し込む
+		glm::mat3 uTopDInv = uTop * dInv;
+		glm::mat3 uBottomDInv = uBottom * dInv;
+		SpxSpatialMatrix reduced = {
+			inertia.m00 - uTopDInv * glm::transpose(uTop), inertia.m01 - uTopDInv * glm::transpose(uBottom),
+			inertia.m10 - uBottomDInv * glm::transpose(uTop), inertia.m11 - uBottomDInv * glm::transpose(uBottom)};
+		SpxSpatialVector reducedForce = force + reduced * ws.bias[i] + SpxSpatialVector{uTopDInv * u, uBottomDInv * u};
+
+		SpxSpatialMatrix& parentInertia = ws.inertia[link.parent];
+		parentInertia.m00 += reduced.m00;
+		parentInertia.m01 += reduced.m01;
+		parentInertia.m10 += reduced.m10;
+		parentInertia.m11 += reduced.m11;
+		ws.force[link.parent] = ws.force[link.parent] + reducedForce;
+	}
+
+	// 根元から先端に向かって加速度を求める
+	for (SpxUInt32 i = 0; i < articulation.m_numLinks; i++)
+	{
+		if (!SpxHasJoint(articulation, i))
+		{
+			SpxSpatialVector rootAcceleration = SpxSolveSpatial(ws.inertia[i], ws.force[i]);
+			ws.acceleration[i] = {-rootAcceleration.angular, -rootAcceleration.linear};
+			ws.jointAcceleration[i] = glm::vec3(0.0f);
+			continue;
+		}
+
+		const SpxArticulationLink& link = articulation.m_links[i];
+		SpxSpatialVector acceleration = ws.bias[i];
+		if (link.parent >= 0)
+		{
+			acceleration = acceleration + ws.acceleration[link.parent];
+		}
+
+		glm::vec3 jointAcceleration = ws.dInv[i] *
+									  (ws.u[i] - (glm::transpose(ws.uTop[i]) * acceleration.angular +
+												  glm::transpose(ws.uBottom[i]) * acceleration.linear));
+
+		ws.acceleration[i] = acceleration + SpxJointMotion(ws.anchor[i], jointAcceleration);
+		ws.jointAcceleration[i] = jointAcceleration;
+	}
+}
+
+/**
+ * @brief 関節の拘束を無視して剛体の速度に加えられた変化を力積として多関節体に適用する
+ * 拘束ソルバーや ApplyImpulse によって変化したリンクの速度を関節空間に射影し直す。
+ *
+ */
+static void SpxAbsorbVelocityChanges(
+	SpxArticulation& articulation,
+	SpxState* states,
+	const SpxRigidBody* bodies,
+	SpxArticulationWorkspace& ws)
+{
+	SpxComputeLinkVelocities(articulation, states, ws);
+
+	for (SpxUInt32 i = 0; i < articulation.m_numLinks; i++)
+	{
+		SpxUInt32 rigidBody = articulation.m_links[i].rigidBody;
+		const SpxState& state = states[rigidBody];
+		const SpxRigidBody& body = bodies[rigidBody];
+		const SpxSpatialVector& v = ws.velocity[i];
+
+		// 速度の変化に質量を掛けて力積に戻す
+		glm::mat3 orientation = glm::toMat3(state.m_orientation);
+		glm::vec3 deltaAngularVelocity = state.m_angularVelocity - v.angular;
+		glm::vec3 deltaLinearVelocity =
+			state.m_linearVelocity - (v.linear + glm::cross(v.angular, state.m_position));
+		glm::vec3 linearImpulse = body.m_mass * deltaLinearVelocity;
+		glm::vec3 angularImpulse =
+			orientation * body.m_inertia * glm::transpose(orientation) * deltaAngularVelocity;
+
+		ws.inertia[i] = SpxSpatialInertia(state, body);
+		ws.force[i] = {
+			-(angularImpulse + glm::cross(state.m_position, linearImpulse)),
+			-linearImpulse};
+		ws.bias[i] = {glm::vec3(0.0f), glm::vec3(0.0f)};
+	}
+
+	// 力積に対する応答は、速度に依存する項を除いた順動力学と同じ式で求まる
+	SpxSolveArticulatedBody(articulation, ws);
+
+	for (SpxUInt32 i = 0; i < articulation.m_numLinks; i++)
+	{
+		if (SpxHasJoint(articulation, i))
+		{
+			articulation.m_links[i].jointVelocity += ws.jointAcceleration[i];
+			continue;
+		}
+
+		const glm::vec3& position = states[articulation.m_links[i].rigidBody].m_position;
+		const SpxSpatialVector& dv = ws.acceleration[i];
+		articulation.m_rootAngularVelocity += dv.angular;
+		articulation.m_rootLinearVelocity += dv.linear + glm::cross(dv.angular, position);
+	}
+}
+
+void SpxArticulationForwardDynamics(
+	SpxArticulation& articulation,
+	SpxState* states,
+	const SpxRigidBody* bodies,
+	const glm::vec3& gravity,
+	float timeStep)
+{
+	if (articulation.m_numLinks == 0) { return; }
+
+	SpxArticulationWorkspace ws;
+
+	// 前のステップから剛体に直接加えられた力積を取り込む
+	SpxAbsorbVelocityChanges(articulation, states, bodies, ws);
+
+	SpxComputeLinkVelocities(articulation, states, ws);
+	for (SpxUInt32 i = 0; i < articulation.m_numLinks; i++)
+	{
+		SpxUInt32 rigidBody = articulation.m_links[i].rigidBody;
+		const SpxState& state = states[rigidBody];
+		const SpxRigidBody& body = bodies[rigidBody];
+
+		ws.inertia[i] = SpxSpatialInertia(state, body);
+
+		// バイアス力 v ×* I v から重力を引く
+		glm::vec3 weight = body.m_mass * gravity;
+		SpxSpatialVector externalForce = {glm::cross(state.m_position, weight), weight};
+		ws.force[i] = SpxCrossForce(ws.velocity[i], ws.inertia[i] * ws.velocity[i]) - externalForce;
+	}
+
+	SpxSolveArticulatedBody(articulation, ws);
+
+	// 関節速度の更新(オイラー陽解法)
+	for (SpxUInt32 i = 0; i < articulation.m_numLinks; i++)
+	{
+		if (SpxHasJoint(articulation, i))
+		{
+			articulation.m_links[i].jointVelocity += ws.jointAcceleration[i] * timeStep;
+			continue;
+		}
+
+		const glm::vec3& position = states[articulation.m_links[i].rigidBody].m_position;
+		const SpxSpatialVector& a = ws.acceleration[i];
+		glm::vec3 angularVelocity = articulation.m_rootAngularVelocity + a.angular * timeStep;
+		glm::vec3 spatialLinearVelocity = articulation.m_rootLinearVelocity -
+										  glm::cross(articulation.m_rootAngularVelocity, position) +
+										  a.linear * timeStep;
+		articulation.m_rootAngularVelocity = angularVelocity;
+		articulation.m_rootLinearVelocity = spatialLinearVelocity + glm::cross(angularVelocity, position);
+	}
+
+	SpxComputeLinkVelocities(articulation, states, ws);
+	SpxWriteLinkVelocities(articulation, states, ws);
+}
+
+void SpxArticulationApplySolverImpulses(
+	SpxArticulation& articulation,
+	SpxState* states,
+	const SpxRigidBody* bodies)
+{
+	if (articulation.m_numLinks == 0) { return; }
+
+	SpxArticulationWorkspace ws;
+	SpxAbsorbVelocityChanges(articulation, states, bodies, ws);
+	SpxComputeLinkVelocities(articulation, states, ws);
+	SpxWriteLinkVelocities(articulation, states, ws);
+}
+
+void SpxArticulationIntegrate(
+	SpxArticulation& articulation,
+	SpxState* states,
+	float timeStep)
+{
+	if (articulation.m_numLinks == 0) { return; }
+
+	glm::vec3 angularVelocity[SPX_ARTICULATION_MAX_LINKS];
+
+	for (SpxUInt32 i = 0; i < articulation.m_numLinks; i++)
+	{
+		const SpxArticulationLink& link = articulation.m_links[i];
+		SpxState& state = states[link.rigidBody];
+
+		if (!SpxHasJoint(articulation, i))
+		{
+			angularVelocity[i] = articulation.m_rootAngularVelocity;
+			state.m_position += articulation.m_rootLinearVelocity * timeStep;
+		}
+		else
+		{
+			angularVelocity[i] = link.jointVelocity;
+			if (link.parent >= 0) { angularVelocity[i] += angularVelocity[link.parent]; }
+		}
+
+		// 姿勢の更新(クォータニオンの時間積分)
+		state.m_orientation = SpxIntegrateOrientation(state.m_orientation, angularVelocity[i], timeStep);
+
+		if (!SpxHasJoint(articulation, i)) { continue; }
+
+		// 関節の位置から重心の位置を求め直す
+		glm::vec3 anchor = articulation.m_baseAnchor;
+		if (link.parent >= 0)
+		{
+			const SpxState& parentState = states[articulation.m_links[link.parent].rigidBody];
+			anchor = parentState.m_position + parentState.m_orientation * link.anchorParent;
+		}
+		state.m_position = anchor - state.m_orientation * link.anchorChild;
+	}
+
+	// 位置が変わったので空間速度を求め直して剛体に書き込む
+	SpxArticulationWorkspace ws;
+	SpxComputeLinkVelocities(articulation, states, ws);
+	SpxWriteLinkVelocities(articulation, states, ws);
+}
+
+};	// namespace SimplePhysics
\ No newline at end of file
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "../SpxBase.h"
+#include "../elements/SpxState.h"
+#include "../elements/SpxRigidBody.h"
+#include "../elements/SpxArticulation.h"
+
+namespace SimplePhysics
+{
+
+/**
+ * @brief 多関節体の順動力学を解き、重力による関節速度の変化を求める
+ * Featherstone の Articulated Body Algorithm により O(n) で計算する。
+ * 結果はリンクの剛体の速度にも書き込まれる。
+ *
+ * @param articulation 多関節体
+ * @param states 剛体の状態の配列
+ * @param bodies 剛体の属性の配列
+ * @param gravity 重力加速度
+ * @param timeStep タイムステップ
+ */
+void SpxArticulationForwardDynamics(
+	SpxArticulation& articulation,
+	SpxState* states,
+	const SpxRigidBody* bodies,
+	const glm::vec3& gravity,
+	float timeStep);
+
+/**
+ * @brief 拘束ソルバーがリンクの剛体に与えた速度の変化を力積に戻し、多関節体に適用する
+ * 拘束ソルバーはリンクを独立した剛体として扱うので、この関数で関節の拘束を満たす速度に射影し直す。
+ *
+ * @param articulation 多関節体
+ * @param states 剛体の状態の配列
+ * @param bodies 剛体の属性の配列
+ */
+void SpxArticulationApplySolverImpulses(
+	SpxArticulation& articulation,
+	SpxState* states,
+	const SpxRigidBody* bodies);
+
+/**
+ * @brief 多関節体の位置と姿勢を更新する
+ * 各リンクの位置は関節の位置から計算し直されるので、関節がずれることはない。
+ *
+ * @param articulation 多関節体
+ * @param states 剛体の状態の配列
+ * @param timeStep タイムステップ
+ */
+void SpxArticulationIntegrate(
+	SpxArticulation& articulation,
+	SpxState* states,
+	float timeStep);
+
+};	// namespace SimplePhysics
\ No newline at end of file
@@ -7,8 +7,6 @@
 
 namespace SimplePhysics
 {
-const float SPX_AABB_EXPAND = 0.01f;
-
 static inline bool SpxIntersectAABB(
 	const glm::vec3& centerA,
 	const glm::vec3& halfA,
@@ -25,9 +23,9 @@ static inline bool SpxIntersectAABB(
 	return true;
 }
 
-void SpxBroadPhase(
+bool SpxBroadPhase(
 	const SpxState* states,
-	const SpxCollidable* collidables,
+	const SpxAabb* aabbs,
 	SpxUInt32 numRigidBodies,
 	const SpxPair* oldPairs,
 	const SpxUInt32 numOldPairs,
@@ -35,45 +33,37 @@ void SpxBroadPhase(
 	SpxUInt32& numNewPairs,
 	const SpxUInt32 maxPairs,
 	SpxAllocator* allocator,
+	SpxContactPool* contactPool,
 	void* userData,
 	SpxBroadPhaseCallback callback)
 {
 	assert(states);
-	assert(collidables);
+	assert(aabbs);
 	assert(oldPairs);
 	assert(newPairs);
 	assert(allocator);
+	assert(contactPool);
 
 	numNewPairs = 0;
+	SpxUInt32 numFoundPairs = 0;
 
 	// AABB交差ペアを見つける（総当たり）
 	for (SpxUInt32 i = 0; i < numRigidBodies; i++)
 	{
 		for (SpxUInt32 j = i + 1; j < numRigidBodies; j++)
 		{
-			const SpxState& stateA = states[i];
-			const SpxCollidable& collidableA = collidables[i];
-			const SpxState& stateB = states[j];
-			const SpxCollidable& collidableB = collidables[j];
-
 			if (callback && !callback(i, j, userData))
 			{
 				continue;
 			}
 
-			// 2つの剛体のAABBを作成
-
-			glm::mat3 orientationA(stateA.m_orientation);
-			glm::vec3 centerA = stateA.m_position + orientationA * collidableA.m_center;
-			glm::vec3 halfA = GLMExtension::AbsPerElem(orientationA) * (collidableA.m_half + glm::vec3(SPX_AABB_EXPAND));  // AABBサイズを若干拡張
-
-			glm::mat3 orientationB(stateB.m_orientation);
-			glm::vec3 centerB = stateB.m_position + orientationB * collidableB.m_center;
-			glm::vec3 halfB = GLMExtension::AbsPerElem(orientationB) * (collidableB.m_half + glm::vec3(SPX_AABB_EXPAND));  // AABBサイズを若干拡張
-
 			// 2つのAABBの衝突判定
-			if (SpxIntersectAABB(centerA, halfA, centerB, halfB) && numNewPairs < maxPairs)
+			// AABBは位置更新のときに計算済み
+			if (SpxIntersectAABB(aabbs[i].m_center, aabbs[i].m_half, aabbs[j].m_center, aabbs[j].m_half))
 			{
+				// 格納しきれない場合も数だけは数えておく
+				if (numFoundPairs++ >= maxPairs) { continue; }
+
 				SpxPair& newPair = newPairs[numNewPairs++];
 
 				// インデックスの登録の順番は重要。なぜなら、この2つの数値を元にして作られた数値で
@@ -83,11 +73,19 @@ void SpxBroadPhase(
 					i < j ? i : j;	// Aには小さい方をセット
 				newPair.rigidBodyB =
 					i < j ? j : i;	// Bには大きい方をセット
-				newPair.contact = NULL;
+				newPair.contact = SPX_INVALID_CONTACT;
 			}
 		}
 	}
 
+	// ペアを取りこぼさないように、呼び出し側で配列を拡張してやり直してもらう
+	// ここまでは前のフレームのペアや衝突情報に手を付けていない
+	if (numFoundPairs > maxPairs)
+	{
+		numNewPairs = numFoundPairs;
+		return false;
+	}
+
 	// ソート
 	{
 		SpxPair* sortBuff = (SpxPair*)allocator->allocate(sizeof(SpxPair) * numNewPairs);
@@ -118,7 +116,7 @@ void SpxBroadPhase(
 			// ->
 			// 前のフレームのそのインデックスにおけるペアはすでに衝突していない
 			// remove
-			allocator->deallocate(oldPairs[oldId].contact);
+			contactPool->deallocate(oldPairs[oldId].contact);
 			oldId++;
 		}
 		else if (newPairs[newId].key == oldPairs[oldId].key) {
@@ -153,21 +151,23 @@ void SpxBroadPhase(
 		// all remove
 		for (; oldId < numOldPairs; oldId++)
 		{
-			allocator->deallocate(oldPairs[oldId].contact);
+			contactPool->deallocate(oldPairs[oldId].contact);
 		}
 	}
 
 	// ~~~~~ 新規衝突ペアの衝突点の情報をリセット ~~~~~
 	for (SpxUInt32 i = 0; i < nNew; i++)
 	{
-		outNewPairs[i].contact = (SpxContact*)allocator->allocate(sizeof(SpxContact));
-		outNewPairs[i].contact->Reset();
+		// 消えたペアの衝突情報は解放済みなので、プールが空になることはない
+		outNewPairs[i].contact = contactPool->allocate();
+		assert(outNewPairs[i].contact != SPX_INVALID_CONTACT);
+		(*contactPool)[outNewPairs[i].contact].Reset();
 	}
 
 	// ~~~~~ 継続して衝突しているペアの状態を更新 ~~~~~
 	for (SpxUInt32 i = 0; i < nKeep; i++)
 	{
-		outKeepPairs[i].contact->Refresh(
+		(*contactPool)[outKeepPairs[i].contact].Refresh(
 			states[outKeepPairs[i].rigidBodyA].m_position,
 			states[outKeepPairs[i].rigidBodyA].m_orientation,
 			states[outKeepPairs[i].rigidBodyB].m_position,
@@ -198,6 +198,8 @@ void SpxBroadPhase(
 		SpxSort<SpxPair>(newPairs, sortBuff, numNewPairs);
 		allocator->deallocate(sortBuff);
 	}
+
+	return true;
 }
 
 };	// namespace SimplePhysics
\ No newline at end of file
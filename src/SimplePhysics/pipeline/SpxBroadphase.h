@@ -2,9 +2,10 @@
 
 #include "../SpxBase.h"
 #include "../elements/SpxState.h"
-#include "../elements/SpxCollidable.h"
+#include "../elements/SpxAabb.h"
 #include "../elements/SpxPair.h"
 #include "SpxAllocator.h"
+#include "SpxContactPool.h"
 
 #include <functional>
 
@@ -20,20 +21,23 @@ namespace SimplePhysics
 	 * @brief ブロードフェーズ
 	 *
 	 * @param state 剛体の状態の配列
-	 * @param collidables 剛体の形状の配列
+	 * @param aabbs 剛体のワールド座標系の AABB の配列(位置更新のときに計算されたもの)
 	 * @param numRigidBodies 剛体の数
 	 * @param oldPairs 前のフレームのペア
 	 * @param numOldPairs 前のフレームのペア数
 	 * @param[out] newPairs 新規に検出されたペア
 	 * @param[out] numNewPairs 新規に検出されたペア数
 	 * @param maxPairs 検出ペアの最大数
-	 * @param allocator アロケータ
+	 * @param allocator 作業領域のためのアロケータ
+	 * @param contactPool 衝突情報のプール(新規ペアの確保と消えたペアの解放を行う)
 	 * @param userData コールバック時に渡されるユーザーデータ
 	 * @param callback コールバック
+	 * @return bool 検出したペアを全て newPairs に格納できたら true。
+	 * maxPairs を超えた場合は何も変更せずに false を戻し、numNewPairs に必要なペア数を入れる。
 	 */
-	void SpxBroadPhase(
+	bool SpxBroadPhase(
 		const SpxState* states,
-		const SpxCollidable* collidables,
+		const SpxAabb* aabbs,
 		SpxUInt32 numRigidBodies,
 		const SpxPair* oldPairs,
 		const SpxUInt32 numOldPairs,
@@ -41,6 +45,7 @@ namespace SimplePhysics
 		SpxUInt32& numNewPairs,
 		const SpxUInt32 maxPairs,
 		SpxAllocator* allocator,
+		SpxContactPool* contactPool,
 		void* userData,
 		SpxBroadPhaseCallback callback = nullptr);
 
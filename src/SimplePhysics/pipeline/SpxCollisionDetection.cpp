@@ -7,20 +7,44 @@ namespace SimplePhysics
 void SpxDetectCollision(
 	const SpxState* states,
 	const SpxCollidable* collidables,
+	const SpxConvexMesh* convexMeshes,
 	SpxUInt32 numRigidBodies,
 	const SpxPair* pairs,
-	SpxUInt32 numPairs)
+	SpxUInt32 numPairs,
+	SpxContact* contacts,
+	float timeStep,
+	SpxUInt32 keepPairInterval,
+	SpxUInt32 phase)
 {
 	// 全てのペアに対して調査
 	for (SpxUInt32 i = 0; i < numPairs; i++)
 	{
 		const SpxPair& pair = pairs[i];
+		SpxContact& contact = contacts[pair.contact];
+
+		// 継続しているペアの衝突検出を間引く
+		// 間引くペアが1つのステップに偏らないように、剛体のインデックスでずらす
+		if (keepPairInterval > 1 &&
+			pair.type == SpxPairTypeKeep &&
+			contact.m_numContacts > 0 &&
+			(pair.rigidBodyA + pair.rigidBodyB + phase) % keepPairInterval != 0)
+		{
+			continue;
+		}
 
 		const SpxState& stateA = states[pair.rigidBodyA];
 		const SpxState& stateB = states[pair.rigidBodyB];
 		const SpxCollidable& collA = collidables[pair.rigidBodyA];
 		const SpxCollidable& collB = collidables[pair.rigidBodyB];
 
+		// このステップの間に近づきうる距離
+		// 並進による分と、剛体を囲む球の回転による分を合わせる
+		float radiusA = glm::length(collA.m_center) + glm::length(collA.m_half);
+		float radiusB = glm::length(collB.m_center) + glm::length(collB.m_half);
+		float maxSeparation = timeStep * (glm::length(stateA.m_linearVelocity - stateB.m_linearVelocity) +
+										  glm::length(stateA.m_angularVelocity) * radiusA +
+										  glm::length(stateB.m_angularVelocity) * radiusB);
+
 		// 3行4列のワールド変換行列を作る
 		glm::mat4x3 transformA = GLMExtension::To3x4TransformMat(stateA.m_orientation, stateA.m_position);
 		glm::mat4x3 transformB = GLMExtension::To3x4TransformMat(stateB.m_orientation, stateB.m_position);
@@ -46,11 +70,11 @@ void SpxDetectCollision(
 
 				// 凸メッシュ同士の衝突検出を行う
 				if (SpxConvexConvexContact(
-						shapeA.m_geometry, worldTransformA,
-						shapeB.m_geometry, worldTransformB,
-						normal, penetrationDepth,
+						convexMeshes[shapeA.m_geometry], worldTransformA, shapeA.m_scale,
+						convexMeshes[shapeB.m_geometry], worldTransformB, shapeB.m_scale,
+						maxSeparation, normal, penetrationDepth,
 						contactPointA, contactPointB) &&
-					penetrationDepth < 0.0f)
+					penetrationDepth < maxSeparation)
 				{
 					glm::vec3 contactPointA_localA = GLMExtension::GetTranslation(offsetTransformA) +
 													 glm::mat3(offsetTransformA) * contactPointA;
@@ -58,7 +82,7 @@ void SpxDetectCollision(
 													 glm::mat3(offsetTransformB) * contactPointB;
 
 					// 衝突点を剛体の座標系に変換して新しく衝突点として追加する
-					pair.contact->AddContact(
+					contact.AddContact(
 						penetrationDepth, normal,
 						contactPointA_localA,
 						contactPointB_localB);
@@ -9,17 +9,32 @@ namespace SimplePhysics
 {
 	/**
 	 * @brief 衝突検出のナローフェーズ
+	 * このステップの間に接触しうる距離(相対速度 * timeStep)まで近づいているペアには、
+	 * 正の貫通深度を持つ投機的な衝突点を作る。ソルバーはその距離を詰める分の速度だけを許すので、
+	 * 速い剛体が1ステップで薄い剛体をすり抜けることがなくなる。
 	 *
 	 * @param states 剛体の状態の配列
 	 * @param collidables 剛体の形状の配列
+	 * @param convexMeshes 形状が参照する凸メッシュの配列
 	 * @param numRigidBodies 剛体の数
 	 * @param pairs ペア配列
 	 * @param numPairs ペア数
+	 * @param contacts 衝突情報の配列(ペアが持つインデックスで参照する)
+	 * @param timeStep タイムステップ(投機的な衝突点を作る距離の計算に使う。0ならば作らない)
+	 * @param keepPairInterval 継続しているペアの衝突検出を行う間隔(ステップ数)。
+	 * 衝突点が残っている継続ペアは、この間隔のうち1回だけ衝突検出を行い、それ以外のステップでは
+	 * ブロードフェーズでリフレッシュした衝突点をそのまま使う。1ならば全てのペアで毎回行う
+	 * @param phase 間引くペアをステップごとにずらすための値(経過フレームなど)
 	 */
 	void SpxDetectCollision(
 		const SpxState* states,
 		const SpxCollidable* collidables,
+		const SpxConvexMesh* convexMeshes,
 		SpxUInt32 numRigidBodies,
 		const SpxPair* pairs,
-		SpxUInt32 numPairs);
+		SpxUInt32 numPairs,
+		SpxContact* contacts,
+		float timeStep,
+		SpxUInt32 keepPairInterval = 1,
+		SpxUInt32 phase = 0);
 };	// namespace SimplePhysics
\ No newline at end of file
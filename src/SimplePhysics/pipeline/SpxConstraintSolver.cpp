@@ -1,34 +1,98 @@
 #include "SpxConstraintSolver.h"
 #include "../elements/SpxSloverBody.h"
+#include "../elements/SpxSolverRow.h"
 #include "../collision/SpxVectorFunction.h"
 #include "../glmExtension.h"
 
-#include <glm/gtx/transform.hpp>
-
 namespace SimplePhysics
 {
 
-void SpxSolveConstraints(
-	SpxState* states,
+/**
+ * @brief 拘束軸と衝突点からヤコビアンを展開して拘束に格納する
+ *
+ * @param row 拘束
+ * @param axis 拘束軸(ワールド座標系)
+ * @param rA 剛体Aの重心から作用点へのベクトル
+ * @param rB 剛体Bの重心から作用点へのベクトル
+ * @param solverBodyA ソルバーボディA
+ * @param solverBodyB ソルバーボディB
+ */
+static inline void SpxSetupSolverRow(
+	SpxSolverRow& row,
+	const glm::vec3& axis,
+	const glm::vec3& rA,
+	const glm::vec3& rB,
+	const SpxSolverBody& solverBodyA,
+	const SpxSolverBody& solverBodyB)
+{
+	row.linear = axis;
+	row.angularA = cross(rA, axis);
+	row.angularB = cross(rB, axis);
+	row.inertiaInvAngularA = solverBodyA.inertiaInv * row.angularA;
+	row.inertiaInvAngularB = solverBodyB.inertiaInv * row.angularB;
+
+	// 拘束力の分母 J M^-1 J^T
+	float denom = (solverBodyA.massInv + solverBodyB.massInv) +
+				  glm::dot(row.angularA, row.inertiaInvAngularA) +
+				  glm::dot(row.angularB, row.inertiaInvAngularB);
+	row.jacDiagInv = 1.0f / denom;
+}
+
+/**
+ * @brief 拘束力をソルバーボディの速度の差分に反映する
+ *
+ */
+static inline void SpxApplySolverRowImpulse(
+	const SpxSolverRow& row,
+	float impulse,
+	SpxSolverBody& solverBodyA,
+	SpxSolverBody& solverBodyB)
+{
+	solverBodyA.deltaLinearVelocity += (impulse * solverBodyA.massInv) * row.linear;
+	solverBodyA.deltaAngularVelocity += impulse * row.inertiaInvAngularA;
+	solverBodyB.deltaLinearVelocity -= (impulse * solverBodyB.massInv) * row.linear;
+	solverBodyB.deltaAngularVelocity -= impulse * row.inertiaInvAngularB;
+}
+
+/**
+ * @brief 拘束を1回分解く
+ *
+ */
+static inline void SpxSolveRow(
+	SpxSolverRow& row,
+	SpxSolverBody& solverBodyA,
+	SpxSolverBody& solverBodyB)
+{
+	// 拘束軸方向の相対速度の差分 J・Δv
+	float relativeVelocity =
+		glm::dot(row.linear, solverBodyA.deltaLinearVelocity - solverBodyB.deltaLinearVelocity) +
+		glm::dot(row.angularA, solverBodyA.deltaAngularVelocity) -
+		glm::dot(row.angularB, solverBodyB.deltaAngularVelocity);
+
+	// 拘束力の計算
+	float deltaImpulse = row.rhs - row.jacDiagInv * relativeVelocity;
+	float oldImpulse = row.accumImpulse;
+	row.accumImpulse = glm::clamp(oldImpulse + deltaImpulse, row.lowerLimit, row.upperLimit);
+	deltaImpulse = row.accumImpulse - oldImpulse;
+
+	// 求めた拘束力から並進速度、回転速度を更新
+	SpxApplySolverRowImpulse(row, deltaImpulse, solverBodyA, solverBodyB);
+}
+
+/**
+ * @brief ソルバーボディにパラメータをセットする
+ *
+ */
+static void SpxSetupSolverBodies(
+	const SpxState* states,
 	const SpxRigidBody* bodies,
 	SpxUInt32 numRigidBodies,
-	const SpxPair* pairs,
-	SpxUInt32 numPairs,
-	SpxBallJoint* joints,
-	SpxUInt32 numJoints,
-	SpxUInt32 iteration,
-	float bias,
-	float slop,
-	float timeStep,
-	SpxAllocator* allocator)
+	SpxSolverBody* solverBodies)
 {
-	// ソルバー用プロキシを作成
-	SpxSolverBody* solverBodies = (SpxSolverBody*)allocator->allocate(sizeof(SpxSolverBody) * numRigidBodies);
-
 	// ソルバーボディにパラメータをセットしていく
 	for (SpxUInt32 i = 0; i < numRigidBodies; i++)
 	{
-		SpxState& state = states[i];
+		const SpxState& state = states[i];
 		const SpxRigidBody& body = bodies[i];
 		SpxSolverBody& solverBody = solverBodies[i];
 
@@ -44,12 +108,331 @@ void SpxSolveConstraints(
 			solverBody.inertiaInv = glm::mat3(0.0f);
 		}
 		else {
-			solverBody.massInv = 1.0f / body.m_mass;
+			solverBody.massInv = body.m_massInv;
 			glm::mat3 m = glm::toMat3(solverBody.orientation);
 			// 慣性テンソルの逆行列(回転させる)
-			solverBody.inertiaInv = m * inverse(body.m_inertia) * transpose(m);
+			solverBody.inertiaInv = m * body.m_inertiaInv * transpose(m);
 		}
 	}
+}
+
+/**
+ * @brief 蓄積された拘束力をジョイントと衝突点に書き戻す
+ *
+ */
+static void SpxStoreImpulses(
+	const SpxSolverJoint* solverJoints,
+	SpxUInt32 numJoints,
+	const SpxSolverContactPoint* solverContacts,
+	SpxUInt32 numContactPoints)
+{
+	for (SpxUInt32 i = 0; i < numJoints; i++)
+	{
+		SpxBallJoint& joint = *solverJoints[i].joint;
+		const SpxSolverRow& row = solverJoints[i].row;
+		joint.constraint.axis = row.linear;
+		joint.constraint.jacDiagInv = row.jacDiagInv;
+		joint.constraint.rhs = row.rhs;
+		joint.constraint.lowerLimit = row.lowerLimit;
+		joint.constraint.upperLimit = row.upperLimit;
+		joint.constraint.accumImpulse = row.accumImpulse;
+	}
+
+	for (SpxUInt32 i = 0; i < numContactPoints; i++)
+	{
+		SpxContactPoint& cp = *solverContacts[i].contactPoint;
+		for (SpxUInt32 k = 0; k < 3; k++)
+		{
+			const SpxSolverRow& row = solverContacts[i].rows[k];
+			cp.constraints[k].axis = row.linear;
+			cp.constraints[k].jacDiagInv = row.jacDiagInv;
+			cp.constraints[k].rhs = row.rhs;
+			cp.constraints[k].lowerLimit = row.lowerLimit;
+			cp.constraints[k].upperLimit = row.upperLimit;
+			cp.constraints[k].accumImpulse = row.accumImpulse;
+		}
+	}
+}
+
+/**
+ * @brief 衝突の拘束の数を数える
+ *
+ */
+static SpxUInt32 SpxCountContactPoints(const SpxPair* pairs, SpxUInt32 numPairs, const SpxContact* contacts)
+{
+	SpxUInt32 numContactPoints = 0;
+	for (SpxUInt32 i = 0; i < numPairs; i++)
+	{
+		numContactPoints += contacts[pairs[i].contact].m_numContacts;
+	}
+	return numContactPoints;
+}
+
+// ブロックソルバーで離れていくとみなす相対速度の許容誤差
+// 面で接している場合は解が一意に決まらないため、丸め誤差で解を捨てないようにする
+const float SPX_BLOCK_SOLVER_TOLERANCE = 1e-4f;
+
+/**
+ * @brief 1つのペアの法線方向の拘束同士の連成行列を求める
+ *
+ */
+static void SpxSetupSolverManifold(
+	SpxSolverManifold& manifold,
+	SpxUInt32 firstContact,
+	SpxUInt32 numContacts,
+	const SpxSolverContactPoint* solverContacts,
+	const SpxSolverBody& solverBodyA,
+	const SpxSolverBody& solverBodyB)
+{
+	manifold.firstContact = firstContact;
+	manifold.numContacts = numContacts;
+
+	for (SpxUInt32 i = 0; i < numContacts; i++)
+	{
+		const SpxSolverRow& rowI = solverContacts[firstContact + i].rows[0];
+		for (SpxUInt32 j = 0; j < numContacts; j++)
+		{
+			const SpxSolverRow& rowJ = solverContacts[firstContact + j].rows[0];
+			manifold.K[i][j] = (solverBodyA.massInv + solverBodyB.massInv) * glm::dot(rowI.linear, rowJ.linear) +
+							   glm::dot(rowI.angularA, rowJ.inertiaInvAngularA) +
+							   glm::dot(rowI.angularB, rowJ.inertiaInvAngularB);
+		}
+	}
+}
+
+/**
+ * @brief 小さな連立一次方程式を解く(部分ピボット選択付きのガウスの消去法)
+ *
+ * @param M 係数行列(中身は破壊される)
+ * @param x 右辺ベクトル(解が格納される)
+ * @param n 方程式の数
+ * @return 係数行列が特異だった場合は false
+ */
+static bool SpxSolveLinearSystem(float M[SPX_NUM_CONTACTS][SPX_NUM_CONTACTS], float x[SPX_NUM_CONTACTS], int n)
+{
+	float scale = 0.0f;
+	for (int i = 0; i < n; i++)
+	{
+		scale = glm::max(scale, glm::abs(M[i][i]));
+	}
+
+	for (int c = 0; c < n; c++)
+	{
+		int pivot = c;
+		for (int r = c + 1; r < n; r++)
+		{
+			if (glm::abs(M[r][c]) > glm::abs(M[pivot][c])) { pivot = r; }
+		}
+
+		// 面で接している4点の拘束は一次従属になるので、ここで弾かれる
+		if (glm::abs(M[pivot][c]) <= SPX_EPSILON * scale) { return false; }
+
+		if (pivot != c)
+		{
+			for (int k = 0; k < n; k++)
+			{
+				float tmp = M[c][k];
+				M[c][k] = M[pivot][k];
+				M[pivot][k] = tmp;
+			}
+			float tmp = x[c];
+			x[c] = x[pivot];
+			x[pivot] = tmp;
+		}
+
+		for (int r = c + 1; r < n; r++)
+		{
+			float f = M[r][c] / M[c][c];
+			for (int k = c; k < n; k++)
+			{
+				M[r][k] -= f * M[c][k];
+			}
+			x[r] -= f * x[c];
+		}
+	}
+
+	for (int r = n - 1; r >= 0; r--)
+	{
+		for (int k = r + 1; k < n; k++)
+		{
+			x[r] -= M[r][k] * x[k];
+		}
+		x[r] /= M[r][r];
+	}
+
+	return true;
+}
+
+/**
+ * @brief 1つのペアの法線方向の拘束を小さな LCP としてまとめて解く
+ * 能動集合(拘束力が働く衝突点の組み合わせ)を、衝突点が多いものから順に全て試す。
+ *
+ * w = K x + q, x >= 0, w >= 0, x・w = 0
+ *
+ * @return 解が見つからなかった場合は false
+ */
+static bool SpxSolveNormalBlock(
+	const SpxSolverManifold& manifold,
+	SpxSolverContactPoint* contacts,
+	SpxSolverBody& solverBodyA,
+	SpxSolverBody& solverBodyB)
+{
+	const int n = manifold.numContacts;
+
+	// 現在の拘束力 a と、拘束速度の誤差から K a を除いたもの q を求める
+	float a[SPX_NUM_CONTACTS];
+	float q[SPX_NUM_CONTACTS];
+	for (int i = 0; i < n; i++)
+	{
+		const SpxSolverRow& row = contacts[i].rows[0];
+		float relativeVelocity =
+			glm::dot(row.linear, solverBodyA.deltaLinearVelocity - solverBodyB.deltaLinearVelocity) +
+			glm::dot(row.angularA, solverBodyA.deltaAngularVelocity) -
+			glm::dot(row.angularB, solverBodyB.deltaAngularVelocity);
+		a[i] = row.accumImpulse;
+		// rhs は jacDiagInv * 目標速度 なので、目標速度に戻してから引く
+		q[i] = relativeVelocity - row.rhs / row.jacDiagInv;
+	}
+	for (int i = 0; i < n; i++)
+	{
+		for (int j = 0; j < n; j++)
+		{
+			q[i] -= manifold.K[i][j] * a[j];
+		}
+	}
+
+	float x[SPX_NUM_CONTACTS];
+	bool found = false;
+	for (int size = n; size >= 0 && !found; size--)
+	{
+		for (int mask = 0; mask < (1 << n) && !found; mask++)
+		{
+			int index[SPX_NUM_CONTACTS];
+			int m = 0;
+			for (int i = 0; i < n; i++)
+			{
+				if (mask & (1 << i)) { index[m++] = i; }
+			}
+			if (m != size) { continue; }
+
+			// 能動集合の中だけで K_SS x_S = -q_S を解く
+			float M[SPX_NUM_CONTACTS][SPX_NUM_CONTACTS];
+			float xs[SPX_NUM_CONTACTS];
+			for (int i = 0; i < m; i++)
+			{
+				for (int j = 0; j < m; j++)
+				{
+					M[i][j] = manifold.K[index[i]][index[j]];
+				}
+				xs[i] = -q[index[i]];
+			}
+			if (!SpxSolveLinearSystem(M, xs, m)) { continue; }
+
+			bool valid = true;
+			for (int i = 0; i < n; i++) { x[i] = 0.0f; }
+			for (int i = 0; i < m && valid; i++)
+			{
+				valid = xs[i] >= 0.0f;
+				x[index[i]] = xs[i];
+			}
+
+			// 能動集合に含まれない衝突点は離れていく(w >= 0)こと
+			for (int i = 0; i < n && valid; i++)
+			{
+				if (mask & (1 << i)) { continue; }
+				float w = q[i];
+				for (int j = 0; j < m; j++)
+				{
+					w += manifold.K[i][index[j]] * xs[j];
+				}
+				valid = w >= -SPX_BLOCK_SOLVER_TOLERANCE;
+			}
+
+			found = valid;
+		}
+	}
+
+	if (!found) { return false; }
+
+	for (int i = 0; i < n; i++)
+	{
+		SpxSolverRow& row = contacts[i].rows[0];
+		float deltaImpulse = x[i] - a[i];
+		row.accumImpulse = x[i];
+		SpxApplySolverRowImpulse(row, deltaImpulse, solverBodyA, solverBodyB);
+	}
+
+	return true;
+}
+
+/**
+ * @brief 1つのペアの拘束を解く
+ * 法線方向はまとめて解き、摩擦方向は衝突点ごとに逐次的に解く。
+ *
+ */
+static void SpxSolveManifold(
+	const SpxSolverManifold& manifold,
+	SpxSolverContactPoint* solverContacts,
+	SpxSolverBody* solverBodies)
+{
+	if (manifold.numContacts == 0) { return; }
+
+	SpxSolverContactPoint* contacts = solverContacts + manifold.firstContact;
+	SpxSolverBody& solverBodyA = solverBodies[contacts[0].rigidBodyA];
+	SpxSolverBody& solverBodyB = solverBodies[contacts[0].rigidBodyB];
+
+	// 衝突点が1つだけの場合や、解が見つからなかった場合は逐次的に解く
+	if (manifold.numContacts == 1 || !SpxSolveNormalBlock(manifold, contacts, solverBodyA, solverBodyB))
+	{
+		for (SpxUInt32 i = 0; i < manifold.numContacts; i++)
+		{
+			SpxSolveRow(contacts[i].rows[0], solverBodyA, solverBodyB);
+		}
+	}
+
+	for (SpxUInt32 i = 0; i < manifold.numContacts; i++)
+	{
+		SpxSolverContactPoint& solverContact = contacts[i];
+
+		// 摩擦力の最大値は (動)摩擦係数 * 垂直抗力
+		float maxFriction = solverContact.friction * glm::abs(solverContact.rows[0].accumImpulse);
+		solverContact.rows[1].lowerLimit = -maxFriction;
+		solverContact.rows[1].upperLimit = maxFriction;
+		solverContact.rows[2].lowerLimit = -maxFriction;
+		solverContact.rows[2].upperLimit = maxFriction;
+
+		SpxSolveRow(solverContact.rows[1], solverBodyA, solverBodyB);
+		SpxSolveRow(solverContact.rows[2], solverBodyA, solverBodyB);
+	}
+}
+
+void SpxSolveConstraints(
+	SpxState* states,
+	const SpxRigidBody* bodies,
+	SpxUInt32 numRigidBodies,
+	const SpxPair* pairs,
+	SpxUInt32 numPairs,
+	SpxContact* contacts,
+	SpxBallJoint* joints,
+	SpxUInt32 numJoints,
+	SpxUInt32 iteration,
+	float bias,
+	float slop,
+	float timeStep,
+	SpxAllocator* allocator,
+	bool useBlockSolver)
+{
+	// ソルバー用プロキシを作成
+	SpxSolverBody* solverBodies = (SpxSolverBody*)allocator->allocate(sizeof(SpxSolverBody) * numRigidBodies);
+	SpxSetupSolverBodies(states, bodies, numRigidBodies, solverBodies);
+
+	// 拘束の数を数える
+	SpxUInt32 numContactPoints = SpxCountContactPoints(pairs, numPairs, contacts);
+
+	// ヤコビアンを展開した拘束の配列を作成
+	SpxSolverJoint* solverJoints = (SpxSolverJoint*)allocator->allocate(sizeof(SpxSolverJoint) * numJoints);
+	SpxSolverContactPoint* solverContacts = (SpxSolverContactPoint*)allocator->allocate(sizeof(SpxSolverContactPoint) * numContactPoints);
+	SpxSolverManifold* solverManifolds = useBlockSolver ? (SpxSolverManifold*)allocator->allocate(sizeof(SpxSolverManifold) * numPairs) : nullptr;
 
 	// 拘束のセットアップ(ボールジョイント)。
 	for (SpxUInt32 i = 0; i < numJoints; i++)
@@ -64,6 +447,11 @@ void SpxSolveConstraints(
 		//const SpxRigidBody& bodyB = bodies[joint.rigidBodyB];
 		SpxSolverBody& solverBodyB = solverBodies[joint.rigidBodyB];
 
+		SpxSolverJoint& solverJoint = solverJoints[i];
+		solverJoint.rigidBodyA = joint.rigidBodyA;
+		solverJoint.rigidBodyB = joint.rigidBodyB;
+		solverJoint.joint = &joint;
+
 		glm::vec3 rA = solverBodyA.orientation * joint.anchorA;
 		glm::vec3 rB = solverBodyB.orientation * joint.anchorB;
 
@@ -75,11 +463,12 @@ void SpxSolveConstraints(
 
 		if (distanceSqr < SPX_EPSILON * SPX_EPSILON)
 		{
-			joint.constraint.jacDiagInv = 0.0f;
-			joint.constraint.rhs = 0.0f;
-			joint.constraint.lowerLimit = -FLT_MAX;
-			joint.constraint.upperLimit = FLT_MAX;
-			joint.constraint.axis = glm::vec3(1.0f, 0.0f, 0.0f);
+			SpxSetupSolverRow(solverJoint.row, glm::vec3(1.0f, 0.0f, 0.0f), rA, rB, solverBodyA, solverBodyB);
+			solverJoint.row.jacDiagInv = 0.0f;
+			solverJoint.row.rhs = 0.0f;
+			solverJoint.row.lowerLimit = -FLT_MAX;
+			solverJoint.row.upperLimit = FLT_MAX;
+			solverJoint.row.accumImpulse = 0.0f;
 			continue;
 		}
 
@@ -91,29 +480,23 @@ void SpxSolveConstraints(
 		glm::vec3 velocityB = stateB.m_linearVelocity + cross(stateB.m_angularVelocity, rB);
 		glm::vec3 relativeVelocity = velocityA - velocityB;
 
-		// 拘束力の式の分母の部分(法線ベクトルの部分は除く)
-		glm::mat3 K = glm::mat3(glm::scale(glm::mat4(1.0f), glm::vec3(solverBodyA.massInv + solverBodyB.massInv))) -
-					  GLMExtension::CrossMatrix(rA) * solverBodyA.inertiaInv * GLMExtension::CrossMatrix(rA) -
-					  GLMExtension::CrossMatrix(rB) * solverBodyB.inertiaInv * GLMExtension::CrossMatrix(rB);
+		SpxSolverRow& row = solverJoint.row;
+		SpxSetupSolverRow(row, direction, rA, rB, solverBodyA, solverBodyB);
 
-		// 拘束力の分母部分
-		float denom = glm::dot(K * direction, direction);
-		joint.constraint.jacDiagInv = 1.0f / denom;
 		// 拘束力の分子部分
-		joint.constraint.rhs = -glm::dot(relativeVelocity, direction);  // velocity error
-		joint.constraint.rhs -= joint.bias * distance / timeStep;  // position error
+		row.rhs = -glm::dot(relativeVelocity, direction);  // velocity error
+		row.rhs -= joint.bias * distance / timeStep;		  // position error
 		// 拘束力f
-		joint.constraint.rhs *= joint.constraint.jacDiagInv;
+		row.rhs *= row.jacDiagInv;
 
-		joint.constraint.lowerLimit = -FLT_MAX;
-		joint.constraint.upperLimit = FLT_MAX;
-		joint.constraint.axis = direction;
-
-		joint.constraint.accumImpulse = 0.0f;
+		row.lowerLimit = -FLT_MAX;
+		row.upperLimit = FLT_MAX;
+		row.accumImpulse = 0.0f;
 	}
 
 	// 拘束のセットアップ(衝突)。
 	// 衝突の情報から拘束計算に必要なパラメータを抽出して拘束の情報に変換する。
+	SpxUInt32 contactIndex = 0;
 	for (SpxUInt32 i = 0; i < numPairs; i++)
 	{
 		const SpxPair& pair = pairs[i];
@@ -126,26 +509,34 @@ void SpxSolveConstraints(
 		const SpxRigidBody& bodyB = bodies[pair.rigidBodyB];
 		SpxSolverBody& solverBodyB = solverBodies[pair.rigidBodyB];
 
-		assert(pair.contact);
+		assert(pair.contact != SPX_INVALID_CONTACT);
+		SpxContact& contact = contacts[pair.contact];
 
 		// 摩擦係数は2つのオブジェクトの摩擦係数の合成値とする
-		pair.contact->m_friction = glm::sqrt(bodyA.m_friction * bodyB.m_friction);
+		contact.m_friction = glm::sqrt(bodyA.m_friction * bodyB.m_friction);
+
+		// 反発係数。
+		// 新規に発生した衝突でない場合、反発係数は0とする。
+		float restitution = (pair.type == SpxPairTypeNew) ? 0.5f * (bodyA.m_restitution + bodyB.m_restitution) : 0.0f;
+
+		SpxUInt32 firstContact = contactIndex;
 
 		// 衝突のペアでイテレーション
-		for (SpxUInt32 j = 0; j < pair.contact->m_numContacts; j++)
+		for (SpxUInt32 j = 0; j < contact.m_numContacts; j++)
 		{
-			SpxContactPoint& cp = pair.contact->m_contactPoints[j];
+			SpxContactPoint& cp = contact.m_contactPoints[j];
+
+			SpxSolverContactPoint& solverContact = solverContacts[contactIndex++];
+			solverContact.rigidBodyA = pair.rigidBodyA;
+			solverContact.rigidBodyB = pair.rigidBodyB;
+			solverContact.friction = contact.m_friction;
+			solverContact.contactPoint = &cp;
 
 			// 接続点を剛体の姿勢に合わせて回転。
 			// すると、オブジェクトの重心から衝突点に向かうベクトルに変化する。
 			glm::vec3 rA = rotate(solverBodyA.orientation, cp.pointA);
 			glm::vec3 rB = rotate(solverBodyB.orientation, cp.pointB);
 
-			// 拘束力の式の分母の部分(法線ベクトルの部分は除く)
-			glm::mat3 K = glm::mat3(glm::scale(glm::mat4(1.0f), glm::vec3(solverBodyA.massInv + solverBodyB.massInv))) -
-						  GLMExtension::CrossMatrix(rA) * solverBodyA.inertiaInv * GLMExtension::CrossMatrix(rA) -
-						  GLMExtension::CrossMatrix(rB) * solverBodyB.inertiaInv * GLMExtension::CrossMatrix(rB);
-
 			glm::vec3 velocityA = stateA.m_linearVelocity + cross(stateA.m_angularVelocity, rA);
 			glm::vec3 velocityB = stateB.m_linearVelocity + cross(stateB.m_angularVelocity, rB);
 			// 衝突点における相対速度を求める
@@ -156,76 +547,71 @@ void SpxSolveConstraints(
 			// 衝突点の法線ベクトル(ワールド座標系)をベースに2つの基底ベクトルを作る
 			SpxCalcTangentVector(cp.normal, tangent1, tangent2);
 
-			// 反発係数。
-			// 新規に発生した衝突でない場合、反発係数は0とする。
-			float restitution = (pair.type == SpxPairTypeNew) ? 0.5f * (bodyA.m_restitution + bodyB.m_restitution) : 0.0f;
-
 			// Normal方向の拘束力を計算
 			{
-				glm::vec3 axis = cp.normal;
-				float denom = glm::dot(K * axis, axis);
-				cp.constraints[0].jacDiagInv = 1.0f / denom;
-				cp.constraints[0].rhs = -(1.0f + restitution) * glm::dot(relativeVelocity, axis);	  // velocity error(反発係数込み)
-				cp.constraints[0].rhs -= (bias * glm::min(0.0f, cp.distance + slop)) / timeStep;  // position error(許容距離込み)
-				cp.constraints[0].rhs *= cp.constraints[0].jacDiagInv;
-				cp.constraints[0].lowerLimit = 0.0f;
-				cp.constraints[0].upperLimit = FLT_MAX;
-				cp.constraints[0].axis = axis;
+				SpxSolverRow& row = solverContact.rows[0];
+				SpxSetupSolverRow(row, cp.normal, rA, rB, solverBodyA, solverBodyB);
+				if (cp.distance > 0.0f)
+				{
+					// 投機的な衝突点(まだ離れている)
+					// このステップで距離を詰める分の速度は許し、それを超えて近づく分だけを止める
+					row.rhs = -glm::dot(relativeVelocity, cp.normal) - cp.distance / timeStep;
+				}
+				else {
+					row.rhs = -(1.0f + restitution) * glm::dot(relativeVelocity, cp.normal);  // velocity error(反発係数込み)
+					row.rhs -= (bias * glm::min(0.0f, cp.distance + slop)) / timeStep;		   // position error(許容距離込み)
+				}
+				row.rhs *= row.jacDiagInv;
+				row.lowerLimit = 0.0f;
+				row.upperLimit = FLT_MAX;
+				row.accumImpulse = cp.constraints[0].accumImpulse;
 			}
 
 			// Tangent1方向(摩擦その1)の拘束力を計算
 			{
-				glm::vec3 axis = tangent1;
-				float denom = glm::dot(K * axis, axis);
-				cp.constraints[1].jacDiagInv = 1.0f / denom;
-				cp.constraints[1].rhs = -glm::dot(relativeVelocity, axis);
-				cp.constraints[1].rhs *= cp.constraints[1].jacDiagInv;
+				SpxSolverRow& row = solverContact.rows[1];
+				SpxSetupSolverRow(row, tangent1, rA, rB, solverBodyA, solverBodyB);
+				row.rhs = -glm::dot(relativeVelocity, tangent1);
+				row.rhs *= row.jacDiagInv;
 				// 拘束力の下限と上限は反発方向の拘束力が分からないと決められないので、
 				// とりあえず0で初期化しておく。
-				cp.constraints[1].lowerLimit = 0.0f;
-				cp.constraints[1].upperLimit = 0.0f;
-				cp.constraints[1].axis = axis;
+				row.lowerLimit = 0.0f;
+				row.upperLimit = 0.0f;
+				row.accumImpulse = cp.constraints[1].accumImpulse;
 			}
 
 			// Tangent2方向(摩擦その2)の拘束力を計算
 			{
-				glm::vec3 axis = tangent2;
-				float denom = glm::dot(K * axis, axis);
-				cp.constraints[2].jacDiagInv = 1.0f / denom;
-				cp.constraints[2].rhs = -glm::dot(relativeVelocity, axis);
-				cp.constraints[2].rhs *= cp.constraints[2].jacDiagInv;
-				cp.constraints[2].lowerLimit = 0.0f;
-				cp.constraints[2].upperLimit = 0.0f;
-				cp.constraints[2].axis = axis;
+				SpxSolverRow& row = solverContact.rows[2];
+				SpxSetupSolverRow(row, tangent2, rA, rB, solverBodyA, solverBodyB);
+				row.rhs = -glm::dot(relativeVelocity, tangent2);
+				row.rhs *= row.jacDiagInv;
+				row.lowerLimit = 0.0f;
+				row.upperLimit = 0.0f;
+				row.accumImpulse = cp.constraints[2].accumImpulse;
 			}
 		}
+
+		if (solverManifolds)
+		{
+			SpxSetupSolverManifold(solverManifolds[i], firstContact, contact.m_numContacts, solverContacts, solverBodyA, solverBodyB);
+		}
 	}
 
 	// Warm starting
 	// 衝突に関する各拘束力の初期値を0ではなく、過去の拘束力として与える。
-	for (SpxUInt32 i = 0; i < numPairs; i++)
+	for (SpxUInt32 i = 0; i < numContactPoints; i++)
 	{
-		const SpxPair& pair = pairs[i];
+		SpxSolverContactPoint& solverContact = solverContacts[i];
 
-		SpxSolverBody& solverBodyA = solverBodies[pair.rigidBodyA];
-		SpxSolverBody& solverBodyB = solverBodies[pair.rigidBodyB];
+		SpxSolverBody& solverBodyA = solverBodies[solverContact.rigidBodyA];
+		SpxSolverBody& solverBodyB = solverBodies[solverContact.rigidBodyB];
 
-		for (SpxUInt32 j = 0; j < pair.contact->m_numContacts; j++)
+		// 1つの衝突につき、3つの拘束がある
+		for (SpxUInt32 k = 0; k < 3; k++)
 		{
-			SpxContactPoint& cp = pair.contact->m_contactPoints[j];
-			glm::vec3 rA = solverBodyA.orientation * cp.pointA;
-			glm::vec3 rB = solverBodyB.orientation * cp.pointB;
-
-			// 1つの衝突につき、3つの拘束がある
-			for (SpxUInt32 k = 0; k < 3; k++)
-			{
-				float deltaImpulse = cp.constraints[k].accumImpulse;
-				// それぞれのソルバーボディの並進速度の変化分と回転速度の変化分を計算する
-				solverBodyA.deltaLinearVelocity += deltaImpulse * solverBodyA.massInv * cp.constraints[k].axis;
-				solverBodyA.deltaAngularVelocity += deltaImpulse * solverBodyA.inertiaInv * cross(rA, cp.constraints[k].axis);
-				solverBodyB.deltaLinearVelocity -= deltaImpulse * solverBodyB.massInv * cp.constraints[k].axis;
-				solverBodyB.deltaAngularVelocity -= deltaImpulse * solverBodyB.inertiaInv * cross(rB, cp.constraints[k].axis);
-			}
+			const SpxSolverRow& row = solverContact.rows[k];
+			SpxApplySolverRowImpulse(row, row.accumImpulse, solverBodyA, solverBodyB);
 		}
 	}
 
@@ -236,104 +622,53 @@ void SpxSolveConstraints(
 		// ボールジョイントの拘束の計算
 		for (SpxUInt32 i = 0; i < numJoints; i++)
 		{
-			SpxBallJoint& joint = joints[i];
-
-			SpxSolverBody& solverBodyA = solverBodies[joint.rigidBodyA];
-			SpxSolverBody& solverBodyB = solverBodies[joint.rigidBodyB];
-
-			glm::vec3 rA = solverBodyA.orientation * joint.anchorA;
-			glm::vec3 rB = solverBodyB.orientation * joint.anchorB;
-
-			SpxConstraint& constraint = joint.constraint;
-			float deltaImpulse = constraint.rhs;
-			glm::vec3 deltaVelocityA = solverBodyA.deltaLinearVelocity + cross(solverBodyA.deltaAngularVelocity, rA);
-			glm::vec3 deltaVelocityB = solverBodyB.deltaLinearVelocity + cross(solverBodyB.deltaAngularVelocity, rB);
-			deltaImpulse -= constraint.jacDiagInv * dot(constraint.axis, deltaVelocityA - deltaVelocityB);
-			float oldImpulse = constraint.accumImpulse;
-			constraint.accumImpulse = glm::clamp(oldImpulse + deltaImpulse, constraint.lowerLimit, constraint.upperLimit);
-			deltaImpulse = constraint.accumImpulse - oldImpulse;
-			solverBodyA.deltaLinearVelocity += deltaImpulse * solverBodyA.massInv * constraint.axis;
-			solverBodyA.deltaAngularVelocity += deltaImpulse * solverBodyA.inertiaInv * cross(rA, constraint.axis);
-			solverBodyB.deltaLinearVelocity -= deltaImpulse * solverBodyB.massInv * constraint.axis;
-			solverBodyB.deltaAngularVelocity -= deltaImpulse * solverBodyB.inertiaInv * cross(rB, constraint.axis);
+			SpxSolverJoint& solverJoint = solverJoints[i];
+			SpxSolveRow(
+				solverJoint.row,
+				solverBodies[solverJoint.rigidBodyA],
+				solverBodies[solverJoint.rigidBodyB]);
 		}
 
-		// 衝突の拘束の計算
-		for (SpxUInt32 i = 0; i < numPairs; i++)
+		// 衝突の拘束の計算(法線方向をペアごとにまとめて解く)
+		if (solverManifolds)
 		{
-			const SpxPair& pair = pairs[i];
+			for (SpxUInt32 i = 0; i < numPairs; i++)
+			{
+				SpxSolveManifold(solverManifolds[i], solverContacts, solverBodies);
+			}
+			continue;
+		}
 
-			SpxSolverBody& solverBodyA = solverBodies[pair.rigidBodyA];
-			SpxSolverBody& solverBodyB = solverBodies[pair.rigidBodyB];
+		// 衝突の拘束の計算
+		for (SpxUInt32 i = 0; i < numContactPoints; i++)
+		{
+			SpxSolverContactPoint& solverContact = solverContacts[i];
 
-			for (SpxUInt32 j = 0; j < pair.contact->m_numContacts; j++)
-			{
-				SpxContactPoint& cp = pair.contact->m_contactPoints[j];
-				glm::vec3 rA = solverBodyA.orientation * cp.pointA;
-				glm::vec3 rB = solverBodyB.orientation * cp.pointB;
+			SpxSolverBody& solverBodyA = solverBodies[solverContact.rigidBodyA];
+			SpxSolverBody& solverBodyB = solverBodies[solverContact.rigidBodyB];
 
-				// 衝突法線ベクトル方向の拘束
-				{
-					SpxConstraint& constraint = cp.constraints[0];
-					float deltaImpulse = constraint.rhs;
-					glm::vec3 deltaVelocityA = solverBodyA.deltaLinearVelocity + cross(solverBodyA.deltaAngularVelocity, rA);
-					glm::vec3 deltaVelocityB = solverBodyB.deltaLinearVelocity + cross(solverBodyB.deltaAngularVelocity, rB);
-					// 拘束力の計算
-					deltaImpulse -= constraint.jacDiagInv * dot(constraint.axis, deltaVelocityA - deltaVelocityB);
-					float oldImpulse = constraint.accumImpulse;
-					constraint.accumImpulse = glm::clamp(oldImpulse + deltaImpulse, constraint.lowerLimit, constraint.upperLimit);
-					deltaImpulse = constraint.accumImpulse - oldImpulse;
-
-					// 求めた拘束力から並進速度、回転速度を更新
-					solverBodyA.deltaLinearVelocity += deltaImpulse * solverBodyA.massInv * constraint.axis;
-					solverBodyA.deltaAngularVelocity += deltaImpulse * solverBodyA.inertiaInv * cross(rA, constraint.axis);
-					solverBodyB.deltaLinearVelocity -= deltaImpulse * solverBodyB.massInv * constraint.axis;
-					solverBodyB.deltaAngularVelocity -= deltaImpulse * solverBodyB.inertiaInv * cross(rB, constraint.axis);
-				}
+			// 衝突法線ベクトル方向の拘束
+			SpxSolveRow(solverContact.rows[0], solverBodyA, solverBodyB);
 
-				// 反発方向の拘束力が求まったら、摩擦方向の拘束力の最大値と最小値が決定できるので、これらを計算する。
-				// 摩擦力の最大値は (動)摩擦係数 * 垂直抗力
-				float maxFriction = pair.contact->m_friction * glm::abs(cp.constraints[0].accumImpulse);
-				cp.constraints[1].lowerLimit = -maxFriction;
-				cp.constraints[1].upperLimit = maxFriction;
-				cp.constraints[2].lowerLimit = -maxFriction;
-				cp.constraints[2].upperLimit = maxFriction;
+			// 反発方向の拘束力が求まったら、摩擦方向の拘束力の最大値と最小値が決定できるので、これらを計算する。
+			// 摩擦力の最大値は (動)摩擦係数 * 垂直抗力
+			float maxFriction = solverContact.friction * glm::abs(solverContact.rows[0].accumImpulse);
+			solverContact.rows[1].lowerLimit = -maxFriction;
+			solverContact.rows[1].upperLimit = maxFriction;
+			solverContact.rows[2].lowerLimit = -maxFriction;
+			solverContact.rows[2].upperLimit = maxFriction;
 
-				// 摩擦方向の拘束その1
-				{
-					SpxConstraint& constraint = cp.constraints[1];
-					float deltaImpulse = constraint.rhs;
-					glm::vec3 deltaVelocityA = solverBodyA.deltaLinearVelocity + cross(solverBodyA.deltaAngularVelocity, rA);
-					glm::vec3 deltaVelocityB = solverBodyB.deltaLinearVelocity + cross(solverBodyB.deltaAngularVelocity, rB);
-					deltaImpulse -= constraint.jacDiagInv * dot(constraint.axis, deltaVelocityA - deltaVelocityB);
-					float oldImpulse = constraint.accumImpulse;
-					constraint.accumImpulse = glm::clamp(oldImpulse + deltaImpulse, constraint.lowerLimit, constraint.upperLimit);
-					deltaImpulse = constraint.accumImpulse - oldImpulse;
-					solverBodyA.deltaLinearVelocity += deltaImpulse * solverBodyA.massInv * constraint.axis;
-					solverBodyA.deltaAngularVelocity += deltaImpulse * solverBodyA.inertiaInv * cross(rA, constraint.axis);
-					solverBodyB.deltaLinearVelocity -= deltaImpulse * solverBodyB.massInv * constraint.axis;
-					solverBodyB.deltaAngularVelocity -= deltaImpulse * solverBodyB.inertiaInv * cross(rB, constraint.axis);
-				}
+			// 摩擦方向の拘束その1
+			SpxSolveRow(solverContact.rows[1], solverBodyA, solverBodyB);
 
-				// 摩擦方向の拘束その2
-				{
-					SpxConstraint& constraint = cp.constraints[2];
-					float deltaImpulse = constraint.rhs;
-					glm::vec3 deltaVelocityA = solverBodyA.deltaLinearVelocity + cross(solverBodyA.deltaAngularVelocity, rA);
-					glm::vec3 deltaVelocityB = solverBodyB.deltaLinearVelocity + cross(solverBodyB.deltaAngularVelocity, rB);
-					deltaImpulse -= constraint.jacDiagInv * dot(constraint.axis, deltaVelocityA - deltaVelocityB);
-					float oldImpulse = constraint.accumImpulse;
-					constraint.accumImpulse = glm::clamp(oldImpulse + deltaImpulse, constraint.lowerLimit, constraint.upperLimit);
-					deltaImpulse = constraint.accumImpulse - oldImpulse;
-					solverBodyA.deltaLinearVelocity += deltaImpulse * solverBodyA.massInv * constraint.axis;
-					solverBodyA.deltaAngularVelocity += deltaImpulse * solverBodyA.inertiaInv * cross(rA, constraint.axis);
-					solverBodyB.deltaLinearVelocity -= deltaImpulse * solverBodyB.massInv * constraint.axis;
-					solverBodyB.deltaAngularVelocity -= deltaImpulse * solverBodyB.inertiaInv * cross(rB, constraint.axis);
-				}
-			}
+			// 摩擦方向の拘束その2
+			SpxSolveRow(solverContact.rows[2], solverBodyA, solverBodyB);
 		}
 	}
 
+	// 蓄積された拘束力を次のフレームのウォームスタート用に書き戻す
+	SpxStoreImpulses(solverJoints, numJoints, solverContacts, numContactPoints);
+
 	// 拘束力から算出された速度の差分を各剛体の速度に加える
 	for (SpxUInt32 i = 0; i < numRigidBodies; i++)
 	{
@@ -341,7 +676,357 @@ void SpxSolveConstraints(
 		states[i].m_angularVelocity += solverBodies[i].deltaAngularVelocity;
 	}
 
+	if (solverManifolds)
+	{
+		allocator->deallocate(solverManifolds);
+	}
+	allocator->deallocate(solverContacts);
+	allocator->deallocate(solverJoints);
 	allocator->deallocate(solverBodies);
 }
 
+///////////////////////////////////////////////////////////////////////////////
+//
+// ソフト拘束ソルバー(TGS-soft)
+
+// 反発係数を適用する最小の接近速度
+const float SPX_RESTITUTION_THRESHOLD = 1.0f;
+
+/**
+ * @brief 拘束軸方向の相対速度を剛体の速度から求める
+ *
+ */
+static inline float SpxGetRowVelocity(
+	const SpxSolverRow& row,
+	const SpxState& stateA,
+	const SpxState& stateB)
+{
+	return glm::dot(row.linear, stateA.m_linearVelocity - stateB.m_linearVelocity) +
+		   glm::dot(row.angularA, stateA.m_angularVelocity) -
+		   glm::dot(row.angularB, stateB.m_angularVelocity);
+}
+
+/**
+ * @brief 拘束力を剛体の速度に直接反映する
+ *
+ */
+static inline void SpxApplySoftRowImpulse(
+	const SpxSolverRow& row,
+	float impulse,
+	SpxState& stateA,
+	const SpxSolverBody& solverBodyA,
+	SpxState& stateB,
+	const SpxSolverBody& solverBodyB)
+{
+	stateA.m_linearVelocity += (impulse * solverBodyA.massInv) * row.linear;
+	stateA.m_angularVelocity += impulse * row.inertiaInvAngularA;
+	stateB.m_linearVelocity -= (impulse * solverBodyB.massInv) * row.linear;
+	stateB.m_angularVelocity -= impulse * row.inertiaInvAngularB;
+}
+
+SpxSoftness SpxMakeSoftness(float hertz, float dampingRatio, float timeStep)
+{
+	if (hertz == 0.0f)
+	{
+		// 固有振動数が0の場合は剛な拘束として扱う
+		return SpxSoftness{0.0f, 1.0f, 0.0f};
+	}
+
+	float omega = 2.0f * glm::pi<float>() * hertz;
+	float a1 = 2.0f * dampingRatio + timeStep * omega;
+	float a2 = timeStep * omega * a1;
+	float a3 = 1.0f / (1.0f + a2);
+	return SpxSoftness{omega / a1, a2 * a3, a3};
+}
+
+void SpxSetupSoftStep(
+	SpxSoftStepContext& context,
+	const SpxState* states,
+	const SpxRigidBody* bodies,
+	SpxUInt32 numRigidBodies,
+	const SpxPair* pairs,
+	SpxUInt32 numPairs,
+	SpxContact* contacts,
+	SpxBallJoint* joints,
+	SpxUInt32 numJoints,
+	float contactHertz,
+	float contactDampingRatio,
+	float jointHertz,
+	float jointDampingRatio,
+	float slop,
+	float maxBiasVelocity,
+	float subTimeStep,
+	SpxAllocator* allocator)
+{
+	context.numRigidBodies = numRigidBodies;
+	context.numContactPoints = SpxCountContactPoints(pairs, numPairs, contacts);
+	context.numJoints = numJoints;
+	context.solverBodies = (SpxSolverBody*)allocator->allocate(sizeof(SpxSolverBody) * numRigidBodies);
+	context.solverJoints = (SpxSolverJoint*)allocator->allocate(sizeof(SpxSolverJoint) * numJoints);
+	context.solverContacts = (SpxSolverContactPoint*)allocator->allocate(sizeof(SpxSolverContactPoint) * context.numContactPoints);
+	// 衝突は固すぎると振動するので、固有振動数はサブステップの周波数の1/4までに抑える
+	context.contactSoftness = SpxMakeSoftness(glm::min(contactHertz, 0.25f / subTimeStep), contactDampingRatio, subTimeStep);
+	context.jointSoftness = SpxMakeSoftness(jointHertz, jointDampingRatio, subTimeStep);
+	context.slop = slop;
+	context.maxBiasVelocity = maxBiasVelocity;
+	context.subTimeStep = subTimeStep;
+
+	SpxSetupSolverBodies(states, bodies, numRigidBodies, context.solverBodies);
+
+	// 拘束のセットアップ(ボールジョイント)。
+	// 拘束軸と作用点はステップの先頭で固定し、位置誤差だけをサブステップごとに計算し直す。
+	for (SpxUInt32 i = 0; i < numJoints; i++)
+	{
+		SpxBallJoint& joint = joints[i];
+		const SpxSolverBody& solverBodyA = context.solverBodies[joint.rigidBodyA];
+		const SpxSolverBody& solverBodyB = context.solverBodies[joint.rigidBodyB];
+
+		SpxSolverJoint& solverJoint = context.solverJoints[i];
+		solverJoint.rigidBodyA = joint.rigidBodyA;
+		solverJoint.rigidBodyB = joint.rigidBodyB;
+		solverJoint.joint = &joint;
+
+		glm::vec3 rA = solverBodyA.orientation * joint.anchorA;
+		glm::vec3 rB = solverBodyB.orientation * joint.anchorB;
+
+		glm::vec3 direction = (states[joint.rigidBodyA].m_position + rA) - (states[joint.rigidBodyB].m_position + rB);
+		float distanceSqr = glm::length2(direction);
+		direction = distanceSqr < SPX_EPSILON * SPX_EPSILON ? glm::vec3(1.0f, 0.0f, 0.0f) : direction / glm::sqrt(distanceSqr);
+
+		SpxSolverRow& row = solverJoint.row;
+		SpxSetupSolverRow(row, direction, rA, rB, solverBodyA, solverBodyB);
+		row.rhs = 0.0f;
+		row.lowerLimit = -FLT_MAX;
+		row.upperLimit = FLT_MAX;
+		row.accumImpulse = 0.0f;
+	}
+
+	// 拘束のセットアップ(衝突)。
+	SpxUInt32 contactIndex = 0;
+	for (SpxUInt32 i = 0; i < numPairs; i++)
+	{
+		const SpxPair& pair = pairs[i];
+
+		const SpxState& stateA = states[pair.rigidBodyA];
+		const SpxRigidBody& bodyA = bodies[pair.rigidBodyA];
+		const SpxSolverBody& solverBodyA = context.solverBodies[pair.rigidBodyA];
+
+		const SpxState& stateB = states[pair.rigidBodyB];
+		const SpxRigidBody& bodyB = bodies[pair.rigidBodyB];
+		const SpxSolverBody& solverBodyB = context.solverBodies[pair.rigidBodyB];
+
+		assert(pair.contact != SPX_INVALID_CONTACT);
+		SpxContact& contact = contacts[pair.contact];
+
+		contact.m_friction = glm::sqrt(bodyA.m_friction * bodyB.m_friction);
+		float restitution = (pair.type == SpxPairTypeNew) ? 0.5f * (bodyA.m_restitution + bodyB.m_restitution) : 0.0f;
+
+		for (SpxUInt32 j = 0; j < contact.m_numContacts; j++)
+		{
+			SpxContactPoint& cp = contact.m_contactPoints[j];
+
+			SpxSolverContactPoint& solverContact = context.solverContacts[contactIndex++];
+			solverContact.rigidBodyA = pair.rigidBodyA;
+			solverContact.rigidBodyB = pair.rigidBodyB;
+			solverContact.friction = contact.m_friction;
+			solverContact.contactPoint = &cp;
+
+			glm::vec3 rA = rotate(solverBodyA.orientation, cp.pointA);
+			glm::vec3 rB = rotate(solverBodyB.orientation, cp.pointB);
+
+			glm::vec3 tangent1, tangent2;
+			SpxCalcTangentVector(cp.normal, tangent1, tangent2);
+
+			// Normal方向
+			// rhs には反発後の目標速度を入れておき、全サブステップの後で適用する。
+			{
+				SpxSolverRow& row = solverContact.rows[0];
+				SpxSetupSolverRow(row, cp.normal, rA, rB, solverBodyA, solverBodyB);
+				float normalVelocity = SpxGetRowVelocity(row, stateA, stateB);
+				row.rhs = (normalVelocity < -SPX_RESTITUTION_THRESHOLD) ? -restitution * normalVelocity : 0.0f;
+				row.lowerLimit = 0.0f;
+				row.upperLimit = FLT_MAX;
+				row.accumImpulse = cp.constraints[0].accumImpulse;
+			}
+
+			// Tangent1方向(摩擦その1)
+			{
+				SpxSolverRow& row = solverContact.rows[1];
+				SpxSetupSolverRow(row, tangent1, rA, rB, solverBodyA, solverBodyB);
+				row.rhs = 0.0f;
+				row.lowerLimit = 0.0f;
+				row.upperLimit = 0.0f;
+				row.accumImpulse = cp.constraints[1].accumImpulse;
+			}
+
+			// Tangent2方向(摩擦その2)
+			{
+				SpxSolverRow& row = solverContact.rows[2];
+				SpxSetupSolverRow(row, tangent2, rA, rB, solverBodyA, solverBodyB);
+				row.rhs = 0.0f;
+				row.lowerLimit = 0.0f;
+				row.upperLimit = 0.0f;
+				row.accumImpulse = cp.constraints[2].accumImpulse;
+			}
+		}
+	}
+}
+
+void SpxWarmStartSoftStep(SpxSoftStepContext& context, SpxState* states)
+{
+	for (SpxUInt32 i = 0; i < context.numJoints; i++)
+	{
+		const SpxSolverJoint& solverJoint = context.solverJoints[i];
+		SpxApplySoftRowImpulse(
+			solverJoint.row, solverJoint.row.accumImpulse,
+			states[solverJoint.rigidBodyA], context.solverBodies[solverJoint.rigidBodyA],
+			states[solverJoint.rigidBodyB], context.solverBodies[solverJoint.rigidBodyB]);
+	}
+
+	for (SpxUInt32 i = 0; i < context.numContactPoints; i++)
+	{
+		const SpxSolverContactPoint& solverContact = context.solverContacts[i];
+		SpxState& stateA = states[solverContact.rigidBodyA];
+		SpxState& stateB = states[solverContact.rigidBodyB];
+		const SpxSolverBody& solverBodyA = context.solverBodies[solverContact.rigidBodyA];
+		const SpxSolverBody& solverBodyB = context.solverBodies[solverContact.rigidBodyB];
+
+		for (SpxUInt32 k = 0; k < 3; k++)
+		{
+			const SpxSolverRow& row = solverContact.rows[k];
+			SpxApplySoftRowImpulse(row, row.accumImpulse, stateA, solverBodyA, stateB, solverBodyB);
+		}
+	}
+}
+
+void SpxSolveSoftStep(SpxSoftStepContext& context, SpxState* states, bool useBias)
+{
+	// ボールジョイントの拘束の計算
+	for (SpxUInt32 i = 0; i < context.numJoints; i++)
+	{
+		SpxSolverJoint& solverJoint = context.solverJoints[i];
+		const SpxBallJoint& joint = *solverJoint.joint;
+		SpxSolverRow& row = solverJoint.row;
+
+		SpxState& stateA = states[solverJoint.rigidBodyA];
+		SpxState& stateB = states[solverJoint.rigidBodyB];
+		const SpxSolverBody& solverBodyA = context.solverBodies[solverJoint.rigidBodyA];
+		const SpxSolverBody& solverBodyB = context.solverBodies[solverJoint.rigidBodyB];
+
+		float bias = 0.0f;
+		float massScale = 1.0f;
+		float impulseScale = 0.0f;
+		if (useBias)
+		{
+			// 現在の姿勢での接続点のずれ
+			glm::vec3 positionA = stateA.m_position + stateA.m_orientation * joint.anchorA;
+			glm::vec3 positionB = stateB.m_position + stateB.m_orientation * joint.anchorB;
+			float separation = glm::dot(row.linear, positionA - positionB);
+
+			bias = context.jointSoftness.biasRate * separation;
+			massScale = context.jointSoftness.massScale;
+			impulseScale = context.jointSoftness.impulseScale;
+		}
+
+		float velocity = SpxGetRowVelocity(row, stateA, stateB);
+		float impulse = -row.jacDiagInv * massScale * (velocity + bias) - impulseScale * row.accumImpulse;
+		row.accumImpulse += impulse;
+		SpxApplySoftRowImpulse(row, impulse, stateA, solverBodyA, stateB, solverBodyB);
+	}
+
+	// 衝突の拘束の計算
+	for (SpxUInt32 i = 0; i < context.numContactPoints; i++)
+	{
+		SpxSolverContactPoint& solverContact = context.solverContacts[i];
+		const SpxContactPoint& cp = *solverContact.contactPoint;
+
+		SpxState& stateA = states[solverContact.rigidBodyA];
+		SpxState& stateB = states[solverContact.rigidBodyB];
+		const SpxSolverBody& solverBodyA = context.solverBodies[solverContact.rigidBodyA];
+		const SpxSolverBody& solverBodyB = context.solverBodies[solverContact.rigidBodyB];
+
+		// 衝突法線ベクトル方向の拘束
+		{
+			SpxSolverRow& row = solverContact.rows[0];
+
+			// 現在の位置と姿勢から衝突点を求め直して貫通深度を更新する
+			glm::vec3 cpA = stateA.m_position + glm::rotate(stateA.m_orientation, cp.pointA);
+			glm::vec3 cpB = stateB.m_position + glm::rotate(stateB.m_orientation, cp.pointB);
+			float separation = glm::dot(row.linear, cpA - cpB);
+
+			float bias = 0.0f;
+			float massScale = 1.0f;
+			float impulseScale = 0.0f;
+			if (separation > 0.0f)
+			{
+				// まだ離れているならば、このサブステップで接触する分の速度だけ許す
+				bias = separation / context.subTimeStep;
+			}
+			else if (useBias) {
+				bias = glm::max(context.contactSoftness.biasRate * glm::min(0.0f, separation + context.slop), -context.maxBiasVelocity);
+				massScale = context.contactSoftness.massScale;
+				impulseScale = context.contactSoftness.impulseScale;
+			}
+
+			float velocity = SpxGetRowVelocity(row, stateA, stateB);
+			float impulse = -row.jacDiagInv * massScale * (velocity + bias) - impulseScale * row.accumImpulse;
+			float newImpulse = glm::max(row.accumImpulse + impulse, 0.0f);
+			impulse = newImpulse - row.accumImpulse;
+			row.accumImpulse = newImpulse;
+			SpxApplySoftRowImpulse(row, impulse, stateA, solverBodyA, stateB, solverBodyB);
+		}
+
+		// 摩擦方向の拘束
+		float maxFriction = solverContact.friction * solverContact.rows[0].accumImpulse;
+		for (SpxUInt32 k = 1; k < 3; k++)
+		{
+			SpxSolverRow& row = solverContact.rows[k];
+			row.lowerLimit = -maxFriction;
+			row.upperLimit = maxFriction;
+
+			float velocity = SpxGetRowVelocity(row, stateA, stateB);
+			float impulse = -row.jacDiagInv * velocity;
+			float newImpulse = glm::clamp(row.accumImpulse + impulse, row.lowerLimit, row.upperLimit);
+			impulse = newImpulse - row.accumImpulse;
+			row.accumImpulse = newImpulse;
+			SpxApplySoftRowImpulse(row, impulse, stateA, solverBodyA, stateB, solverBodyB);
+		}
+	}
+}
+
+void SpxFinishSoftStep(SpxSoftStepContext& context, SpxState* states, SpxAllocator* allocator)
+{
+	// 反発係数の適用
+	// 新規の衝突で、かつ実際に拘束力が働いた衝突点だけを対象とする
+	for (SpxUInt32 i = 0; i < context.numContactPoints; i++)
+	{
+		SpxSolverContactPoint& solverContact = context.solverContacts[i];
+		SpxSolverRow& row = solverContact.rows[0];
+		if (row.rhs == 0.0f || row.accumImpulse == 0.0f) { continue; }
+
+		SpxState& stateA = states[solverContact.rigidBodyA];
+		SpxState& stateB = states[solverContact.rigidBodyB];
+
+		float velocity = SpxGetRowVelocity(row, stateA, stateB);
+		float impulse = -row.jacDiagInv * (velocity - row.rhs);
+		float newImpulse = glm::max(row.accumImpulse + impulse, 0.0f);
+		impulse = newImpulse - row.accumImpulse;
+		row.accumImpulse = newImpulse;
+		SpxApplySoftRowImpulse(
+			row, impulse,
+			stateA, context.solverBodies[solverContact.rigidBodyA],
+			stateB, context.solverBodies[solverContact.rigidBodyB]);
+	}
+
+	// 蓄積された拘束力を次のフレームのウォームスタート用に書き戻す
+	SpxStoreImpulses(context.solverJoints, context.numJoints, context.solverContacts, context.numContactPoints);
+
+	allocator->deallocate(context.solverContacts);
+	allocator->deallocate(context.solverJoints);
+	allocator->deallocate(context.solverBodies);
+	context.solverContacts = nullptr;
+	context.solverJoints = nullptr;
+	context.solverBodies = nullptr;
+}
+
 };	// namespace SimplePhysics
\ No newline at end of file
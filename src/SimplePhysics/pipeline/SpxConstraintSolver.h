@@ -5,11 +5,54 @@
 #include "../elements/SpxRigidBody.h"
 #include "../elements/SpxPair.h"
 #include "../elements/SpxBallJoint.h"
+#include "../elements/SpxSloverBody.h"
+#include "../elements/SpxSolverRow.h"
 #include "SpxAllocator.h"
 
 namespace SimplePhysics
 {
 
+// 拘束ソルバーの種類
+enum SpxSolverType
+{
+	SpxSolverTypePGS,		// 1ステップをまとめて反復計算する(Projected Gauss-Seidel)
+	SpxSolverTypeSoftStep,	// サブステップごとにソフト拘束を1回ずつ解く(TGS-soft)
+};
+
+// ソフト拘束の係数
+struct SpxSoftness
+{
+	float biasRate;		 // 位置誤差を速度に変換する係数
+	float massScale;	 // 有効質量に掛ける係数
+	float impulseScale;	 // 蓄積された拘束力に掛ける係数
+};
+
+// サブステップをまたいで保持するソフト拘束ソルバーのデータ
+struct SpxSoftStepContext
+{
+	SpxSolverBody* solverBodies;			// ソルバーボディの配列
+	SpxUInt32 numRigidBodies;				// 剛体の数
+	SpxSolverContactPoint* solverContacts;	// 衝突の拘束の配列
+	SpxUInt32 numContactPoints;				// 衝突の拘束の数
+	SpxSolverJoint* solverJoints;			// ジョイントの拘束の配列
+	SpxUInt32 numJoints;					// ジョイントの拘束の数
+	SpxSoftness contactSoftness;			// 衝突のソフト拘束の係数
+	SpxSoftness jointSoftness;				// ジョイントのソフト拘束の係数
+	float slop;								// 貫通許容誤差
+	float maxBiasVelocity;					// 位置補正で与える速度の最大値
+	float subTimeStep;						// サブステップのタイムステップ
+};
+
+/**
+ * @brief ソフト拘束の係数を求める
+ *
+ * @param hertz 拘束の固有振動数
+ * @param dampingRatio 減衰比
+ * @param timeStep タイムステップ
+ * @return SpxSoftness ソフト拘束の係数
+ */
+SpxSoftness SpxMakeSoftness(float hertz, float dampingRatio, float timeStep);
+
 /**
  * @brief 拘束ソルバー
  *
@@ -18,6 +61,7 @@ namespace SimplePhysics
  * @param numRigidBodies 剛体の数
  * @param pairs ペア配列
  * @param numPairs ペア数
+ * @param contacts 衝突情報の配列(ペアが持つインデックスで参照する)
  * @param joints ジョイント配列
  * @param numJoints ジョイント数
  * @param iteration 計算の反復回数
@@ -25,6 +69,7 @@ namespace SimplePhysics
  * @param slop 貫通許容誤差
  * @param timeStep タイムステップ
  * @param allocator アロケータ
+ * @param useBlockSolver true ならば1つのペアの法線方向の拘束をまとめて解く(摩擦は逐次的に解く)
  */
 void SpxSolveConstraints(
 	SpxState* states,
@@ -32,12 +77,82 @@ void SpxSolveConstraints(
 	SpxUInt32 numRigidBodies,
 	const SpxPair* pairs,
 	SpxUInt32 numPairs,
+	SpxContact* contacts,
 	SpxBallJoint* joints,
 	SpxUInt32 numJoints,
 	SpxUInt32 iteration,
 	float bias,
 	float slop,
 	float timeStep,
+	SpxAllocator* allocator,
+	bool useBlockSolver = false);
+
+/**
+ * @brief ソフト拘束ソルバーのセットアップ
+ * 衝突検出の後、1ステップにつき1回だけ呼ぶ。
+ *
+ * @param context ソルバーのデータ(出力)
+ * @param states 剛体の状態の配列
+ * @param bodies 剛体の属性の配列
+ * @param numRigidBodies 剛体の数
+ * @param pairs ペア配列
+ * @param numPairs ペア数
+ * @param contacts 衝突情報の配列(ペアが持つインデックスで参照する)
+ * @param joints ジョイント配列
+ * @param numJoints ジョイント数
+ * @param contactHertz 衝突の拘束の固有振動数
+ * @param contactDampingRatio 衝突の拘束の減衰比
+ * @param jointHertz ジョイントの拘束の固有振動数
+ * @param jointDampingRatio ジョイントの拘束の減衰比
+ * @param slop 貫通許容誤差
+ * @param maxBiasVelocity 位置補正で与える速度の最大値
+ * @param subTimeStep サブステップのタイムステップ
+ * @param allocator アロケータ
+ */
+void SpxSetupSoftStep(
+	SpxSoftStepContext& context,
+	const SpxState* states,
+	const SpxRigidBody* bodies,
+	SpxUInt32 numRigidBodies,
+	const SpxPair* pairs,
+	SpxUInt32 numPairs,
+	SpxContact* contacts,
+	SpxBallJoint* joints,
+	SpxUInt32 numJoints,
+	float contactHertz,
+	float contactDampingRatio,
+	float jointHertz,
+	float jointDampingRatio,
+	float slop,
+	float maxBiasVelocity,
+	float subTimeStep,
 	SpxAllocator* allocator);
 
+/**
+ * @brief 蓄積された拘束力を剛体の速度に適用する(サブステップの先頭で呼ぶ)
+ *
+ * @param context ソルバーのデータ
+ * @param states 剛体の状態の配列
+ */
+void SpxWarmStartSoftStep(SpxSoftStepContext& context, SpxState* states);
+
+/**
+ * @brief ソフト拘束を1回だけ解く
+ * 衝突点の貫通深度は現在の剛体の位置と姿勢から計算し直される。
+ *
+ * @param context ソルバーのデータ
+ * @param states 剛体の状態の配列
+ * @param useBias true ならば位置補正を行う。false ならば位置補正によって生じた速度を取り除く(relax)
+ */
+void SpxSolveSoftStep(SpxSoftStepContext& context, SpxState* states, bool useBias);
+
+/**
+ * @brief 反発係数の適用と拘束力の書き戻しを行い、ソルバーのデータを破棄する
+ *
+ * @param context ソルバーのデータ
+ * @param states 剛体の状態の配列
+ * @param allocator アロケータ
+ */
+void SpxFinishSoftStep(SpxSoftStepContext& context, SpxState* states, SpxAllocator* allocator);
+
 };	// namespace SimplePhysics
\ No newline at end of file
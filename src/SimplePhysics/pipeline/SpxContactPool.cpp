@@ -0,0 +1,108 @@
+#include "SpxContactPool.h"
+
+#include <cassert>
+
+namespace SimplePhysics
+{
+
+SpxContactPool::SpxContactPool(SpxAllocator* allocator, SpxUInt32 capacity)
+	: m_allocator(allocator),
+	  m_numFree(0),
+	  m_numUsed(0),
+	  m_capacity(capacity)
+{
+	assert(allocator);
+	m_contacts = (SpxContact*)m_allocator->allocate(sizeof(SpxContact) * capacity);
+	m_freeList = (SpxUInt32*)m_allocator->allocate(sizeof(SpxUInt32) * capacity);
+	assert(m_contacts);
+	assert(m_freeList);
+}
+
+SpxContactPool::~SpxContactPool()
+{
+	m_allocator->deallocate(m_freeList);
+	m_allocator->deallocate(m_contacts);
+}
+
+SpxUInt32 SpxContactPool::allocate()
+{
+	// 解放された要素があれば、最後に解放されたものから再利用する
+	if (m_numFree > 0)
+	{
+		return m_freeList[--m_numFree];
+	}
+
+	if (m_numUsed < m_capacity)
+	{
+		return m_numUsed++;
+	}
+
+	return SPX_INVALID_CONTACT;
+}
+
+void SpxContactPool::deallocate(SpxUInt32 index)
+{
+	assert(index < m_numUsed);
+	assert(m_numFree < m_numUsed);
+	m_freeList[m_numFree++] = index;
+}
+
+bool SpxContactPool::reserve(SpxUInt32 capacity)
+{
+	if (capacity <= m_capacity) { return true; }
+
+	SpxContact* contacts = (SpxContact*)m_allocator->allocate(sizeof(SpxContact) * capacity);
+	SpxUInt32* freeList = (SpxUInt32*)m_allocator->allocate(sizeof(SpxUInt32) * capacity);
+	if (!contacts || !freeList)
+	{
+		if (contacts) { m_allocator->deallocate(contacts); }
+		if (freeList) { m_allocator->deallocate(freeList); }
+		return false;
+	}
+
+	for (SpxUInt32 i = 0; i < m_numUsed; i++)
+	{
+		contacts[i] = m_contacts[i];
+	}
+	for (SpxUInt32 i = 0; i < m_numFree; i++)
+	{
+		freeList[i] = m_freeList[i];
+	}
+
+	m_allocator->deallocate(m_freeList);
+	m_allocator->deallocate(m_contacts);
+	m_contacts = contacts;
+	m_freeList = freeList;
+	m_capacity = capacity;
+	return true;
+}
+
+void SpxContactPool::compact(SpxPair* pairs, SpxUInt32 numPairs, SpxAllocator* allocator)
+{
+	assert(numPairs == getNumContacts());
+
+	if (numPairs == 0)
+	{
+		m_numUsed = 0;
+		m_numFree = 0;
+		return;
+	}
+
+	// ペアの順に並べた衝突情報を作業領域に作ってから書き戻す
+	SpxContact* buff = (SpxContact*)allocator->allocate(sizeof(SpxContact) * numPairs);
+	for (SpxUInt32 i = 0; i < numPairs; i++)
+	{
+		buff[i] = m_contacts[pairs[i].contact];
+	}
+	for (SpxUInt32 i = 0; i < numPairs; i++)
+	{
+		m_contacts[i] = buff[i];
+		pairs[i].contact = i;
+	}
+	allocator->deallocate(buff);
+
+	m_numUsed = numPairs;
+	m_numFree = 0;
+}
+
+};	// namespace SimplePhysics
\ No newline at end of file
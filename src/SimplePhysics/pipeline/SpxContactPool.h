@@ -0,0 +1,80 @@
+#pragma once
+
+#include "../SpxBase.h"
+#include "../elements/SpxContact.h"
+#include "../elements/SpxPair.h"
+#include "SpxAllocator.h"
+
+namespace SimplePhysics
+{
+	/**
+	 * @brief 衝突情報を連続したメモリにまとめて保持するプール
+	 * ペアは衝突情報をポインタではなくインデックスで参照する。
+	 * 解放された要素はフリーリストで再利用し、compact() で生きている要素を先頭に詰め直す。
+	 *
+	 */
+	class SpxContactPool
+	{
+	public:
+		/**
+		 * @param allocator 配列の確保に使うアロケータ
+		 * @param capacity 保持できる衝突情報の最大数
+		 */
+		SpxContactPool(SpxAllocator* allocator, SpxUInt32 capacity);
+		~SpxContactPool();
+
+		SpxContactPool(const SpxContactPool&) = delete;
+		SpxContactPool& operator=(const SpxContactPool&) = delete;
+
+		/**
+		 * @brief 衝突情報を1つ確保する
+		 *
+		 * @return SpxUInt32 衝突情報のインデックス(空きがなければ SPX_INVALID_CONTACT)
+		 */
+		SpxUInt32 allocate();
+
+		/**
+		 * @brief 衝突情報を解放する
+		 *
+		 * @param index 衝突情報のインデックス
+		 */
+		void deallocate(SpxUInt32 index);
+
+		/**
+		 * @brief 保持できる衝突情報の最大数を増やす
+		 * 確保済みの衝突情報のインデックスは変わらない。
+		 *
+		 * @param capacity 新しい最大数(今の最大数以下なら何もしない)
+		 * @return bool 確保に成功したかどうか
+		 */
+		bool reserve(SpxUInt32 capacity);
+
+		/**
+		 * @brief 生きている衝突情報をペアの順に先頭から詰め直す
+		 * ペアが持つインデックスも書き換えられる。
+		 *
+		 * @param pairs 生きている衝突情報を参照する全てのペア
+		 * @param numPairs ペア数
+		 * @param allocator 作業領域のためのアロケータ
+		 */
+		void compact(SpxPair* pairs, SpxUInt32 numPairs, SpxAllocator* allocator);
+
+		SpxContact& operator[](SpxUInt32 index) { return m_contacts[index]; }
+		const SpxContact& operator[](SpxUInt32 index) const { return m_contacts[index]; }
+
+		// 衝突情報の配列の先頭
+		SpxContact* getContacts() { return m_contacts; }
+		// 保持できる衝突情報の最大数
+		SpxUInt32 getCapacity() const { return m_capacity; }
+		// 使用中の衝突情報の数
+		SpxUInt32 getNumContacts() const { return m_numUsed - m_numFree; }
+
+	private:
+		SpxAllocator* m_allocator;	// 配列の確保に使うアロケータ
+		SpxContact* m_contacts;		// 衝突情報の配列
+		SpxUInt32* m_freeList;		// 解放された要素のインデックス
+		SpxUInt32 m_numFree;		// 解放された要素の数
+		SpxUInt32 m_numUsed;		// 一度でも確保された要素の数(この位置より後ろは未使用)
+		SpxUInt32 m_capacity;		// 保持できる衝突情報の最大数
+	};
+};	// namespace SimplePhysics
\ No newline at end of file
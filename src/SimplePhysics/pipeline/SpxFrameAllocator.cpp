@@ -0,0 +1,106 @@
+#include "SpxFrameAllocator.h"
+
+#include <cassert>
+
+namespace SimplePhysics
+{
+
+// 確保する領域のアライメント
+static const size_t SPX_FRAME_ALIGNMENT = 16;
+
+static inline size_t SpxAlignUp(size_t bytes)
+{
+	return (bytes + SPX_FRAME_ALIGNMENT - 1) & ~(SPX_FRAME_ALIGNMENT - 1);
+}
+
+SpxFrameAllocator::SpxFrameAllocator(SpxAllocator* backingAllocator, size_t initialBytes)
+	: m_backingAllocator(backingAllocator),
+	  m_head(nullptr),
+	  m_capacity(0),
+	  m_used(0),
+	  m_highWaterMark(0),
+	  m_numBlockAllocations(0)
+{
+	assert(backingAllocator);
+	addBlock(SpxAlignUp(initialBytes));
+}
+
+SpxFrameAllocator::~SpxFrameAllocator()
+{
+	releaseBlocks();
+}
+
+void* SpxFrameAllocator::allocate(size_t bytes)
+{
+	bytes = SpxAlignUp(bytes);
+
+	if (!m_head || m_head->used + bytes > m_head->size)
+	{
+		// 足りなくなったら、これまでの2倍以上の大きさのブロックを追加する
+		size_t blockSize = m_head ? m_head->size * 2 : SPX_FRAME_ALIGNMENT;
+		if (!addBlock(blockSize > bytes ? blockSize : bytes)) { return nullptr; }
+	}
+
+	// ヘッダの後ろの領域もアライメントを揃える
+	void* p = reinterpret_cast<char*>(m_head) + SpxAlignUp(sizeof(Block)) + m_head->used;
+	m_head->used += bytes;
+	m_used += bytes;
+	if (m_used > m_highWaterMark) { m_highWaterMark = m_used; }
+
+	return p;
+}
+
+void SpxFrameAllocator::reset()
+{
+	// 前のステップで複数のブロックを使った場合は、最大使用量を収められる1つのブロックにまとめる
+	if (m_head && m_head->next)
+	{
+		size_t capacity = m_capacity;
+		releaseBlocks();
+		addBlock(capacity > m_highWaterMark ? capacity : m_highWaterMark);
+	}
+
+	if (m_head) { m_head->used = 0; }
+	m_used = 0;
+}
+
+SpxFrameAllocator::Marker SpxFrameAllocator::getMarker() const
+{
+	return Marker{m_head, m_head ? m_head->used : 0, m_used};
+}
+
+void SpxFrameAllocator::rewind(const Marker& marker)
+{
+	// 記録した後にブロックを追加していなければ、そのブロックの使用済みの位置を戻す
+	// 追加していた場合は、新しいブロックを先頭から使い直す(古いブロックの残りは次の reset() まで使わない)
+	if (m_head && m_head == marker.block) { m_head->used = marker.blockUsed; }
+	else if (m_head) { m_head->used = 0; }
+	m_used = marker.used;
+}
+
+bool SpxFrameAllocator::addBlock(size_t bytes)
+{
+	Block* block = static_cast<Block*>(m_backingAllocator->allocate(SpxAlignUp(sizeof(Block)) + bytes));
+	if (!block) { return false; }
+
+	block->next = m_head;
+	block->size = bytes;
+	block->used = 0;
+	m_head = block;
+	m_capacity += bytes;
+	m_numBlockAllocations++;
+	return true;
+}
+
+void SpxFrameAllocator::releaseBlocks()
+{
+	while (m_head)
+	{
+		Block* next = m_head->next;
+		m_backingAllocator->deallocate(m_head);
+		m_head = next;
+	}
+	m_capacity = 0;
+}
+
+};	// namespace SimplePhysics
\ No newline at end of file
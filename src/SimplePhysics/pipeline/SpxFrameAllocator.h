@@ -0,0 +1,110 @@
+#pragma once
+
+#include "../SpxBase.h"
+#include "SpxAllocator.h"
+
+namespace SimplePhysics
+{
+	/**
+	 * @brief 1ステップの間だけ使う作業領域のための線形アロケータ
+	 * 確保はポインタを進めるだけで、解放は reset() でまとめて行う。
+	 * 容量が足りなくなったときだけ元のアロケータからブロックを確保し、
+	 * 次の reset() で使用量の最大値を収められる1つのブロックにまとめ直す。
+	 * そのため、使用量が最大値を超えない限りヒープ確保は起こらない。
+	 *
+	 */
+	class SpxFrameAllocator : public SpxAllocator
+	{
+	public:
+		/**
+		 * @param backingAllocator ブロックの確保に使うアロケータ
+		 * @param initialBytes 最初のブロックの大きさ
+		 */
+		SpxFrameAllocator(SpxAllocator* backingAllocator, size_t initialBytes = 64 * 1024);
+		~SpxFrameAllocator();
+
+		SpxFrameAllocator(const SpxFrameAllocator&) = delete;
+		SpxFrameAllocator& operator=(const SpxFrameAllocator&) = delete;
+
+		void* allocate(size_t bytes) override;
+
+		// 個別には解放しない(reset() でまとめて解放する)
+		void deallocate(void* p) override {}
+
+		/**
+		 * @brief 確保した領域を全て解放する(ステップの先頭で呼ぶ)
+		 *
+		 */
+		void reset();
+
+		// 確保の状態(rewind で戻す位置)
+		struct Marker
+		{
+			const void* block;  // 記録した時点で使っていたブロック
+			size_t blockUsed;	// 記録した時点のブロックの使用済みの大きさ
+			size_t used;		// 記録した時点の使用量
+		};
+
+		// 現在の確保の状態を記録する
+		Marker getMarker() const;
+
+		/**
+		 * @brief 記録した時点より後に確保した領域をまとめて解放する
+		 * ステップの外(剛体の追加や命令の実行)で使う作業領域が、次の reset() まで積み上がらないようにする。
+		 * 記録した後に追加したブロックは残しておき、次の確保から先頭を使い直す。
+		 *
+		 * @param marker getMarker() で記録した状態
+		 */
+		void rewind(const Marker& marker);
+
+		// 確保済みのブロックの合計の大きさ
+		size_t getCapacity() const { return m_capacity; }
+		// 1回のステップで使われた量の最大値
+		size_t getHighWaterMark() const { return m_highWaterMark; }
+		// 元のアロケータからブロックを確保した回数
+		SpxUInt32 getNumBlockAllocations() const { return m_numBlockAllocations; }
+
+	private:
+		// ブロックの先頭に置くヘッダ
+		struct Block
+		{
+			Block* next;  // 前に確保したブロック
+			size_t size;  // ヘッダを除いた大きさ
+			size_t used;  // 使用済みの大きさ
+		};
+
+		// ブロックを確保して先頭に追加する(失敗したら false)
+		bool addBlock(size_t bytes);
+		// 全てのブロックを解放する
+		void releaseBlocks();
+
+		SpxAllocator* m_backingAllocator;  // ブロックの確保に使うアロケータ
+		Block* m_head;					   // 現在使っているブロック
+		size_t m_capacity;				   // 確保済みのブロックの合計の大きさ
+		size_t m_used;					   // 今回のステップで使われた量
+		size_t m_highWaterMark;			   // 1回のステップで使われた量の最大値
+		SpxUInt32 m_numBlockAllocations;   // 元のアロケータからブロックを確保した回数
+	};
+
+	/**
+	 * @brief 生存している間に SpxFrameAllocator から確保した領域を、破棄するときにまとめて解放する
+	 *
+	 */
+	class SpxFrameAllocatorScope
+	{
+	public:
+		explicit SpxFrameAllocatorScope(SpxFrameAllocator& allocator)
+			: m_allocator(allocator),
+			  m_marker(allocator.getMarker())
+		{
+		}
+		~SpxFrameAllocatorScope() { m_allocator.rewind(m_marker); }
+
+		SpxFrameAllocatorScope(const SpxFrameAllocatorScope&) = delete;
+		SpxFrameAllocatorScope& operator=(const SpxFrameAllocatorScope&) = delete;
+
+	private:
+		SpxFrameAllocator& m_allocator;
+		SpxFrameAllocator::Marker m_marker;
+	};
+};	// namespace SimplePhysics
\ No newline at end of file
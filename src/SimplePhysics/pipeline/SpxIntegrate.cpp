@@ -1,8 +1,151 @@
 #include "SpxIntegrate.h"
+#include "../glmExtension.h"
+#include <algorithm>
+#include <cmath>
 
 namespace SimplePhysics
 {
 
+// まとめて処理する剛体の数
+// 剛体の状態を要素ごとの配列(レーン)に並べ替えてから計算するので、レーンのループは4要素幅の命令(SSE, NEON)になる
+// ベクトル化されるように、このファイルは最適化を有効にしてビルドする(CMakelists.txt)
+static const SpxUInt32 SPX_BATCH_WIDTH = 4;
+
+// 角速度 ω で時間 dt だけ回転させるクォータニオン exp(ω dt / 2) を求める
+static inline glm::quat SpxExpMap(const glm::vec3& angularVelocity, float halfTimeStep)
+{
+	float angularSpeed = glm::length(angularVelocity);
+	float halfAngle = angularSpeed * halfTimeStep;
+
+	// sin(θ/2)/|ω| は |ω| が0に近いと桁落ちするので、テイラー展開 dt/2 * (1 - (θ/2)^2/6) で置き換える
+	float s = halfAngle < 1e-3f ? halfTimeStep * (1.0f - halfAngle * halfAngle * (1.0f / 6.0f))
+								: glm::sin(halfAngle) / angularSpeed;
+
+	return glm::quat(glm::cos(halfAngle), angularVelocity * s);
+}
+
+// 座標と姿勢を1ステップ分進める
+static inline void SpxIntegrateState(SpxState& state, float timeStep, float halfTimeStep)
+{
+	// 座標の更新
+	state.m_position += state.m_linearVelocity * timeStep;
+	// 姿勢の更新(指数写像によるクォータニオンの時間積分)
+	// 角速度が一定ならば厳密な回転になるので、1ステップに大きく回転しても精度が落ちない
+	// 正規化は丸め誤差が蓄積しないようにするためだけに行う
+	state.m_orientation = glm::normalize(SpxExpMap(state.m_angularVelocity, halfTimeStep) * state.m_orientation);
+}
+
+// SPX_BATCH_WIDTH 個の剛体の座標と姿勢を1ステップ分進める(SpxIntegrateState と同じ計算)
+static inline void SpxIntegrateStateBatch(SpxState* states, float timeStep, float halfTimeStep)
+{
+	float px[SPX_BATCH_WIDTH], py[SPX_BATCH_WIDTH], pz[SPX_BATCH_WIDTH];
+	float vx[SPX_BATCH_WIDTH], vy[SPX_BATCH_WIDTH], vz[SPX_BATCH_WIDTH];
+	float wx[SPX_BATCH_WIDTH], wy[SPX_BATCH_WIDTH], wz[SPX_BATCH_WIDTH];
+	float qx[SPX_BATCH_WIDTH], qy[SPX_BATCH_WIDTH], qz[SPX_BATCH_WIDTH], qw[SPX_BATCH_WIDTH];
+	for (SpxUInt32 k = 0; k < SPX_BATCH_WIDTH; k++)
+	{
+		const SpxState& state = states[k];
+		px[k] = state.m_position.x;
+		py[k] = state.m_position.y;
+		pz[k] = state.m_position.z;
+		vx[k] = state.m_linearVelocity.x;
+		vy[k] = state.m_linearVelocity.y;
+		vz[k] = state.m_linearVelocity.z;
+		wx[k] = state.m_angularVelocity.x;
+		wy[k] = state.m_angularVelocity.y;
+		wz[k] = state.m_angularVelocity.z;
+		qx[k] = state.m_orientation.x;
+		qy[k] = state.m_orientation.y;
+		qz[k] = state.m_orientation.z;
+		qw[k] = state.m_orientation.w;
+	}
+
+	// 座標の更新
+	for (SpxUInt32 k = 0; k < SPX_BATCH_WIDTH; k++)
+	{
+		px[k] += vx[k] * timeStep;
+		py[k] += vy[k] * timeStep;
+		pz[k] += vz[k] * timeStep;
+	}
+
+	// 指数写像の回転角と、|ω| が0に近いときに sin(θ/2)/|ω| の代わりに使うテイラー展開(SpxExpMap と同じ)
+	float angularSpeed[SPX_BATCH_WIDTH], halfAngle[SPX_BATCH_WIDTH], taylor[SPX_BATCH_WIDTH];
+	for (SpxUInt32 k = 0; k < SPX_BATCH_WIDTH; k++)
+	{
+		angularSpeed[k] = std::sqrt(wx[k] * wx[k] + wy[k] * wy[k] + wz[k] * wz[k]);
+		halfAngle[k] = angularSpeed[k] * halfTimeStep;
+		taylor[k] = halfTimeStep * (1.0f - halfAngle[k] * halfAngle[k] * (1.0f / 6.0f));
+	}
+
+	// 三角関数はベクトル化されないので、このループだけレーンごとに計算する
+	float exact[SPX_BATCH_WIDTH], cosHalf[SPX_BATCH_WIDTH];
+	for (SpxUInt32 k = 0; k < SPX_BATCH_WIDTH; k++)
+	{
+		exact[k] = std::sin(halfAngle[k]) / angularSpeed[k];
+		cosHalf[k] = std::cos(halfAngle[k]);
+	}
+
+	// 両方の値を求めておいて選ぶので分岐にならない
+	float scale[SPX_BATCH_WIDTH];
+	for (SpxUInt32 k = 0; k < SPX_BATCH_WIDTH; k++)
+	{
+		scale[k] = halfAngle[k] < 1e-3f ? taylor[k] : exact[k];
+	}
+
+	// 回転 exp(ω dt / 2) を姿勢に掛けて正規化する
+	for (SpxUInt32 k = 0; k < SPX_BATCH_WIDTH; k++)
+	{
+		float dx = wx[k] * scale[k];
+		float dy = wy[k] * scale[k];
+		float dz = wz[k] * scale[k];
+		float dw = cosHalf[k];
+
+		float x = dw * qx[k] + dx * qw[k] + dy * qz[k] - dz * qy[k];
+		float y = dw * qy[k] + dy * qw[k] + dz * qx[k] - dx * qz[k];
+		float z = dw * qz[k] + dz * qw[k] + dx * qy[k] - dy * qx[k];
+		float w = dw * qw[k] - dx * qx[k] - dy * qy[k] - dz * qz[k];
+
+		float lengthInv = 1.0f / std::sqrt(x * x + y * y + z * z + w * w);
+		qx[k] = x * lengthInv;
+		qy[k] = y * lengthInv;
+		qz[k] = z * lengthInv;
+		qw[k] = w * lengthInv;
+	}
+
+	for (SpxUInt32 k = 0; k < SPX_BATCH_WIDTH; k++)
+	{
+		SpxState& state = states[k];
+		state.m_position = glm::vec3(px[k], py[k], pz[k]);
+		state.m_orientation = glm::quat(qw[k], qx[k], qy[k], qz[k]);
+	}
+}
+
+// 形状の AABB を剛体の姿勢で回転させ、ワールド座標系の AABB を求める
+// 投機的な衝突点を作れるように、predictionTime の間に動く範囲まで広げる
+static inline void SpxComputeAabb(const SpxState& state, const SpxCollidable& collidable, float predictionTime, SpxAabb& aabb)
+{
+	glm::mat3 orientation(state.m_orientation);
+	glm::vec3 center = state.m_position + orientation * collidable.m_center;
+	glm::vec3 half = GLMExtension::AbsPerElem(orientation) * (collidable.m_half + glm::vec3(SPX_AABB_EXPAND));  // AABBサイズを若干拡張
+
+	// 並進は移動後の AABB と合わせた範囲、回転は剛体を囲む球の表面が動く距離だけ広げる
+	glm::vec3 displacement = state.m_linearVelocity * predictionTime;
+	float radius = glm::length(collidable.m_center) + glm::length(collidable.m_half);
+	float rotation = glm::length(state.m_angularVelocity) * radius * predictionTime;
+
+	aabb.m_center = center + 0.5f * displacement;
+	aabb.m_half = half + 0.5f * glm::abs(displacement) + glm::vec3(rotation);
+}
+
+// 描画用の姿勢を求める
+// 描画するメッシュは最初の形状に合わせるので、形状のオフセットも含める
+static inline void SpxComputeTransform(const SpxState& state, const SpxCollidable& collidable, SpxTransform& transform)
+{
+	const SpxShape& shape = collidable.m_shapes[0];
+	transform.m_position = state.m_position + state.m_orientation * shape.m_offsetPosition;
+	transform.m_orientation = state.m_orientation * shape.m_offsetQuaternion;
+}
+
 void SpxApplyExternalForce(
 	SpxState& state,
 	const SpxRigidBody& body,
@@ -11,16 +154,17 @@ void SpxApplyExternalForce(
 	float timeStep)
 {
 	if (state.m_motionType == SpxMotionTypeStatic) { return; }
+	if (state.m_motionType == SpxMotionTypeArticulated) { return; }
 
 	// 剛体の姿勢
 	glm::mat3 orientation = glm::toMat3(state.m_orientation);
 	// 現在の姿勢における慣性テンソル
 	glm::mat3 worldInertia = orientation * body.m_inertia * glm::transpose(orientation);
-	glm::mat3 worldInertiaInv = orientation * glm::inverse(body.m_inertia) * glm::transpose(orientation);
+	glm::mat3 worldInertiaInv = orientation * body.m_inertiaInv * glm::transpose(orientation);
 	glm::vec3 angularMomentum = worldInertia * state.m_angularVelocity;
 
 	// 速度/角速度の更新(オイラー陽解法)
-	state.m_linearVelocity += externalForce / body.m_mass * timeStep;
+	state.m_linearVelocity += externalForce * body.m_massInv * timeStep;
 
 	angularMomentum += externalTorque * timeStep;
 	state.m_angularVelocity = worldInertiaInv * angularMomentum;
@@ -40,22 +184,184 @@ void SpxApplyExternalForce(
 	}
 }
 
-void SpxIntegrate(
+glm::quat SpxIntegrateOrientation(
+	const glm::quat& orientation,
+	const glm::vec3& angularVelocity,
+	float timeStep)
+{
+	return glm::normalize(SpxExpMap(angularVelocity, 0.5f * timeStep) * orientation);
+}
+
+void SpxApplyGyroscopicTorque(
 	SpxState* states,
+	const SpxRigidBody* bodies,
 	SpxUInt32 numRigidBodies,
 	float timeStep)
 {
 	for (SpxUInt32 i = 0; i < numRigidBodies; i++)
 	{
 		SpxState& state = states[i];
+		const SpxRigidBody& body = bodies[i];
+
+		// 剛体のローカル座標系で解く(慣性テンソルが定数になる)
+		glm::vec3 omega = glm::inverse(state.m_orientation) * state.m_angularVelocity;
+		glm::mat3 inertia = body.m_inertia;
+		glm::vec3 angularMomentum = inertia * omega;
+
+		// 陰的オイラー法の残差 f(ω) = I(ω - ω0) + dt ω×Iω を ω = ω0 のまわりで1回だけニュートン法で解く
+		glm::vec3 f = timeStep * glm::cross(omega, angularMomentum);
+		// ヤコビアン J = I + dt ([ω]x I - [Iω]x)
+		glm::mat3 jacobian = inertia + timeStep * (GLMExtension::CrossMatrix(omega) * inertia - GLMExtension::CrossMatrix(angularMomentum));
+		omega -= glm::inverse(jacobian) * f;
+
+		state.m_angularVelocity = state.m_orientation * omega;
+	}
+}
+
+// SPX_BATCH_WIDTH 個の剛体に重力を与え、速度/角速度を最大値に制限する
+static inline void SpxApplyGravityBatch(SpxState* states, const glm::vec3& deltaVelocity, float maxAngularVelocity)
+{
+	float vx[SPX_BATCH_WIDTH], vy[SPX_BATCH_WIDTH], vz[SPX_BATCH_WIDTH];
+	float wx[SPX_BATCH_WIDTH], wy[SPX_BATCH_WIDTH], wz[SPX_BATCH_WIDTH];
+	for (SpxUInt32 k = 0; k < SPX_BATCH_WIDTH; k++)
+	{
+		vx[k] = states[k].m_linearVelocity.x;
+		vy[k] = states[k].m_linearVelocity.y;
+		vz[k] = states[k].m_linearVelocity.z;
+		wx[k] = states[k].m_angularVelocity.x;
+		wy[k] = states[k].m_angularVelocity.y;
+		wz[k] = states[k].m_angularVelocity.z;
+	}
+
+	for (SpxUInt32 k = 0; k < SPX_BATCH_WIDTH; k++)
+	{
+		vx[k] += deltaVelocity.x;
+		vy[k] += deltaVelocity.y;
+		vz[k] += deltaVelocity.z;
+	}
+
+	// 速度/角速度を最大値に制限する倍率(速度が0のときは候補が∞になり、倍率は1になる)
+	// 倍率を掛けるループを分けておくと、min が分岐にならずにベクトル化される
+	float linearScale[SPX_BATCH_WIDTH], angularScale[SPX_BATCH_WIDTH];
+	for (SpxUInt32 k = 0; k < SPX_BATCH_WIDTH; k++)
+	{
+		linearScale[k] = std::min(1.0f, SPX_MAX_LINEAR_VELOCITY / std::sqrt(vx[k] * vx[k] + vy[k] * vy[k] + vz[k] * vz[k]));
+		angularScale[k] = std::min(1.0f, maxAngularVelocity / std::sqrt(wx[k] * wx[k] + wy[k] * wy[k] + wz[k] * wz[k]));
+	}
+
+	for (SpxUInt32 k = 0; k < SPX_BATCH_WIDTH; k++)
+	{
+		vx[k] *= linearScale[k];
+		vy[k] *= linearScale[k];
+		vz[k] *= linearScale[k];
+		wx[k] *= angularScale[k];
+		wy[k] *= angularScale[k];
+		wz[k] *= angularScale[k];
+	}
+
+	for (SpxUInt32 k = 0; k < SPX_BATCH_WIDTH; k++)
+	{
+		states[k].m_linearVelocity = glm::vec3(vx[k], vy[k], vz[k]);
+		states[k].m_angularVelocity = glm::vec3(wx[k], wy[k], wz[k]);
+	}
+}
+
+void SpxApplyGravity(
+	SpxState* states,
+	SpxUInt32 numRigidBodies,
+	const glm::vec3& gravity,
+	float timeStep)
+{
+	const glm::vec3 deltaVelocity = gravity * timeStep;
+	const float maxAngularVelocity = static_cast<float>(SPX_MAX_ANGULAR_VELOCITY());
+
+	SpxUInt32 i = 0;
+	for (; i + SPX_BATCH_WIDTH <= numRigidBodies; i += SPX_BATCH_WIDTH)
+	{
+		SpxApplyGravityBatch(&states[i], deltaVelocity, maxAngularVelocity);
+	}
+
+	// 端数は1つずつ処理する
+	for (; i < numRigidBodies; i++)
+	{
+		SpxState& state = states[i];
+
+		// 重力は質量によらないので、速度に直接加える
+		glm::vec3 linearVelocity = state.m_linearVelocity + deltaVelocity;
+		glm::vec3 angularVelocity = state.m_angularVelocity;
+
+		// 速度/角速度が最大値を上回っていたら最大値に制限する
+		// 分岐を避けるため、倍率を min で求める(速度が0のときは inversesqrt が∞になり倍率は1になる)
+		float linearScale = glm::min(1.0f, SPX_MAX_LINEAR_VELOCITY * glm::inversesqrt(glm::length2(linearVelocity)));
+		float angularScale = glm::min(1.0f, maxAngularVelocity * glm::inversesqrt(glm::length2(angularVelocity)));
+
+		state.m_linearVelocity = linearVelocity * linearScale;
+		state.m_angularVelocity = angularVelocity * angularScale;
+	}
+}
+
+void SpxIntegrate(
+	SpxState* states,
+	SpxUInt32 numRigidBodies,
+	float timeStep)
+{
+	const float halfTimeStep = 0.5f * timeStep;
+
+	SpxUInt32 i = 0;
+	for (; i + SPX_BATCH_WIDTH <= numRigidBodies; i += SPX_BATCH_WIDTH)
+	{
+		SpxIntegrateStateBatch(&states[i], timeStep, halfTimeStep);
+	}
+
+	for (; i < numRigidBodies; i++)
+	{
+		SpxIntegrateState(states[i], timeStep, halfTimeStep);
+	}
+}
 
-		glm::quat dAng = glm::quat(0.0f, state.m_angularVelocity) * state.m_orientation * 0.5f;
+void SpxIntegrate(
+	SpxState* states,
+	const SpxCollidable* collidables,
+	SpxUInt32 numRigidBodies,
+	float timeStep,
+	float predictionTime,
+	SpxAabb* aabbs,
+	SpxTransform* transforms)
+{
+	const float halfTimeStep = 0.5f * timeStep;
+
+	SpxUInt32 i = 0;
+	for (; i + SPX_BATCH_WIDTH <= numRigidBodies; i += SPX_BATCH_WIDTH)
+	{
+		SpxIntegrateStateBatch(&states[i], timeStep, halfTimeStep);
+
+		// 更新した状態がキャッシュに載っているうちに AABB と姿勢を書き出す
+		for (SpxUInt32 k = i; k < i + SPX_BATCH_WIDTH; k++)
+		{
+			SpxComputeAabb(states[k], collidables[k], predictionTime, aabbs[k]);
+			SpxComputeTransform(states[k], collidables[k], transforms[k]);
+		}
+	}
+
+	for (; i < numRigidBodies; i++)
+	{
+		SpxState& state = states[i];
+		SpxIntegrateState(state, timeStep, halfTimeStep);
 
-		// 座標の更新
-		state.m_position += state.m_linearVelocity * timeStep;
-		// 姿勢の更新(クォータニオンの時間積分)
-		state.m_orientation = normalize(state.m_orientation + dAng * timeStep);
+		SpxComputeAabb(state, collidables[i], predictionTime, aabbs[i]);
+		SpxComputeTransform(state, collidables[i], transforms[i]);
 	}
 }
 
+void SpxUpdateBounds(
+	const SpxState& state,
+	const SpxCollidable& collidable,
+	float predictionTime,
+	SpxAabb& aabb,
+	SpxTransform& transform)
+{
+	SpxComputeAabb(state, collidable, predictionTime, aabb);
+	SpxComputeTransform(state, collidable, transform);
+}
+
 };	// namespace SimplePhysics
\ No newline at end of file
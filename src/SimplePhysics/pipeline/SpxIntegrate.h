@@ -3,6 +3,9 @@
 #include "../SpxBase.h"
 #include "../elements/SpxState.h"
 #include "../elements/SpxRigidBody.h"
+#include "../elements/SpxCollidable.h"
+#include "../elements/SpxAabb.h"
+#include "../elements/SpxTransform.h"
 
 namespace SimplePhysics
 {
@@ -31,10 +34,59 @@ void SpxApplyExternalForce(
 	const glm::vec3& externalTorque,
 	float timeStep);
 
+/**
+ * @brief 角速度から姿勢を1ステップ分進める
+ * 指数写像 q' = exp(ω dt / 2) q を使うので、角速度が一定ならば1ステップの回転量によらず厳密になる。
+ *
+ * @param orientation 姿勢
+ * @param angularVelocity 角速度(ワールド座標系)
+ * @param timeStep タイムステップ
+ * @return glm::quat 更新後の姿勢
+ */
+glm::quat SpxIntegrateOrientation(
+	const glm::quat& orientation,
+	const glm::vec3& angularVelocity,
+	float timeStep);
+
+/**
+ * @brief ジャイロ効果によるトルクを陰的に与える
+ * 慣性テンソルが等方的でない剛体は、外力がなくても角速度の向きが変わる(ω×Iω の項)。
+ * 陽的に扱うと大きなタイムステップでエネルギーが増えて発散するので、
+ * 陰的オイラー法をニュートン法1回で近似して解く。慣性テンソルが単位行列の倍数なら何も変わらない。
+ *
+ * @param states 剛体の状態の配列(全て SpxMotionTypeActive であること)
+ * @param bodies 剛体の属性の配列
+ * @param numRigidBodies 剛体の数
+ * @param timeStep タイムステップ
+ */
+void SpxApplyGyroscopicTorque(
+	SpxState* states,
+	const SpxRigidBody* bodies,
+	SpxUInt32 numRigidBodies,
+	float timeStep);
+
+/**
+ * @brief 剛体の配列に重力を与える
+ * 4つずつ要素ごとの配列に並べ替え、分岐のない4要素幅のループで計算する(端数は1つずつ処理する)。
+ * トルクがないので角運動量は変わらず、角速度は最大値の制限だけを行う。
+ *
+ * @param states 剛体の状態の配列(全て SpxMotionTypeActive であること)
+ * @param numRigidBodies 剛体の数
+ * @param gravity 重力加速度
+ * @param timeStep タイムステップ
+ */
+void SpxApplyGravity(
+	SpxState* states,
+	SpxUInt32 numRigidBodies,
+	const glm::vec3& gravity,
+	float timeStep);
+
 /**
  * @brief ソルバーの演算の結果を剛体の状態に適用
+ * 座標と姿勢の更新は SpxApplyGravity と同じく4つずつまとめて計算する(三角関数だけは1つずつ求める)。
+ * 固定された剛体や多関節体のリンクは、配列の範囲から外して渡すこと。
  *
- * @param states 剛体の状態の配列
+ * @param states 剛体の状態の配列(全て SpxMotionTypeActive であること)
  * @param numRigidBodies 剛体の数
  * @param timeStep タイムステップ
  */
@@ -43,4 +95,44 @@ void SpxIntegrate(
 	SpxUInt32 numRigidBodies,
 	float timeStep);
 
+/**
+ * @brief ソルバーの演算の結果を剛体の状態に適用し、AABB と描画用の姿勢も書き出す
+ * 位置更新、次のステップのブロードフェーズで使う AABB の計算、描画側に渡す姿勢の書き出しを
+ * 1回のループで行うので、剛体の状態を読み込むのは1ステップにつき1回で済む。
+ * ステップの最後の位置更新ではこちらを使う。
+ *
+ * @param states 剛体の状態の配列(全て SpxMotionTypeActive であること)
+ * @param collidables 剛体の形状の配列
+ * @param numRigidBodies 剛体の数
+ * @param timeStep タイムステップ
+ * @param predictionTime AABB を広げる時間(次のステップで動く範囲を含めるため、通常は1ステップの時間)
+ * @param[out] aabbs 剛体のワールド座標系の AABB の配列
+ * @param[out] transforms 描画用の姿勢の配列(最初の形状のオフセットを含む)
+ */
+void SpxIntegrate(
+	SpxState* states,
+	const SpxCollidable* collidables,
+	SpxUInt32 numRigidBodies,
+	float timeStep,
+	float predictionTime,
+	SpxAabb* aabbs,
+	SpxTransform* transforms);
+
+/**
+ * @brief 剛体の AABB と描画用の姿勢を計算する
+ * 位置更新を SpxIntegrate 以外で行う剛体(多関節体のリンクや新しく登録した剛体)に使う。
+ *
+ * @param state 剛体の状態
+ * @param collidable 剛体の形状
+ * @param predictionTime AABB を広げる時間
+ * @param[out] aabb 剛体のワールド座標系の AABB
+ * @param[out] transform 描画用の剛体の姿勢
+ */
+void SpxUpdateBounds(
+	const SpxState& state,
+	const SpxCollidable& collidable,
+	float predictionTime,
+	SpxAabb& aabb,
+	SpxTransform& transform);
+
 };	// namespace SimplePhysics
\ No newline at end of file
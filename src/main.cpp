@@ -1,12 +1,40 @@
 #include "Core.h"
+#include "InputSystem.h"
 
-int main ()
+#include <cstdlib>
+#include <cstring>
+
+int main (int argc, char* argv[])
 {
+	// --headless [フレーム数] でウィンドウを作らずに指定したフレーム数だけ実行し、処理速度を出力する
+	bool headless = false;
+	int numFrames = 1000;
+	for (int i = 1; i < argc; i++)
+	{
+		if (std::strcmp(argv[i], "--headless") == 0)
+		{
+			headless = true;
+			if (i + 1 < argc && std::atoi(argv[i + 1]) > 0)
+			{
+				numFrames = std::atoi(argv[++i]);
+			}
+		}
+	}
+
 	Core core;
-	bool success = core.Initialize();
+	bool success = core.Initialize(headless);
 	if (success)
 	{
-		core.RunLoop();
+		if (headless)
+		{
+			// 30フレームごとにスペースキーを1フレームだけ押して、キューブを撃ち出す
+			core.RunHeadless(numFrames, [](int frame, InputSystem& input) {
+				input.SetKeyValue(SDL_SCANCODE_SPACE, frame % 30 == 0);
+			});
+		}
+		else {
+			core.RunLoop();
+		}
 	}
 	core.Shutdown();
 
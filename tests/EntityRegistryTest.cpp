@@ -0,0 +1,167 @@
+// EntityRegistry の単体テストとベンチマーク
+// 引数なしで正しさのテストと、姿勢だけを持つ 100000 個のエンティティのワールド変換の計算時間の計測を行い、
+// 失敗があれば 1 を返す。--bench を付けると計測の回数を増やし、目標の時間に収まることも確かめる。
+
+#include "EntityRegistry.h"
+#include "JobSystem.h"
+#include "TestCheck.h"
+
+#include <SDL.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+// ワールド変換を計算するエンティティの数
+const int kNumEntities = 100000;
+// 全てのワールド変換の計算にかかる時間(最良値)の上限
+// 通常の実行では共有のマシンでも揺らがないように、桁違いに遅くなる退行だけを検出する緩い上限を使う。
+// --bench では目標(1 ms を十分に下回る)を上限にする。
+const double kRegressionBudgetMs = 20.0;
+const double kTargetBudgetMs = 1.0;
+
+double Seconds(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// 容量に達したら、配列を拡張せずに作成が失敗すること
+void TestCreateDoesNotGrow()
+{
+	EntityRegistry entities(4);
+	std::vector<Entity> created;
+	for (int i = 0; i < 4; i++) { created.push_back(entities.CreateEntity()); }
+	for (Entity entity : created) { CHECK(entities.IsValid(entity)); }
+	CHECK(entities.IsFull());
+
+	// 作成の失敗で姿勢の配列が移動していないこと
+	const glm::vec3* position = &entities.GetPosition(created[0]);
+	CHECK(entities.CreateEntity() == INVALID_ENTITY);
+	CHECK(entities.GetNumEntities() == 4);
+	CHECK(&entities.GetPosition(created[0]) == position);
+
+	// 削除したスロットは容量の範囲で再利用できる
+	entities.DestroyEntity(created[1]);
+	CHECK(!entities.IsValid(created[1]));
+	Entity reused = entities.CreateEntity();
+	CHECK(entities.IsValid(reused));
+	CHECK(reused != created[1]);
+
+	// 拡張した後は作成できる
+	CHECK(entities.Reserve(8));
+	CHECK(entities.GetCapacity() == 8);
+	CHECK(entities.IsValid(entities.CreateEntity()));
+}
+
+// 並列の更新中に容量を超えて作成しても、他のエンティティの姿勢の読み書きが壊れないこと
+void TestCreateDuringParallelUpdate(JobSystem& jobSystem)
+{
+	const int numEntities = 1000;
+	EntityRegistry entities(numEntities + 100);
+	std::vector<Entity> existing;
+	for (int i = 0; i < numEntities; i++) { existing.push_back(entities.CreateEntity()); }
+
+	std::vector<Entity> created(numEntities, INVALID_ENTITY);
+	jobSystem.ParallelFor(0, numEntities, 16, [&](int first, int last) {
+		for (int i = first; i < last; i++)
+		{
+			entities.SetPosition(existing[i], glm::vec3((float)i, 0.0f, 0.0f));
+			// 125 個作成しようとして、容量を超える 25 個は失敗する
+			if (i % 8 == 0) { created[i] = entities.CreateEntity(); }
+		}
+	});
+
+	int numCreated = 0;
+	for (Entity entity : created) { numCreated += entities.IsValid(entity); }
+	CHECK(numCreated == 100);
+	CHECK(entities.GetNumEntities() == numEntities + 100);
+	for (int i = 0; i < numEntities; i++) { CHECK(entities.GetPosition(existing[i]).x == (float)i); }
+}
+
+// 変更した姿勢のワールド変換がまとめて計算されること
+void TestUpdateWorldTransforms(JobSystem& jobSystem)
+{
+	EntityRegistry entities(kNumEntities);
+	std::vector<Entity> created;
+	for (int i = 0; i < kNumEntities; i++) { created.push_back(entities.CreateEntity()); }
+
+	for (int i = 0; i < kNumEntities; i += 7)
+	{
+		entities.SetPosition(created[i], glm::vec3(1.0f, (float)i, 2.0f));
+		entities.SetScale(created[i], glm::vec3(2.0f));
+	}
+	entities.UpdateWorldTransforms(&jobSystem);
+
+	int wrong = 0;
+	for (int i = 0; i < kNumEntities; i++)
+	{
+		const glm::mat4& world = entities.GetWorldTransform(created[i]);
+		bool moved = i % 7 == 0;
+		wrong += world[3][1] != (moved ? (float)i : 0.0f);
+		wrong += world[0][0] != (moved ? 2.0f : 1.0f);
+		// 計算し直した後は古くなっていない
+		wrong += entities.ComputeWorldTransform(created[i]);
+	}
+	CHECK(wrong == 0);
+}
+
+// 姿勢だけを持つエンティティの全てのワールド変換を計算し直す時間を測る
+void Benchmark(JobSystem& jobSystem, int scale, double budgetMs)
+{
+	EntityRegistry entities(kNumEntities);
+	std::vector<Entity> created;
+	for (int i = 0; i < kNumEntities; i++) { created.push_back(entities.CreateEntity()); }
+
+	const int repeats = 20 * scale;
+	JobSystem* jobSystems[] = {nullptr, &jobSystem};
+	for (JobSystem* system : jobSystems)
+	{
+		// 毎回全てのエンティティを動かしてから計算する(姿勢の書き込みは計測に含めない)
+		double best = 1e9;
+		double total = 0.0;
+		for (int r = 0; r < repeats; r++)
+		{
+			for (int i = 0; i < kNumEntities; i++)
+			{
+				entities.SetPosition(created[i], glm::vec3((float)i, (float)r, 0.0f));
+			}
+
+			auto start = std::chrono::steady_clock::now();
+			entities.UpdateWorldTransforms(system);
+			double seconds = Seconds(start);
+			best = std::min(best, seconds);
+			total += seconds;
+		}
+		std::printf("UpdateWorldTransforms (%s): %d entities, best %.3f ms, average %.3f ms (budget %.1f ms)\n",
+					system ? "jobs" : "single thread", kNumEntities, best * 1e3, total / repeats * 1e3, budgetMs);
+		CHECK(best * 1e3 < budgetMs);
+	}
+}
+};	// namespace
+
+int main(int argc, char* argv[])
+{
+	int scale = 1;
+	double budgetMs = kRegressionBudgetMs;
+	for (int i = 1; i < argc; i++)
+	{
+		if (std::strcmp(argv[i], "--bench") == 0)
+		{
+			scale = 10;
+			budgetMs = kTargetBudgetMs;
+		}
+	}
+
+	JobSystem jobSystem;
+	std::printf("JobSystem with %d workers\n", jobSystem.GetNumWorkers());
+
+	TestCreateDoesNotGrow();
+	TestCreateDuringParallelUpdate(jobSystem);
+	TestUpdateWorldTransforms(jobSystem);
+	Benchmark(jobSystem, scale, budgetMs);
+
+	return ReportChecks();
+}
\ No newline at end of file
@@ -0,0 +1,322 @@
+// JobSystem の単体テストとベンチマーク
+// 引数なしで正しさのストレステストとベンチマークを行い、失敗があれば 1 を返す。
+// --bench を付けるとベンチマークの回数を増やす。
+
+#include "JobSystem.h"
+#include "TestCheck.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <thread>
+#include <vector>
+
+namespace
+{
+// operator new が呼ばれた回数(全スレッド)
+std::atomic<long> gNumAllocations{0};
+
+double Seconds(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// キューの環状バッファが、端で折り返しても拡張しても、積んだ順番を保つこと
+void TestRingDeque()
+{
+	RingDeque<int> deque(4);
+	int value = -1;
+	CHECK(!deque.PopBack(value));
+	CHECK(!deque.PopFront(value));
+
+	// 先頭を進めてから積み、配列の端で折り返させる
+	int next = 0;
+	int front = 0;
+	for (int i = 0; i < 3; i++) { deque.PushBack(next++); }
+	for (int i = 0; i < 2; i++)
+	{
+		CHECK(deque.PopFront(value) && value == front++);
+	}
+	for (int i = 0; i < 3; i++) { deque.PushBack(next++); }
+	CHECK(deque.Size() == 4);
+	CHECK(deque.Capacity() == 4);
+
+	// 折り返した状態で拡張しても、先頭から順に並んでいる
+	for (int i = 0; i < 5; i++) { deque.PushBack(next++); }
+	CHECK(deque.Capacity() == 16);
+	CHECK(deque.Size() == 9);
+
+	// 末尾からは積んだ逆順、先頭からは積んだ順に取り出せる
+	CHECK(deque.PopBack(value) && value == --next);
+	CHECK(deque.PopBack(value) && value == --next);
+	while (deque.PopFront(value))
+	{
+		CHECK(value == front++);
+	}
+	CHECK(front == next);
+	CHECK(deque.Size() == 0);
+
+	// 容量の範囲で出し入れを繰り返しても拡張しない
+	for (int round = 0; round < 100; round++)
+	{
+		for (int i = 0; i < 16; i++) { deque.PushBack(next++); }
+		for (int i = 0; i < 16; i++) { CHECK(deque.PopFront(value) && value == front++); }
+	}
+	CHECK(deque.Capacity() == 16);
+}
+
+// ParallelFor が範囲の全てのインデックスをちょうど1回ずつ処理すること
+void TestParallelForCoversEachIndexOnce(JobSystem& jobSystem)
+{
+	const int sizes[] = {0, 1, 7, 1000, 100003};
+	const int grains[] = {1, 3, 64, 1000, 200000};
+
+	for (int size : sizes)
+	{
+		for (int grain : grains)
+		{
+			std::vector<std::atomic<int>> counts(size);
+			for (auto& count : counts) { count.store(0); }
+
+			jobSystem.ParallelFor(0, size, grain, [&counts](int first, int last) {
+				for (int i = first; i < last; i++) { counts[i].fetch_add(1, std::memory_order_relaxed); }
+			});
+
+			int wrong = 0;
+			for (auto& count : counts) { wrong += count.load() != 1; }
+			CHECK(wrong == 0);
+		}
+	}
+
+	// 先頭が0以外の範囲
+	std::vector<std::atomic<int>> counts(100);
+	for (auto& count : counts) { count.store(0); }
+	jobSystem.ParallelFor(40, 100, 7, [&counts](int first, int last) {
+		for (int i = first; i < last; i++) { counts[i].fetch_add(1); }
+	});
+	for (int i = 0; i < 100; i++) { CHECK(counts[i].load() == (i >= 40 ? 1 : 0)); }
+}
+
+// 依存するカウンタが0になってから継続ジョブが実行されること
+void TestDependencies(JobSystem& jobSystem)
+{
+	for (int repeat = 0; repeat < 200; repeat++)
+	{
+		const int numJobs = 64;
+		std::atomic<int> finished{0};
+		std::atomic<int> seenByContinuation{-1};
+		std::atomic<int> seenByChain{-1};
+
+		JobCounter first;
+		JobCounter second;
+		JobCounter third;
+		for (int i = 0; i < numJobs; i++)
+		{
+			jobSystem.Schedule([&finished]() { finished.fetch_add(1); }, &first);
+		}
+		// first の全てのジョブが終わってから実行される
+		jobSystem.Schedule([&finished, &seenByContinuation]() { seenByContinuation.store(finished.load()); }, &second, &first);
+		// second の継続ジョブが終わってから実行される
+		jobSystem.Schedule([&seenByContinuation, &seenByChain]() { seenByChain.store(seenByContinuation.load()); }, &third, &second);
+
+		jobSystem.Wait(third);
+		jobSystem.Wait(second);
+		jobSystem.Wait(first);
+		CHECK(seenByContinuation.load() == numJobs);
+		CHECK(seenByChain.load() == numJobs);
+	}
+
+	// 終わっているカウンタに依存するジョブはすぐに登録される
+	JobCounter done;
+	JobCounter counter;
+	std::atomic<bool> ran{false};
+	jobSystem.Schedule([&ran]() { ran.store(true); }, &counter, &done);
+	jobSystem.Wait(counter);
+	CHECK(ran.load());
+}
+
+// ジョブの中から別のジョブを待ってもデッドロックしないこと
+void TestNestedWait(JobSystem& jobSystem)
+{
+	const int numOuter = 4 * jobSystem.GetNumThreads();
+	const int numInner = 1000;
+	std::atomic<long long> sum{0};
+
+	jobSystem.ParallelFor(0, numOuter, 1, [&jobSystem, &sum](int first, int last) {
+		for (int i = first; i < last; i++)
+		{
+			// ParallelFor の中の ParallelFor
+			jobSystem.ParallelFor(0, numInner, 16, [&sum](int innerFirst, int innerLast) {
+				for (int j = innerFirst; j < innerLast; j++) { sum.fetch_add(j, std::memory_order_relaxed); }
+			});
+
+			// ジョブの中で登録したジョブを待つ
+			JobCounter counter;
+			for (int j = 0; j < 8; j++)
+			{
+				jobSystem.Schedule([&sum]() { sum.fetch_add(1, std::memory_order_relaxed); }, &counter);
+			}
+			jobSystem.Wait(counter);
+		}
+	});
+
+	long long expected = (long long)numOuter * ((long long)numInner * (numInner - 1) / 2 + 8);
+	CHECK(sum.load() == expected);
+}
+
+// ジョブの中にいるかどうかを、ジョブを実行しているスレッドごとに判定できること
+void TestIsInJob(JobSystem& jobSystem)
+{
+	CHECK(!JobSystem::IsInJob());
+
+	std::atomic<int> outside{0};
+	jobSystem.ParallelFor(0, 1000, 10, [&outside](int first, int last) {
+		if (!JobSystem::IsInJob()) { outside.fetch_add(last - first); }
+	});
+	// 呼び出したスレッドが範囲の一部を直接処理する場合も、ジョブの中として扱われる
+	CHECK(outside.load() == 0);
+	CHECK(!JobSystem::IsInJob());
+}
+
+// ワーカー以外の複数のスレッドから同時に使えること
+void TestExternalThreads(JobSystem& jobSystem)
+{
+	// 専用のキューの数より多いスレッドも、最後のキューを共有して動く
+	const int numThreads = 6;
+	const int size = 50000;
+	std::vector<int> wrong(numThreads, 0);
+	std::vector<std::thread> threads;
+
+	for (int t = 0; t < numThreads; t++)
+	{
+		threads.emplace_back([&jobSystem, &wrong, t, size]() {
+			for (int repeat = 0; repeat < 20; repeat++)
+			{
+				std::vector<std::atomic<int>> counts(size);
+				for (auto& count : counts) { count.store(0); }
+				jobSystem.ParallelFor(0, size, 128, [&counts](int first, int last) {
+					for (int i = first; i < last; i++) { counts[i].fetch_add(1, std::memory_order_relaxed); }
+				});
+				for (auto& count : counts) { wrong[t] += count.load() != 1; }
+			}
+		});
+	}
+	for (auto& thread : threads) { thread.join(); }
+	for (int t = 0; t < numThreads; t++) { CHECK(wrong[t] == 0); }
+}
+
+// キューが十分に育った後は、ジョブの登録と実行でメモリを確保しないこと
+void TestNoAllocationsInSteadyState(JobSystem& jobSystem)
+{
+	std::vector<float> values(1 << 16, 1.0f);
+	auto run = [&jobSystem, &values]() {
+		jobSystem.ParallelFor(0, (int)values.size(), 64, [&values](int first, int last) {
+			for (int i = first; i < last; i++) { values[i] = values[i] * 0.5f + 0.5f; }
+		});
+
+		JobCounter counter;
+		for (int i = 0; i < 100; i++)
+		{
+			jobSystem.Schedule([&values, i]() { values[i] += 1.0f; }, &counter);
+		}
+		jobSystem.Wait(counter);
+	};
+
+	// 最初の数回でキューを必要な大きさまで拡張させる
+	for (int i = 0; i < 10; i++) { run(); }
+
+	long before = gNumAllocations.load();
+	for (int i = 0; i < 100; i++) { run(); }
+	long allocations = gNumAllocations.load() - before;
+	if (allocations != 0) { std::fprintf(stderr, "%ld allocations in steady state\n", allocations); }
+	CHECK(allocations == 0);
+}
+
+// 1秒あたりに実行できるジョブの数を測る
+void Benchmark(JobSystem& jobSystem, int scale)
+{
+	// 空のジョブを登録して待つ(登録と取り出しのオーバーヘッド)
+	{
+		const int numJobs = 100000 * scale;
+		std::atomic<int> executed{0};
+		auto start = std::chrono::steady_clock::now();
+		JobCounter counter;
+		for (int i = 0; i < numJobs; i++)
+		{
+			jobSystem.Schedule([&executed]() { executed.fetch_add(1, std::memory_order_relaxed); }, &counter);
+		}
+		jobSystem.Wait(counter);
+		double seconds = Seconds(start);
+		CHECK(executed.load() == numJobs);
+		std::printf("Schedule/Wait: %d jobs in %.3f ms (%.2f M jobs/s)\n", numJobs, seconds * 1e3, numJobs / seconds * 1e-6);
+	}
+
+	// 細かい粒度の ParallelFor(1ジョブあたり 64 要素)
+	{
+		const int size = 1 << 20;
+		const int repeats = 20 * scale;
+		std::vector<float> values(size, 1.0f);
+		auto start = std::chrono::steady_clock::now();
+		for (int r = 0; r < repeats; r++)
+		{
+			jobSystem.ParallelFor(0, size, 64, [&values](int first, int last) {
+				for (int i = first; i < last; i++) { values[i] = values[i] * 0.5f + 0.5f; }
+			});
+		}
+		double seconds = Seconds(start);
+		double numJobs = (double)repeats * (size / 64);
+		std::printf("ParallelFor: %d x %d elements in %.3f ms (%.2f M jobs/s)\n", repeats, size, seconds * 1e3, numJobs / seconds * 1e-6);
+	}
+}
+};	// namespace
+
+void* operator new(std::size_t size)
+{
+	gNumAllocations.fetch_add(1, std::memory_order_relaxed);
+	if (void* ptr = std::malloc(size ? size : 1)) { return ptr; }
+	throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept
+{
+	std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept
+{
+	std::free(ptr);
+}
+
+int main(int argc, char* argv[])
+{
+	int scale = 1;
+	for (int i = 1; i < argc; i++)
+	{
+		if (std::strcmp(argv[i], "--bench") == 0) { scale = 10; }
+	}
+
+	TestRingDeque();
+
+	// ワーカーの数を変えて調べる(0ならハードウェアのスレッド数に合わせる)
+	for (int numWorkers : {1, 3, 0})
+	{
+		JobSystem jobSystem(numWorkers);
+		std::printf("JobSystem with %d workers\n", jobSystem.GetNumWorkers());
+
+		auto start = std::chrono::steady_clock::now();
+		TestParallelForCoversEachIndexOnce(jobSystem);
+		TestDependencies(jobSystem);
+		TestNestedWait(jobSystem);
+		TestIsInJob(jobSystem);
+		TestExternalThreads(jobSystem);
+		TestNoAllocationsInSteadyState(jobSystem);
+		std::printf("Stress tests: %.1f ms\n", Seconds(start) * 1e3);
+
+		Benchmark(jobSystem, scale);
+	}
+
+	return ReportChecks();
+}
\ No newline at end of file
@@ -0,0 +1,131 @@
+// PhysicsWorld の定常状態のメモリ確保のテスト
+// 剛体が落ち着くまでステップを進めた後、さらにステップを進めてもヒープ確保が増えないことを確かめる。
+// 作業領域のブロック、剛体や衝突情報の配列、operator new(ジョブの登録などを含む)の全てを数える。
+
+#include "PhysicsWorld.h"
+#include "JobSystem.h"
+#include "TestCheck.h"
+
+#include <SDL.h>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+namespace
+{
+// operator new が呼ばれた回数(全スレッド)
+std::atomic<long> gNumAllocations{0};
+
+// 落ち着くまでに進めるステップ数と、確保が増えないことを確かめるステップ数
+const int kNumWarmupSteps = 150;
+const int kNumCheckedSteps = 150;
+
+struct Scenario
+{
+	const char* name;
+	SimplePhysics::SpxSolverType solverType;
+	int reorderInterval;
+	bool useJobSystem;
+};
+
+// 地面の上に箱を1段に並べる
+// 積み重ねた箱は数秒後に崩れてペアの数が変わるので、全ての箱が地面にだけ接して落ち着くようにする
+// 並列に処理されるように、箱の数はジョブ1つが受け持つ剛体の数より多くする
+void CreateScene(PhysicsWorld& world)
+{
+	std::vector<RigidbodyDesc> descs;
+
+	RigidbodyDesc ground;
+	ground.position = glm::vec3(0.0f, -1.0f, 0.0f);
+	ground.scale = glm::vec3(80.0f, 1.0f, 80.0f);
+	ground.motionType = SimplePhysics::SpxMotionTypeStatic;
+	descs.push_back(ground);
+
+	for (int z = 0; z < 25; z++)
+	{
+		for (int x = 0; x < 25; x++)
+		{
+			RigidbodyDesc box;
+			box.position = glm::vec3((x - 12) * 3.0f, 1.0f, (z - 12) * 3.0f);
+			descs.push_back(box);
+		}
+	}
+
+	std::vector<int> ids(descs.size());
+	int numAdded = world.AddRigidbodies(descs.data(), (int)descs.size(), ids.data());
+	CHECK(numAdded == (int)descs.size());
+}
+
+void TestSteadyStateAllocations(const Scenario& scenario, JobSystem& jobSystem)
+{
+	PhysicsWorld world;
+	world.SetSolverType(scenario.solverType);
+	world.SetReorderInterval(scenario.reorderInterval);
+	if (scenario.useJobSystem) { world.SetJobSystem(&jobSystem); }
+	CreateScene(world);
+
+	for (int i = 0; i < kNumWarmupSteps; i++) { world.Simulate(); }
+
+	const SimplePhysics::SpxFrameAllocator& frameAllocator = world.GetFrameAllocator();
+	SimplePhysics::SpxUInt32 blocksBefore = frameAllocator.getNumBlockAllocations();
+	SimplePhysics::SpxUInt32 worldBefore = world.GetNumAllocations();
+	long newBefore = gNumAllocations.load();
+	int contactsBefore = world.GetNumContacts();
+
+	for (int i = 0; i < kNumCheckedSteps; i++) { world.Simulate(); }
+
+	SimplePhysics::SpxUInt32 blocks = frameAllocator.getNumBlockAllocations() - blocksBefore;
+	SimplePhysics::SpxUInt32 worldAllocations = world.GetNumAllocations() - worldBefore;
+	long newAllocations = gNumAllocations.load() - newBefore;
+
+	std::printf("%s: %d contacts (%d after warm-up), frame allocator %zu bytes, "
+				"%u block / %u world / %ld new allocations in %d steps\n",
+				scenario.name, world.GetNumContacts(), contactsBefore, frameAllocator.getCapacity(),
+				blocks, worldAllocations, newAllocations, kNumCheckedSteps);
+
+	CHECK(blocks == 0);
+	CHECK(worldAllocations == 0);
+	CHECK(newAllocations == 0);
+}
+};	// namespace
+
+void* operator new(std::size_t size)
+{
+	gNumAllocations.fetch_add(1, std::memory_order_relaxed);
+	if (void* ptr = std::malloc(size ? size : 1)) { return ptr; }
+	throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept
+{
+	std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept
+{
+	std::free(ptr);
+}
+
+int main(int argc, char* argv[])
+{
+	// 処理時間の計測に使うタイマーを初期化する
+	SDL_Init(SDL_INIT_TIMER);
+
+	JobSystem jobSystem(3);
+
+	const Scenario scenarios[] = {
+		{"PGS", SimplePhysics::SpxSolverTypePGS, 0, false},
+		{"PGS + jobs + reorder", SimplePhysics::SpxSolverTypePGS, 10, true},
+		{"SoftStep + jobs", SimplePhysics::SpxSolverTypeSoftStep, 0, true},
+	};
+	for (const Scenario& scenario : scenarios)
+	{
+		TestSteadyStateAllocations(scenario, jobSystem);
+	}
+
+	SDL_Quit();
+
+	return ReportChecks();
+}
\ No newline at end of file
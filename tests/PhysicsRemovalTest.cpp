@@ -0,0 +1,183 @@
+// PhysicsWorld の剛体の削除のテスト
+// 接触している剛体を削除し、空いたスロットに剛体を追加し直しても、ペアが削除済みの剛体や
+// 範囲外の剛体を指さないことと、削除した剛体の古いIDが無効として扱われることを確かめる。
+// ペアは公開されている関数(GetRigidbodyAInContact など)を通して調べる。
+
+#include "PhysicsWorld.h"
+#include "JobSystem.h"
+#include "TestCheck.h"
+
+#include <SDL.h>
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+namespace
+{
+// 削除の前後で進めるステップ数
+const int kNumSettleSteps = 30;
+
+struct Scenario
+{
+	const char* name;
+	SimplePhysics::SpxSolverType solverType;
+	int reorderInterval;
+	bool useJobSystem;
+};
+
+// 地面の上に2段に積んだ箱を並べる(箱どうしと、箱と地面のペアができる)
+// 箱の大きさは1、地面の上面は y = -0.5 なので、最初から接した状態で置く
+std::vector<int> CreateBoxes(PhysicsWorld& world, int numColumns)
+{
+	std::vector<RigidbodyDesc> descs;
+	for (int z = 0; z < numColumns; z++)
+	{
+		for (int x = 0; x < numColumns; x++)
+		{
+			for (int y = 0; y < 2; y++)
+			{
+				RigidbodyDesc box;
+				box.position = glm::vec3((x - numColumns / 2) * 3.0f, (float)y, (z - numColumns / 2) * 3.0f);
+				descs.push_back(box);
+			}
+		}
+	}
+
+	std::vector<int> ids(descs.size());
+	int numAdded = world.AddRigidbodies(descs.data(), (int)descs.size(), ids.data());
+	CHECK(numAdded == (int)descs.size());
+	return ids;
+}
+
+// ペアが指す剛体のうち、無効なもの(削除済み、範囲外)や、removed に含まれるものの数を数える
+int CountBadContacts(PhysicsWorld& world, const std::vector<int>& removed)
+{
+	int bad = 0;
+	for (int i = 0; i < world.GetNumContacts(); i++)
+	{
+		int idA = (int)world.GetRigidbodyAInContact(i);
+		int idB = (int)world.GetRigidbodyBInContact(i);
+		bad += !world.IsValidRigidbody(idA) || !world.IsValidRigidbody(idB) || idA == idB;
+		bad += std::find(removed.begin(), removed.end(), idA) != removed.end();
+		bad += std::find(removed.begin(), removed.end(), idB) != removed.end();
+	}
+	return bad;
+}
+
+// ペアが1つでも id を指しているかどうか
+bool IsInContact(PhysicsWorld& world, int id)
+{
+	for (int i = 0; i < world.GetNumContacts(); i++)
+	{
+		if ((int)world.GetRigidbodyAInContact(i) == id || (int)world.GetRigidbodyBInContact(i) == id) { return true; }
+	}
+	return false;
+}
+
+void TestRemoveAndReAdd(const Scenario& scenario, JobSystem& jobSystem)
+{
+	PhysicsWorld world;
+	world.SetSolverType(scenario.solverType);
+	world.SetReorderInterval(scenario.reorderInterval);
+	if (scenario.useJobSystem) { world.SetJobSystem(&jobSystem); }
+
+	RigidbodyDesc ground;
+	ground.position = glm::vec3(0.0f, -1.0f, 0.0f);
+	ground.scale = glm::vec3(40.0f, 1.0f, 40.0f);
+	ground.motionType = SimplePhysics::SpxMotionTypeStatic;
+	int groundId = -1;
+	world.AddRigidbodies(&ground, 1, &groundId);
+
+	std::vector<int> boxes = CreateBoxes(world, 8);
+	int numBodies = world.GetNumRigidbodies();
+
+	for (int i = 0; i < kNumSettleSteps; i++) { world.Simulate(); }
+	int contactsBefore = world.GetNumContacts();
+	CHECK(contactsBefore > 0);
+	CHECK(CountBadContacts(world, {}) == 0);
+
+	// 接触している箱を1つおきに削除する(配列の途中と末尾の両方から抜ける)
+	std::vector<int> removed;
+	std::vector<int> kept;
+	for (size_t i = 0; i < boxes.size(); i++)
+	{
+		if (i % 2 == 0 && IsInContact(world, boxes[i])) { removed.push_back(boxes[i]); }
+		else { kept.push_back(boxes[i]); }
+	}
+	CHECK(!removed.empty());
+	for (int id : removed) { CHECK(world.RemoveRigidbody(id)); }
+	CHECK(world.GetNumRigidbodies() == numBodies - (int)removed.size());
+
+	// 削除した直後からペアは削除済みの剛体を指さず、古いIDは無効になる
+	CHECK(CountBadContacts(world, removed) == 0);
+	for (int id : removed)
+	{
+		CHECK(!world.IsValidRigidbody(id));
+		CHECK(!world.RemoveRigidbody(id));
+	}
+	for (int id : kept) { CHECK(world.IsValidRigidbody(id)); }
+	CHECK(world.IsValidRigidbody(groundId));
+
+	for (int i = 0; i < kNumSettleSteps; i++) { world.Simulate(); }
+	CHECK(CountBadContacts(world, removed) == 0);
+
+	// 同じ数の箱を追加し直す(空いたスロットが再利用される)
+	std::vector<RigidbodyDesc> descs(removed.size());
+	for (size_t i = 0; i < descs.size(); i++)
+	{
+		descs[i].position = glm::vec3(((int)i % 8 - 4) * 3.0f, 2.0f, ((int)i / 8 - 4) * 3.0f);
+	}
+	std::vector<int> added(descs.size());
+	CHECK(world.AddRigidbodies(descs.data(), (int)descs.size(), added.data()) == (int)descs.size());
+	CHECK(world.GetNumRigidbodies() == numBodies);
+	for (int id : added)
+	{
+		CHECK(world.IsValidRigidbody(id));
+		CHECK(std::find(removed.begin(), removed.end(), id) == removed.end());
+	}
+
+	// スロットが再利用されても、古いIDは無効のまま
+	for (int id : removed)
+	{
+		CHECK(!world.IsValidRigidbody(id));
+		CHECK(!world.RemoveRigidbody(id));
+	}
+
+	// 追加し直した箱が落ちて接触しても、ペアは有効な剛体だけを指す
+	int numAddedInContact = 0;
+	for (int i = 0; i < kNumSettleSteps * 2; i++)
+	{
+		world.Simulate();
+		if (i % 10 == 0) { CHECK(CountBadContacts(world, removed) == 0); }
+	}
+	for (int id : added) { numAddedInContact += IsInContact(world, id); }
+	CHECK(numAddedInContact > 0);
+	CHECK(CountBadContacts(world, removed) == 0);
+
+	std::printf("%s: %d contacts before removal, removed %zu bodies, %d contacts after re-adding (%d re-added bodies in contact)\n",
+				scenario.name, contactsBefore, removed.size(), world.GetNumContacts(), numAddedInContact);
+}
+};	// namespace
+
+int main(int argc, char* argv[])
+{
+	// 処理時間の計測に使うタイマーを初期化する
+	SDL_Init(SDL_INIT_TIMER);
+
+	JobSystem jobSystem(3);
+
+	// 並び替えの間隔を1にして、削除と追加の後の並び替えでもペアが正しく付け替えられることを調べる
+	const Scenario scenarios[] = {
+		{"PGS", SimplePhysics::SpxSolverTypePGS, 0, false},
+		{"PGS + jobs + reorder", SimplePhysics::SpxSolverTypePGS, 1, true},
+		{"SoftStep + jobs", SimplePhysics::SpxSolverTypeSoftStep, 0, true},
+	};
+	for (const Scenario& scenario : scenarios)
+	{
+		TestRemoveAndReAdd(scenario, jobSystem);
+	}
+
+	SDL_Quit();
+
+	return ReportChecks();
+}
\ No newline at end of file
@@ -0,0 +1,36 @@
+#pragma once
+
+// テストで共通に使う CHECK マクロと、失敗した数の集計
+// 各テストは CHECK で確かめ、main の最後に ReportChecks の戻り値を返す。
+
+#include <cstdio>
+
+// 失敗した CHECK の数
+inline int gNumFailures = 0;
+
+// 条件が成り立たなければ場所と式を表示して失敗を数える(テストは止めずに続ける)
+#define CHECK(cond)                                                                   \
+	do                                                                                \
+	{                                                                                 \
+		if (!(cond))                                                                  \
+		{                                                                             \
+			std::fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); \
+			gNumFailures++;                                                           \
+		}                                                                             \
+	} while (0)
+
+/**
+ * @brief 結果を表示して、main の戻り値を返す
+ *
+ * @return int 失敗がなければ 0、あれば 1
+ */
+inline int ReportChecks()
+{
+	if (gNumFailures > 0)
+	{
+		std::printf("%d checks failed\n", gNumFailures);
+		return 1;
+	}
+	std::printf("All checks passed\n");
+	return 0;
+}
\ No newline at end of file